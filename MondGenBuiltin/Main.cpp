@@ -0,0 +1,156 @@
+#include <limits>
+#include "../MondX/Parser.hpp"
+#include "../MondX/BuiltinScope.hpp"
+
+using namespace Mond;
+
+void usage()
+{
+	printf("usage: mondx-genbuiltin <builtin.mnd> <output.cpp>\n");
+}
+
+void writeString(FILE *out, const char *str, uint32_t length)
+{
+	fputc('"', out);
+
+	for (uint32_t i = 0; i < length; i++)
+	{
+		auto ch = (unsigned char)str[i];
+
+		// A ? is escaped too, the pair starting a trigraph would otherwise
+		// turn into something else under -std=c++0x.
+		if (ch == '"' || ch == '\\' || ch == '?')
+		{
+			fprintf(out, "\\%c", ch);
+		}
+		else if (isprint(ch))
+		{
+			fputc(ch, out);
+		}
+		else
+		{
+			fprintf(out, "\\%03o", ch);
+		}
+	}
+
+	fputc('"', out);
+}
+
+void writeNumber(FILE *out, double number)
+{
+	if (number != number)
+	{
+		fprintf(out, "std::numeric_limits<double>::quiet_NaN()");
+	}
+	else if (number == std::numeric_limits<double>::infinity())
+	{
+		fprintf(out, "std::numeric_limits<double>::infinity()");
+	}
+	else if (number == -std::numeric_limits<double>::infinity())
+	{
+		fprintf(out, "-std::numeric_limits<double>::infinity()");
+	}
+	else
+	{
+		fprintf(out, "%.17g", number);
+	}
+}
+
+void writeTable(FILE *out, const string &builtinFile, const BuiltinTable &table)
+{
+	static const char *declTypes[] = { "Variable", "Constant", "Function", "Sequence", "Argument" };
+
+	fprintf(out, "// Generated by mondx-genbuiltin from %s, do not edit.\n\n", builtinFile.c_str());
+	fprintf(out, "#include <limits>\n");
+	fprintf(out, "#include \"BuiltinScope.hpp\"\n\n");
+	fprintf(out, "using namespace Mond;\n\n");
+
+	// Zero sized arrays aren't allowed, an empty table still gets one entry.
+	fprintf(out, "static constexpr BuiltinEntry Entries[] =\n{\n");
+	for (uint32_t i = 0; i < table.count; i++)
+	{
+		auto &entry = table.entries[i];
+
+		fprintf(out, "\t{ ");
+		writeString(out, entry.name, entry.nameLength);
+		fprintf(out, ", %u, Decl::%s, { %d, %d, %d, %d }, %d, %s, %d, ",
+			entry.nameLength,
+			declTypes[entry.type],
+			entry.range[0], entry.range[1], entry.range[2], entry.range[3],
+			entry.arity,
+			entry.varargs ? "true" : "false",
+			entry.constant);
+		writeNumber(out, entry.number);
+		fprintf(out, ", ");
+		writeString(out, entry.contents, entry.contentsLength);
+		fprintf(out, ", %u },\n", entry.contentsLength);
+	}
+	if (table.count == 0)
+	{
+		fprintf(out, "\t{ \"\", 0, Decl::Variable, { 0, 0, 0, 0 }, -1, false, 0, 0, \"\", 0 },\n");
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "static constexpr uint32_t Seeds[] =\n{\n");
+	for (uint32_t i = 0; i < table.bucketCount; i++)
+	{
+		fprintf(out, "\t%u,\n", table.seeds[i]);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "static constexpr int32_t Slots[] =\n{\n");
+	for (uint32_t i = 0; i <= table.slotMask; i++)
+	{
+		fprintf(out, "\t%d,\n", table.slots[i]);
+	}
+	fprintf(out, "};\n\n");
+
+	fprintf(out, "constexpr BuiltinTable Mond::CompiledBuiltinTable =\n{\n");
+	fprintf(out, "\t%u,\n\t%u,\n\t%u,\n\tEntries,\n\tSeeds,\n\tSlots\n};\n", table.count, table.bucketCount, table.slotMask);
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3)
+	{
+		usage();
+		return 1;
+	}
+
+	string builtinFile = argv[1];
+	string outputFile = argv[2];
+	auto errors = 0;
+
+	FileSource source(builtinFile);
+	DiagBuilder diag([&](const Diag &d)
+	{
+		if (d.severity == Error)
+		{
+			fprintf(stderr, "%s:%lld:%lld: error: %s\n", builtinFile.c_str(), (long long)d.range.beg.line, (long long)d.range.beg.column, d.message.c_str());
+			errors++;
+		}
+	});
+
+	Lexer lexer(diag, source);
+	Sema sema(diag, NULL);
+	Parser parser(diag, source, lexer, sema);
+	parser.ParseFile();
+
+	if (errors)
+	{
+		return 1;
+	}
+
+	BuiltinScope scope(*sema.RootScope());
+
+	auto out = fopen(outputFile.c_str(), "w");
+	if (!out)
+	{
+		fprintf(stderr, "can't write %s\n", outputFile.c_str());
+		return 1;
+	}
+
+	writeTable(out, builtinFile, scope.Table());
+	fclose(out);
+	return 0;
+}
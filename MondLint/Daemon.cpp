@@ -0,0 +1,480 @@
+#include <cstring>
+#include <algorithm>
+#include "Daemon.hpp"
+#include "../MondX/MappedFile.hpp"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <unistd.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#endif
+
+// A request is the client's working directory followed by its lint arguments,
+// one per line, ending with an empty line. The reply is the lint output, a
+// NUL, and the exit status as a single byte.
+
+#ifndef _WIN32
+
+// A client that hasn't sent its whole request by then is dropped.
+static const int RequestTimeout = 10;
+
+// Past this many files, the results used the longest ago are dropped.
+static const size_t ResidentLimit = 16384;
+
+// The diagnostics a file got, kept until its contents or the options change,
+// or it's evicted. Used is the last request that asked for the file.
+struct ResidentResult
+{
+	uint64_t configHash;
+	uint64_t contentsHash;
+	uint64_t used;
+	vector<Diag> diags;
+};
+
+struct DaemonState
+{
+	LintOptions options;
+	WorkPool *pool;
+	// Held while a request is linted, requests take turns with the pool.
+	// Requests counts them, it only changes with this held.
+	std::mutex lintMutex;
+	uint64_t requests;
+	std::mutex mutex;
+	unordered_map<string, ResidentResult> results;
+};
+
+static bool readLine(FILE *in, string &line)
+{
+	char buffer[1024];
+	line.clear();
+
+	while (fgets(buffer, sizeof(buffer), in))
+	{
+		line += buffer;
+
+		if (line.back() == '\n')
+		{
+			line.pop_back();
+			return true;
+		}
+	}
+
+	return !line.empty();
+}
+
+static bool writeAll(int fd, const char *data, size_t size)
+{
+	while (size > 0)
+	{
+		auto written = write(fd, data, size);
+
+		if (written < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (written <= 0)
+		{
+			return false;
+		}
+
+		data += written;
+		size -= written;
+	}
+
+	return true;
+}
+
+static void lintResident(DaemonState &state, const LintOptions &options, uint64_t configHash, const string &path, const string &name, SourceManager &manager, LintOutput &output)
+{
+	// Names are what the client asked for, so the output matches what it
+	// would have printed itself.
+	MappedFile file(path);
+
+	if (!file.IsValid())
+	{
+		throw invalid_argument("can't read source file '" + name + "'");
+	}
+
+	output.file = manager.Add(name, string(file.Data(), file.Size()));
+	auto contentsHash = manager.GetHash(output.file);
+
+	if (options.showCaptures)
+	{
+		lintFile(options, manager.GetSource(output.file), output);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		auto it = state.results.find(path);
+
+		if (it != state.results.end() && it->second.configHash == configHash && it->second.contentsHash == contentsHash)
+		{
+			it->second.used = state.requests;
+			output.diags = it->second.diags;
+
+			for (auto &diag : output.diags)
+			{
+				diag.file = output.file;
+			}
+
+			return;
+		}
+	}
+
+	lintFile(options, manager.GetSource(output.file), output);
+
+	std::lock_guard<std::mutex> lock(state.mutex);
+	auto &result = state.results[path];
+	result.configHash = configHash;
+	result.contentsHash = contentsHash;
+	result.used = state.requests;
+	result.diags = output.diags;
+}
+
+static void evictResults(DaemonState &state)
+{
+	std::lock_guard<std::mutex> lock(state.mutex);
+
+	if (state.results.size() <= ResidentLimit)
+	{
+		return;
+	}
+
+	typedef unordered_map<string, ResidentResult>::iterator ResultIt;
+	vector<ResultIt> results;
+
+	for (auto it = state.results.begin(); it != state.results.end(); ++it)
+	{
+		results.push_back(it);
+	}
+
+	std::sort(results.begin(), results.end(), [](ResultIt a, ResultIt b)
+	{
+		return a->second.used < b->second.used;
+	});
+
+	for (size_t i = 0; i < results.size() - ResidentLimit; i++)
+	{
+		state.results.erase(results[i]);
+	}
+}
+
+// False if the client went away or timed out before the empty line.
+static bool readRequest(FILE *in, string &cwd, vector<string> &args)
+{
+	string line;
+
+	if (!readLine(in, cwd))
+	{
+		return false;
+	}
+
+	while (readLine(in, line))
+	{
+		if (line == "")
+		{
+			return true;
+		}
+
+		args.push_back(line);
+	}
+
+	return false;
+}
+
+static int handleRequest(DaemonState &state, const string &cwd, const vector<string> &args, FILE *out)
+{
+	auto options = state.options;
+	vector<string> inputs;
+
+	for (size_t i = 0; i < args.size(); i++)
+	{
+		auto &line = args[i];
+
+		if (line == "-f" && i + 1 < args.size())
+		{
+			options.diagFormat = args[++i];
+		}
+		else if (line == "--dump-captures")
+		{
+			options.showCaptures = true;
+		}
+		else if (line == "--syntax-only")
+		{
+			options.syntaxOnly = true;
+		}
+		else if (line == "--stream")
+		{
+			options.stream = true;
+		}
+		else if (line.size() > 1 && line[0] == '-')
+		{
+			fprintf(out, "mondx-lint: the daemon doesn't take '%s'\n", line.c_str());
+			return 1;
+		}
+		else
+		{
+			inputs.push_back(line);
+		}
+	}
+
+	if (options.diagFormat != "tool" && options.diagFormat != "fancy")
+	{
+		fprintf(out, "mondx-lint: unknown format '%s'\n", options.diagFormat.c_str());
+		return 1;
+	}
+
+	vector<string> files;
+
+	for (auto &input : inputs)
+	{
+		auto relative = input[0] != '/';
+		auto prefix = relative ? cwd + "/" : string();
+		vector<string> found;
+		collectFiles(prefix + input, found);
+
+		for (auto &path : found)
+		{
+			files.push_back(path.substr(prefix.size()));
+		}
+	}
+
+	auto configHash = hashLintOptions(options);
+	std::lock_guard<std::mutex> lock(state.lintMutex);
+	state.requests++;
+
+	auto ok = lintFiles(options, files, *state.pool, out, out, [&](const string &name, SourceManager &manager, LintOutput &output)
+	{
+		auto path = name[0] != '/' ? cwd + "/" + name : name;
+		lintResident(state, options, configHash, path, name, manager, output);
+	});
+
+	evictResults(state);
+	return ok ? 0 : 1;
+}
+
+static void serveClient(DaemonState &state, int client)
+{
+	timeval timeout;
+	timeout.tv_sec = RequestTimeout;
+	timeout.tv_usec = 0;
+	setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	auto in = fdopen(client, "r");
+	auto out = fdopen(dup(client), "w");
+	string cwd;
+	vector<string> args;
+
+	if (readRequest(in, cwd, args))
+	{
+		int status;
+
+		try
+		{
+			status = handleRequest(state, cwd, args, out);
+		}
+		catch (const std::exception &e)
+		{
+			fprintf(out, "mondx-lint: %s\n", e.what());
+			status = 1;
+		}
+
+		fputc('\0', out);
+		fputc(status, out);
+	}
+
+	fclose(out);
+	fclose(in);
+}
+
+// Only a socket nothing is listening on is replaced, anything else at the
+// path is left alone.
+static bool claimSocketPath(const sockaddr_un &addr, const string &socketPath)
+{
+	struct stat info;
+
+	if (lstat(socketPath.c_str(), &info) != 0)
+	{
+		return errno == ENOENT;
+	}
+	else if (!S_ISSOCK(info.st_mode))
+	{
+		fprintf(stderr, "mondx-lint: '%s' exists and isn't a socket\n", socketPath.c_str());
+		return false;
+	}
+
+	auto probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	auto refused = probe >= 0 && connect(probe, (const sockaddr *)&addr, sizeof(addr)) != 0 && errno == ECONNREFUSED;
+
+	if (probe >= 0)
+	{
+		close(probe);
+	}
+
+	if (!refused)
+	{
+		fprintf(stderr, "mondx-lint: a daemon is already listening on '%s'\n", socketPath.c_str());
+		return false;
+	}
+
+	return unlink(socketPath.c_str()) == 0;
+}
+
+int runDaemon(const LintOptions &options, const string &socketPath, WorkPool &pool)
+{
+	// Client threads may outlive the accept loop.
+	shared_ptr<DaemonState> state(new DaemonState);
+	state->options = options;
+	state->pool = &pool;
+	state->requests = 0;
+
+	// A client that goes away mid reply mustn't take the daemon with it.
+	signal(SIGPIPE, SIG_IGN);
+
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+
+	if (socketPath.size() >= sizeof(addr.sun_path))
+	{
+		fprintf(stderr, "mondx-lint: socket path too long\n");
+		return 1;
+	}
+
+	strcpy(addr.sun_path, socketPath.c_str());
+
+	if (!claimSocketPath(addr, socketPath))
+	{
+		return 1;
+	}
+
+	auto server = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (server < 0 || bind(server, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(server, 16) != 0)
+	{
+		fprintf(stderr, "mondx-lint: can't listen on '%s'\n", socketPath.c_str());
+		return 1;
+	}
+
+	while (true)
+	{
+		auto client = accept(server, NULL, NULL);
+
+		if (client < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (client < 0)
+		{
+			break;
+		}
+
+		// A client that's slow to send its request only holds up its own
+		// thread.
+		std::thread([state, client]()
+		{
+			serveClient(*state, client);
+		}).detach();
+	}
+
+	close(server);
+	return 1;
+}
+
+int runClient(const string &socketPath, const vector<string> &args)
+{
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+	auto fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+	if (fd < 0 || connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		fprintf(stderr, "mondx-lint: no daemon listening on '%s'\n", socketPath.c_str());
+		return 1;
+	}
+
+	char cwd[PATH_MAX];
+
+	if (!getcwd(cwd, sizeof(cwd)))
+	{
+		return 1;
+	}
+
+	string request = string(cwd) + "\n";
+
+	for (auto &arg : args)
+	{
+		request += arg + "\n";
+	}
+
+	request += "\n";
+
+	if (!writeAll(fd, request.data(), request.size()))
+	{
+		return 1;
+	}
+
+	char buffer[4096];
+	auto ended = false;
+	int status = -1;
+
+	while (status < 0)
+	{
+		auto got = read(fd, buffer, sizeof(buffer));
+
+		if (got < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (got <= 0)
+		{
+			break;
+		}
+
+		auto data = buffer;
+		auto size = (size_t)got;
+
+		if (!ended)
+		{
+			auto end = (char *)memchr(data, '\0', size);
+			auto length = end ? end - data : size;
+			fwrite(data, 1, length, stdout);
+
+			ended = end != NULL;
+			data += ended ? length + 1 : length;
+			size -= ended ? length + 1 : length;
+		}
+
+		if (ended && size > 0)
+		{
+			status = (unsigned char)data[0];
+		}
+	}
+
+	close(fd);
+	return status < 0 ? 1 : status;
+}
+
+#else
+
+int runDaemon(const LintOptions &, const string &, WorkPool &)
+{
+	fprintf(stderr, "mondx-lint: the daemon needs Unix domain sockets\n");
+	return 1;
+}
+
+int runClient(const string &, const vector<string> &)
+{
+	fprintf(stderr, "mondx-lint: the daemon needs Unix domain sockets\n");
+	return 1;
+}
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef MOND_LINT_DAEMON_HPP
+#define MOND_LINT_DAEMON_HPP
+
+#include "Lint.hpp"
+
+// Serves lint requests on a Unix domain socket until the process is killed.
+// The builtins in options are shared by every request, and each file's
+// diagnostics are kept until its contents change, or until too many files
+// have been linted since it was last asked for. Each connection is read
+// on a thread of its own, then requests are linted one at a time, each on
+// the whole pool. Refuses to replace anything at socketPath but a socket no
+// daemon is listening on.
+int runDaemon(const LintOptions &options, const string &socketPath, WorkPool &pool);
+
+// Sends the lint arguments to a daemon and copies its output to stdout.
+// Returns the exit status the daemon sent back.
+int runClient(const string &socketPath, const vector<string> &args);
+
+#endif
@@ -0,0 +1,115 @@
+#include <cstdlib>
+#include "Index.hpp"
+#include "../MondX/Rename.hpp"
+#include "../MondX/MappedFile.hpp"
+#include "../MondX/SymbolIndex.hpp"
+
+static const size_t SymbolLimit = 1000;
+
+// Splits <file>:<line>:<column>, the file may have colons of its own.
+static bool parseLocation(const string &argument, string &path, Pos &pos)
+{
+	auto second = argument.rfind(':');
+	auto first = second == string::npos || second == 0 ? string::npos : argument.rfind(':', second - 1);
+
+	if (first == string::npos || first == 0)
+	{
+		return false;
+	}
+
+	path = argument.substr(0, first);
+	pos = Pos(atoi(argument.c_str() + first + 1), atoi(argument.c_str() + second + 1));
+	return pos.line > 0 && pos.column > 0;
+}
+
+static void printLocation(const SymbolLocation &location)
+{
+	printf("%s:%d:%d\n", location.path.c_str(), (int)location.range.beg.line, (int)location.range.beg.column);
+}
+
+int runIndex(const LintOptions &options, const string &indexFile, const vector<string> &files, const IndexQuery &query, WorkPool &pool)
+{
+	SymbolIndex index(indexFile, options.builtinScope);
+
+	if (!files.empty())
+	{
+		auto stats = index.Update(files, pool);
+		fprintf(stderr, "index: %u files, %u reused, %u indexed, %u removed, %u unreadable\n",
+			(unsigned)index.FileCount(), (unsigned)stats.reused, (unsigned)stats.indexed,
+			(unsigned)stats.removed, (unsigned)stats.failed);
+	}
+
+	if (query.kind == "symbols")
+	{
+		for (auto &decl : index.FindDeclarations(query.argument, SymbolLimit))
+		{
+			printf("%s:%d:%d: %s %s\n", decl.location.path.c_str(), (int)decl.location.range.beg.line,
+				(int)decl.location.range.beg.column, GetDeclTypeName(decl.type), decl.name.c_str());
+		}
+	}
+	else if (query.kind != "")
+	{
+		string path;
+		Pos pos;
+
+		if (!parseLocation(query.argument, path, pos))
+		{
+			fprintf(stderr, "expected <file>:<line>:<column>, got '%s'\n", query.argument.c_str());
+			return 1;
+		}
+
+		SymbolLocation location;
+
+		if (query.kind == "rename")
+		{
+			MappedFile contents(path);
+
+			if (!contents.IsValid())
+			{
+				fprintf(stderr, "unable to read '%s'\n", path.c_str());
+				return 1;
+			}
+
+			// Only an undeclared name goes beyond its file, and the index
+			// knows every file using it.
+			vector<string> others;
+
+			for (auto &reference : index.FindReferences(path, pos))
+			{
+				if (others.empty() || others.back() != reference.path)
+				{
+					others.push_back(reference.path);
+				}
+			}
+
+			auto result = Rename(path, string(contents.Data(), contents.Size()), pos, query.newName, options.builtinScope, others, pool);
+
+			if (result.error != "")
+			{
+				fprintf(stderr, "%s\n", result.error.c_str());
+				return 1;
+			}
+
+			for (auto &file : result.files)
+			{
+				for (auto &range : file.ranges)
+				{
+					printf("%s:%d:%d\n", file.path.c_str(), (int)range.beg.line, (int)range.beg.column);
+				}
+			}
+		}
+		else if (query.kind == "definition" && index.FindDefinition(path, pos, location))
+		{
+			printLocation(location);
+		}
+		else if (query.kind == "references")
+		{
+			for (auto &reference : index.FindReferences(path, pos))
+			{
+				printLocation(reference);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef MOND_LINT_INDEX_HPP
+#define MOND_LINT_INDEX_HPP
+
+#include "Lint.hpp"
+
+// A lookup in a symbol index: "references" or "definition" of the name at a
+// <file>:<line>:<column>, or "symbols" starting with a prefix. A "rename" of
+// the name at a location to newName prints the locations to change.
+struct IndexQuery
+{
+	string kind;
+	string argument;
+	string newName;
+};
+
+// Brings the index at indexFile up to date with the files, if any are given,
+// then answers the query, if there is one. Locations are printed one per line
+// as <file>:<line>:<column>, which editors and grep-style tools understand.
+int runIndex(const LintOptions &options, const string &indexFile, const vector<string> &files, const IndexQuery &query, WorkPool &pool);
+
+#endif
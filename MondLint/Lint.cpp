@@ -0,0 +1,248 @@
+#include <cstdarg>
+#include <algorithm>
+#include "Lint.hpp"
+#include "../MondX/Sema.hpp"
+#include "../MondX/Hash.hpp"
+#include "../MondX/Parser.hpp"
+#include "../MondX/FileSystem.hpp"
+#include "../MondX/DiagPrinterTool.hpp"
+
+#ifdef _WIN32
+#include "../MondX/DiagPrinterFancyWin32.hpp"
+#else
+#include "../MondX/DiagPrinterFancyUnix.hpp"
+#endif
+
+// ---------------------------------------------------------------------------
+// Capture dumps
+// ---------------------------------------------------------------------------
+
+static void appendf(string &out, const char *fmt, ...)
+{
+	char buffer[1024];
+
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(buffer, 1024, fmt, ap);
+	va_end(ap);
+
+	out += buffer;
+}
+
+static void collectLocals(Scope *frame, Scope *scope, vector<pair<const Decl *, string>> &locals)
+{
+	if (scope->frame != frame)
+	{
+		return;
+	}
+
+	for (auto &entry : scope->decls)
+	{
+		locals.push_back(std::make_pair(&entry.second, entry.first));
+	}
+
+	for (auto &child : scope->children)
+	{
+		collectLocals(frame, child.get(), locals);
+	}
+}
+
+static void dumpCaptures(Scope *scope, string &out)
+{
+	if (scope->frame == scope)
+	{
+		vector<pair<const Decl *, string>> locals;
+		collectLocals(scope, scope, locals);
+		std::sort(locals.begin(), locals.end(), [](const pair<const Decl *, string> &a, const pair<const Decl *, string> &b)
+		{
+			return a.first->slot < b.first->slot;
+		});
+
+		if (scope->node)
+		{
+			appendf(out, "%s at %lld:%lld\n", scope->type == Scope::Sequence ? "seq" : "fun", (long long)scope->node->pos.line, (long long)scope->node->pos.column);
+		}
+		else
+		{
+			appendf(out, "file\n");
+		}
+
+		for (auto &capture : scope->captures)
+		{
+			appendf(out, "  capture %s (depth %d, slot %d)\n", capture.name.c_str(), capture.depth, capture.decl->slot);
+		}
+
+		for (auto &local : locals)
+		{
+			appendf(out, "  local %s (slot %d, %s%s)\n", local.second.c_str(), local.first->slot, CanUseStackSlot(*local.first) ? "stack" : "heap", local.first->initialized ? ", initialized" : "");
+		}
+	}
+
+	for (auto &child : scope->children)
+	{
+		dumpCaptures(child.get(), out);
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Linting
+// ---------------------------------------------------------------------------
+
+void collectFiles(const string &path, vector<string> &files)
+{
+	if (!IsDirectory(path))
+	{
+		files.push_back(path);
+		return;
+	}
+
+	for (auto &name : ListDirectory(path))
+	{
+		auto child = path + "/" + name;
+
+		if (IsDirectory(child))
+		{
+			collectFiles(child, files);
+		}
+		else if (name.size() > 4 && name.compare(name.size() - 4, 4, ".mnd") == 0)
+		{
+			files.push_back(child);
+		}
+	}
+}
+
+uint64_t hashLintOptions(const LintOptions &options)
+{
+	auto builtins = options.builtinScope ? options.builtinScope->Hash() : 0;
+	return HashCombine(builtins, options.syntaxOnly + options.stream * 2);
+}
+
+void lintFile(const LintOptions &options, StringSource source, LintOutput &output)
+{
+	DiagCollector collector(output.diags);
+	DiagBuilder diag(collector);
+
+	diag.SetFile(output.file);
+	Lexer lexer(diag, source);
+
+	if (options.syntaxOnly)
+	{
+		SyntaxParser parser(diag, source, lexer);
+		parser.ParseFile();
+		return;
+	}
+
+	Sema sema(diag, options.builtinScope);
+
+	if (options.stream)
+	{
+		// Only the statement just checked has scopes below the root.
+		Parser parser(diag, source, lexer, sema);
+		parser.ParseFile([&](StmtPtr)
+		{
+			if (options.showCaptures)
+			{
+				string dump;
+
+				for (auto &child : sema.RootScope()->children)
+				{
+					dumpCaptures(child.get(), dump);
+				}
+
+				output.dumps.push_back(std::make_pair(output.diags.size(), dump));
+			}
+		});
+	}
+	else
+	{
+		Parser parser(diag, source, lexer);
+		sema.Check(parser.ParseFile());
+	}
+
+	if (options.showCaptures)
+	{
+		string dump;
+		dumpCaptures(sema.RootScope().get(), dump);
+		output.dumps.push_back(std::make_pair(output.diags.size(), dump));
+	}
+}
+
+static void printOutput(const LintOptions &options, const SourceManager &manager, bool showNames, FILE *out, FILE *err, const LintOutput &output)
+{
+	if (output.error != "")
+	{
+		fprintf(err, "mondx-lint: %s\n", output.error.c_str());
+		return;
+	}
+
+	auto source = manager.GetSource(output.file);
+	DiagObserver observer;
+
+	if (options.diagFormat == "tool")
+	{
+		observer = showNames ? DiagPrinterTool(manager, out) : DiagPrinterTool(out);
+	}
+	else
+	{
+		observer = showNames ? DiagPrinterFancy(manager, out) : DiagPrinterFancy(source, out);
+	}
+
+	auto dump = output.dumps.begin();
+
+	for (size_t i = 0; i <= output.diags.size(); i++)
+	{
+		for (; dump != output.dumps.end() && dump->first == i; ++dump)
+		{
+			fprintf(out, "%s", dump->second.c_str());
+		}
+
+		if (i < output.diags.size())
+		{
+			observer(output.diags[i]);
+		}
+	}
+}
+
+bool lintFiles(const LintOptions &options, const vector<string> &files, WorkPool &pool, FILE *out, FILE *err, const FileLinter &linter)
+{
+	SourceManager manager;
+	vector<LintOutput> outputs(files.size());
+	auto showNames = files.size() > 1;
+	auto failed = false;
+
+	std::mutex printMutex;
+	size_t printed = 0;
+
+	pool.Run(files.size(), [&](size_t job, int)
+	{
+		auto &output = outputs[job];
+
+		try
+		{
+			linter(files[job], manager, output);
+		}
+		catch (const invalid_argument &e)
+		{
+			output.error = e.what();
+		}
+
+		std::lock_guard<std::mutex> lock(printMutex);
+		output.done = true;
+
+		for (; printed < outputs.size() && outputs[printed].done; printed++)
+		{
+			printOutput(options, manager, showNames, out, err, outputs[printed]);
+			failed = failed || outputs[printed].error != "";
+
+			// Nothing looks at a file once it's printed, holding on to every
+			// mapping would run into the limit on how many a process can have.
+			if (outputs[printed].file)
+			{
+				manager.Release(outputs[printed].file);
+			}
+			outputs[printed] = LintOutput();
+		}
+	});
+
+	return !failed;
+}
@@ -0,0 +1,51 @@
+#ifndef MOND_LINT_HPP
+#define MOND_LINT_HPP
+
+#include "../MondX/WorkPool.hpp"
+#include "../MondX/BuiltinScope.hpp"
+#include "../MondX/SourceManager.hpp"
+
+using namespace Mond;
+
+struct LintOptions
+{
+	BuiltinScopePtr builtinScope;
+	string diagFormat;
+	bool showCaptures;
+	bool syntaxOnly;
+	bool stream;
+};
+
+// Everything linting one file prints, held until the files before it are
+// printed so the output doesn't depend on which worker finishes first.
+struct LintOutput
+{
+	bool done;
+	FileId file;
+	string error;
+	vector<Diag> diags;
+	// Capture dumps, each printed after as many diagnostics as it says.
+	vector<pair<size_t, string>> dumps;
+};
+
+// Loads one file into the manager and fills in its output, from a cache or
+// by calling lintFile.
+typedef function<void (const string &path, SourceManager &manager, LintOutput &output)> FileLinter;
+
+// Directories are searched recursively for .mnd files, in name order so the
+// output is the same on every run.
+void collectFiles(const string &path, vector<string> &files);
+
+// Hash of the options that change which diagnostics a file gets, for keying
+// cached results.
+uint64_t hashLintOptions(const LintOptions &options);
+
+void lintFile(const LintOptions &options, StringSource source, LintOutput &output);
+
+// Lints the files on the pool and prints their output to out in order, files
+// that can't be read are reported to err. With more than one file every
+// diagnostic is prefixed by its file name. Returns false if any file couldn't
+// be read.
+bool lintFiles(const LintOptions &options, const vector<string> &files, WorkPool &pool, FILE *out, FILE *err, const FileLinter &linter);
+
+#endif
@@ -1,25 +1,35 @@
-#include "../MondX/Sema.hpp"
-#include "../MondX/Parser.hpp"
-#include "../MondX/DiagPrinterTool.hpp"
-
-#ifdef _WIN32
-#include "../MondX/DiagPrinterFancyWin32.hpp"
-#else
-#include "../MondX/DiagPrinterFancyUnix.hpp"
-#endif
+#include "Lint.hpp"
+#include "Index.hpp"
+#include "Daemon.hpp"
+#include "../MondX/DiagCache.hpp"
 
-using namespace Mond;
+// Least recently used results are evicted past this.
+static const uint64_t CacheLimit = 256 * 1024 * 1024;
 
 void usage()
 {
-	printf("usage: mondx-lint [-f fancy|tool] [-b <builtin.mnd>] <filename>\n");
+	printf("usage: mondx-lint [-f fancy|tool] [-b <builtin.mnd> [-s <snapshot>]] [-j <threads>] [-c <cache dir> [--cache-stats]] [--syntax-only | --stream] [--dump-captures] <file or directory>...\n");
+	printf("       mondx-lint [-b <builtin.mnd> [-s <snapshot>]] [-j <threads>] --daemon <socket>\n");
+	printf("       mondx-lint [-b <builtin.mnd> [-s <snapshot>]] [-j <threads>] --index <index> [--references <file>:<line>:<column> | --definition <file>:<line>:<column> | --symbols <prefix> | --rename <file>:<line>:<column> <name>] [<file or directory>...]\n");
+	printf("       mondx-lint --connect <socket> [-f fancy|tool] [--syntax-only | --stream] [--dump-captures] <file or directory>...\n");
 }
 
 int main(int argc, char *argv[])
 {
-	string lintFile;
-	string diagFormat = "fancy";
+	vector<string> inputs;
 	string builtinFile;
+	string snapshotFile;
+	string cacheDir;
+	string daemonSocket;
+	string indexFile;
+	IndexQuery query;
+	bool showCacheStats = false;
+	int threads = std::thread::hardware_concurrency();
+	LintOptions options;
+	options.diagFormat = "fancy";
+	options.showCaptures = false;
+	options.syntaxOnly = false;
+	options.stream = false;
 
 	if (argc < 2)
 	{
@@ -27,11 +37,24 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
+	// The client doesn't need anything but its arguments, it starts no
+	// threads and loads no builtins.
+	if (string(argv[1]) == "--connect")
+	{
+		if (argc < 4)
+		{
+			usage();
+			return 1;
+		}
+
+		return runClient(argv[2], vector<string>(argv + 3, argv + argc));
+	}
+
 	for (int i = 1; i < argc; i++)
 	{
 		string arg = argv[i];
 
-		if (arg == "-f" || arg == "-b")
+		if (arg == "-f" || arg == "-b" || arg == "-s" || arg == "-j" || arg == "-c")
 		{
 			i++;
 
@@ -43,57 +66,162 @@ int main(int argc, char *argv[])
 
 			if (arg == "-f")
 			{
-				diagFormat = argv[i];
+				options.diagFormat = argv[i];
 			}
 			else if (arg == "-b")
 			{
 				builtinFile = argv[i];
 			}
+			else if (arg == "-s")
+			{
+				snapshotFile = argv[i];
+			}
+			else if (arg == "-j")
+			{
+				threads = atoi(argv[i]);
+			}
+			else if (arg == "-c")
+			{
+				cacheDir = argv[i];
+			}
+		}
+		else if (arg == "--daemon" && i + 1 < argc)
+		{
+			daemonSocket = argv[++i];
+		}
+		else if (arg == "--index" && i + 1 < argc)
+		{
+			indexFile = argv[++i];
 		}
-		else if (i == argc - 1)
+		else if ((arg == "--references" || arg == "--definition" || arg == "--symbols") && i + 1 < argc && query.kind == "")
 		{
-			lintFile = argv[i];
+			query.kind = arg.substr(2);
+			query.argument = argv[++i];
 		}
+		else if (arg == "--rename" && i + 2 < argc && query.kind == "")
+		{
+			query.kind = "rename";
+			query.argument = argv[++i];
+			query.newName = argv[++i];
+		}
+		else if (arg == "--cache-stats")
+		{
+			showCacheStats = true;
+		}
+		else if (arg == "--dump-captures")
+		{
+			options.showCaptures = true;
+		}
+		else if (arg == "--syntax-only")
+		{
+			options.syntaxOnly = true;
+		}
+		else if (arg == "--stream")
+		{
+			options.stream = true;
+		}
+		else if (arg.size() > 1 && arg[0] == '-')
+		{
+			usage();
+			return 1;
+		}
+		else
+		{
+			inputs.push_back(arg);
+		}
+	}
+
+	// An index can be queried without updating it, so it doesn't need inputs.
+	auto indexing = indexFile != "";
+	auto badInputs = indexing ? inputs.empty() && query.kind == "" : inputs.empty() == (daemonSocket == "");
+
+	if (badInputs || (indexing && daemonSocket != "") || (!indexing && query.kind != "") || (options.diagFormat != "tool" && options.diagFormat != "fancy"))
+	{
+		usage();
+		return 1;
 	}
 
-	StmtPtr builtinBlock;
-	ScopePtr builtinScope;
+	BuiltinScopePtr builtinScope;
 
 	if (builtinFile != "")
 	{
-		FileSource source(builtinFile);
+		builtinScope = BuiltinScope::Parse(builtinFile, snapshotFile);
+	}
+#ifdef MONDX_COMPILED_BUILTINS
+	else
+	{
+		builtinScope.reset(new BuiltinScope(CompiledBuiltinTable));
+	}
+#endif
 
-		DiagBuilder diag([](const Diag &){});
-		Lexer lexer(diag, source);
-		Sema sema(diag, NULL);
-		Parser parser(diag, source, lexer, sema);
+	// Every worker shares the one builtin scope, it's never changed.
+	options.builtinScope = builtinScope;
+	WorkPool pool(threads);
 
-		builtinBlock = parser.ParseFile();
-		builtinScope = sema.RootScope();
+	if (daemonSocket != "")
+	{
+		return runDaemon(options, daemonSocket, pool);
 	}
 
-	FileSource source(lintFile);
-	DiagObserver observer;
+	vector<string> files;
 
-	if (diagFormat == "tool")
+	for (auto &input : inputs)
 	{
-		observer = DiagPrinterTool();
+		collectFiles(input, files);
 	}
-	else if (diagFormat == "fancy")
+
+	if (indexing)
 	{
-		observer = DiagPrinterFancy(source);
+		return runIndex(options, indexFile, files, query, pool);
 	}
-	else
+
+	// Capture dumps aren't cached, so runs that want them skip the cache.
+	unique_ptr<DiagCache> cache;
+	auto configHash = hashLintOptions(options);
+
+	if (cacheDir != "" && !options.showCaptures)
 	{
-		usage();
-		return 1;
+		cache.reset(new DiagCache(cacheDir, CacheLimit));
+	}
+
+	auto ok = lintFiles(options, files, pool, stdout, stderr, [&](const string &path, SourceManager &manager, LintOutput &output)
+	{
+		output.file = manager.Load(path);
+
+		if (!cache)
+		{
+			lintFile(options, manager.GetSource(output.file), output);
+			return;
+		}
+
+		auto key = DiagCache::MakeKey(manager.GetHash(output.file), configHash);
+
+		if (cache->Load(key, output.diags))
+		{
+			for (auto &diag : output.diags)
+			{
+				diag.file = output.file;
+			}
+		}
+		else
+		{
+			lintFile(options, manager.GetSource(output.file), output);
+			cache->Store(key, output.diags);
+		}
+	});
+
+	if (cache)
+	{
+		cache->Evict();
 	}
 
-	DiagBuilder diag(observer);
-	Lexer lexer(diag, source);
-	Sema sema(diag, builtinScope);
-	Parser parser(diag, source, lexer, sema);
-	parser.ParseFile();
+	if (cache && showCacheStats)
+	{
+		auto stats = cache->GetStats();
+		fprintf(stderr, "cache: %llu hits, %llu misses, %llu stored, %llu evicted\n",
+			(unsigned long long)stats.hits, (unsigned long long)stats.misses,
+			(unsigned long long)stats.stores, (unsigned long long)stats.evictions);
+	}
 
-	return 0;
-}
\ No newline at end of file
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,516 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "Json.hpp"
+
+// ---------------------------------------------------------------------------
+// Parsing
+// ---------------------------------------------------------------------------
+
+class JsonParser
+{
+public:
+	JsonParser(const string &text) : m_text(text), m_pos(0)
+	{
+	}
+
+	bool ParseDocument(JsonValue &value)
+	{
+		return ParseValue(value, 0) && (SkipSpace(), m_pos == m_text.size());
+	}
+private:
+	// Deeper nesting than any real message is rejected rather than
+	// overflowing the stack.
+	static const int MaxDepth = 256;
+
+	void SkipSpace()
+	{
+		while (m_pos < m_text.size() && (m_text[m_pos] == ' ' || m_text[m_pos] == '\t' || m_text[m_pos] == '\r' || m_text[m_pos] == '\n'))
+		{
+			m_pos++;
+		}
+	}
+
+	bool Eat(char c)
+	{
+		SkipSpace();
+
+		if (m_pos < m_text.size() && m_text[m_pos] == c)
+		{
+			m_pos++;
+			return true;
+		}
+
+		return false;
+	}
+
+	bool EatWord(const char *word)
+	{
+		auto length = strlen(word);
+
+		if (m_text.compare(m_pos, length, word) != 0)
+		{
+			return false;
+		}
+
+		m_pos += length;
+		return true;
+	}
+
+	bool ParseValue(JsonValue &value, int depth)
+	{
+		SkipSpace();
+
+		if (m_pos >= m_text.size() || depth > MaxDepth)
+		{
+			return false;
+		}
+
+		switch (m_text[m_pos])
+		{
+		case '{':
+			return ParseObject(value, depth);
+		case '[':
+			return ParseArray(value, depth);
+		case '"':
+		{
+			string s;
+			if (!ParseString(s))
+			{
+				return false;
+			}
+
+			value = JsonValue(s);
+			return true;
+		}
+		case 't':
+			value = JsonValue(true);
+			return EatWord("true");
+		case 'f':
+			value = JsonValue(false);
+			return EatWord("false");
+		case 'n':
+			value = JsonValue();
+			return EatWord("null");
+		}
+
+		return ParseNumber(value);
+	}
+
+	bool ParseObject(JsonValue &value, int depth)
+	{
+		value = JsonValue::MakeObject();
+		m_pos++;
+
+		if (Eat('}'))
+		{
+			return true;
+		}
+
+		do
+		{
+			string key;
+			JsonValue member;
+
+			if (!(SkipSpace(), ParseString(key)) || !Eat(':') || !ParseValue(member, depth + 1))
+			{
+				return false;
+			}
+
+			value.Set(key, member);
+		}
+		while (Eat(','));
+
+		return Eat('}');
+	}
+
+	bool ParseArray(JsonValue &value, int depth)
+	{
+		value = JsonValue::MakeArray();
+		m_pos++;
+
+		if (Eat(']'))
+		{
+			return true;
+		}
+
+		do
+		{
+			JsonValue elem;
+
+			if (!ParseValue(elem, depth + 1))
+			{
+				return false;
+			}
+
+			value.Push(elem);
+		}
+		while (Eat(','));
+
+		return Eat(']');
+	}
+
+	bool ParseHex4(uint32_t &unit)
+	{
+		if (m_pos + 4 > m_text.size())
+		{
+			return false;
+		}
+
+		unit = 0;
+
+		for (int i = 0; i < 4; i++)
+		{
+			auto c = m_text[m_pos++];
+			unit <<= 4;
+
+			if (c >= '0' && c <= '9') unit |= c - '0';
+			else if (c >= 'a' && c <= 'f') unit |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') unit |= c - 'A' + 10;
+			else return false;
+		}
+
+		return true;
+	}
+
+	static void AppendUtf8(string &out, uint32_t c)
+	{
+		if (c < 0x80)
+		{
+			out += (char)c;
+		}
+		else if (c < 0x800)
+		{
+			out += (char)(0xC0 | (c >> 6));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else if (c < 0x10000)
+		{
+			out += (char)(0xE0 | (c >> 12));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xF0 | (c >> 18));
+			out += (char)(0x80 | ((c >> 12) & 0x3F));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+	}
+
+	bool ParseString(string &out)
+	{
+		if (m_pos >= m_text.size() || m_text[m_pos] != '"')
+		{
+			return false;
+		}
+
+		m_pos++;
+
+		while (m_pos < m_text.size())
+		{
+			auto c = m_text[m_pos++];
+
+			if (c == '"')
+			{
+				return true;
+			}
+			else if (c != '\\')
+			{
+				out += c;
+				continue;
+			}
+
+			if (m_pos >= m_text.size())
+			{
+				return false;
+			}
+
+			switch (m_text[m_pos++])
+			{
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				uint32_t unit, low;
+				if (!ParseHex4(unit))
+				{
+					return false;
+				}
+
+				// Surrogate pairs come as two escapes.
+				if (unit >= 0xD800 && unit < 0xDC00 && m_text.compare(m_pos, 2, "\\u") == 0)
+				{
+					m_pos += 2;
+					if (!ParseHex4(low) || low < 0xDC00 || low >= 0xE000)
+					{
+						return false;
+					}
+
+					unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+				}
+
+				AppendUtf8(out, unit);
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+	bool ParseNumber(JsonValue &value)
+	{
+		auto beg = m_text.c_str() + m_pos;
+		char *end;
+		auto n = strtod(beg, &end);
+
+		if (end == beg)
+		{
+			return false;
+		}
+
+		m_pos += end - beg;
+		value = JsonValue(n);
+		return true;
+	}
+
+	const string &m_text;
+	size_t m_pos;
+};
+
+// ---------------------------------------------------------------------------
+// JsonValue
+// ---------------------------------------------------------------------------
+
+static const JsonValue NullValue;
+
+JsonValue::JsonValue() : m_type(Null), m_bool(false), m_number(0)
+{
+}
+
+JsonValue::JsonValue(bool b) : m_type(Bool), m_bool(b), m_number(0)
+{
+}
+
+JsonValue::JsonValue(int n) : m_type(Number), m_bool(false), m_number(n)
+{
+}
+
+JsonValue::JsonValue(int64_t n) : m_type(Number), m_bool(false), m_number((double)n)
+{
+}
+
+JsonValue::JsonValue(double n) : m_type(Number), m_bool(false), m_number(n)
+{
+}
+
+JsonValue::JsonValue(const char *s) : m_type(String), m_bool(false), m_number(0), m_string(s)
+{
+}
+
+JsonValue::JsonValue(const string &s) : m_type(String), m_bool(false), m_number(0), m_string(s)
+{
+}
+
+JsonValue JsonValue::MakeArray()
+{
+	JsonValue value;
+	value.m_type = Array;
+	return value;
+}
+
+JsonValue JsonValue::MakeObject()
+{
+	JsonValue value;
+	value.m_type = Object;
+	return value;
+}
+
+bool JsonValue::Parse(const string &text, JsonValue &value)
+{
+	JsonParser parser(text);
+	return parser.ParseDocument(value);
+}
+
+auto JsonValue::GetType() const -> Type
+{
+	return m_type;
+}
+
+bool JsonValue::IsNull() const
+{
+	return m_type == Null;
+}
+
+bool JsonValue::AsBool() const
+{
+	return m_type == Bool && m_bool;
+}
+
+double JsonValue::AsNumber() const
+{
+	return m_type == Number ? m_number : 0;
+}
+
+int64_t JsonValue::AsInt() const
+{
+	return (int64_t)AsNumber();
+}
+
+const string &JsonValue::AsString() const
+{
+	return m_string;
+}
+
+size_t JsonValue::Size() const
+{
+	return m_type == Array ? m_array.size() : m_type == Object ? m_object.size() : 0;
+}
+
+const JsonValue &JsonValue::operator[](size_t index) const
+{
+	return m_type == Array && index < m_array.size() ? m_array[index] : NullValue;
+}
+
+const JsonValue &JsonValue::operator[](const string &key) const
+{
+	for (auto &member : m_object)
+	{
+		if (member.first == key)
+		{
+			return member.second;
+		}
+	}
+
+	return NullValue;
+}
+
+bool JsonValue::Has(const string &key) const
+{
+	return !(*this)[key].IsNull();
+}
+
+JsonValue &JsonValue::Push(const JsonValue &value)
+{
+	m_array.push_back(value);
+	return *this;
+}
+
+JsonValue &JsonValue::Set(const string &key, const JsonValue &value)
+{
+	for (auto &member : m_object)
+	{
+		if (member.first == key)
+		{
+			member.second = value;
+			return *this;
+		}
+	}
+
+	m_object.push_back(std::make_pair(key, value));
+	return *this;
+}
+
+string JsonValue::Dump() const
+{
+	string out;
+	DumpTo(out);
+	return out;
+}
+
+static void DumpString(string &out, const string &s)
+{
+	out += '"';
+
+	for (auto c : s)
+	{
+		switch (c)
+		{
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if ((unsigned char)c < 0x20)
+			{
+				char escape[8];
+				snprintf(escape, sizeof(escape), "\\u%04x", c);
+				out += escape;
+			}
+			else
+			{
+				out += c;
+			}
+		}
+	}
+
+	out += '"';
+}
+
+void JsonValue::DumpTo(string &out) const
+{
+	switch (m_type)
+	{
+	case Null:
+		out += "null";
+		break;
+	case Bool:
+		out += m_bool ? "true" : "false";
+		break;
+	case Number:
+	{
+		char buffer[32];
+
+		if (m_number == std::floor(m_number) && std::fabs(m_number) < 1e15)
+		{
+			snprintf(buffer, sizeof(buffer), "%lld", (long long)m_number);
+		}
+		else
+		{
+			snprintf(buffer, sizeof(buffer), "%.17g", m_number);
+		}
+
+		out += buffer;
+		break;
+	}
+	case String:
+		DumpString(out, m_string);
+		break;
+	case Array:
+		out += '[';
+
+		for (size_t i = 0; i < m_array.size(); i++)
+		{
+			out += i ? "," : "";
+			m_array[i].DumpTo(out);
+		}
+
+		out += ']';
+		break;
+	case Object:
+		out += '{';
+
+		for (size_t i = 0; i < m_object.size(); i++)
+		{
+			out += i ? "," : "";
+			DumpString(out, m_object[i].first);
+			out += ':';
+			m_object[i].second.DumpTo(out);
+		}
+
+		out += '}';
+		break;
+	}
+}
@@ -0,0 +1,65 @@
+#ifndef MOND_LSP_JSON_HPP
+#define MOND_LSP_JSON_HPP
+
+#include "../MondX/Util.hpp"
+
+using namespace Mond;
+
+// Just enough JSON for the protocol. Objects keep their keys in insertion
+// order, looking up a missing key or index gives a null value.
+class JsonValue
+{
+public:
+	enum Type
+	{
+		Null,
+		Bool,
+		Number,
+		String,
+		Array,
+		Object
+	};
+
+	JsonValue();
+	JsonValue(bool b);
+	JsonValue(int n);
+	JsonValue(int64_t n);
+	JsonValue(double n);
+	JsonValue(const char *s);
+	JsonValue(const string &s);
+
+	static JsonValue MakeArray();
+	static JsonValue MakeObject();
+
+	// Returns false on malformed input or trailing garbage.
+	static bool Parse(const string &text, JsonValue &value);
+
+	Type GetType() const;
+	bool IsNull() const;
+
+	bool AsBool() const;
+	double AsNumber() const;
+	int64_t AsInt() const;
+	const string &AsString() const;
+
+	size_t Size() const;
+	const JsonValue &operator[](size_t index) const;
+	const JsonValue &operator[](const string &key) const;
+	bool Has(const string &key) const;
+
+	JsonValue &Push(const JsonValue &value);
+	JsonValue &Set(const string &key, const JsonValue &value);
+
+	string Dump() const;
+private:
+	void DumpTo(string &out) const;
+
+	Type m_type;
+	bool m_bool;
+	double m_number;
+	string m_string;
+	vector<JsonValue> m_array;
+	vector<pair<string, JsonValue>> m_object;
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "Server.hpp"
+
+void usage()
+{
+	fprintf(stderr, "usage: mondx-lsp [-b <builtin.mnd> [-s <snapshot>]] [-j <threads>]\n");
+}
+
+int main(int argc, char *argv[])
+{
+	string builtinFile;
+	string snapshotFile;
+	int threads = std::thread::hardware_concurrency();
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+
+		if ((arg == "-b" || arg == "-s") && i + 1 < argc)
+		{
+			(arg == "-b" ? builtinFile : snapshotFile) = argv[++i];
+		}
+		else if (arg == "-j" && i + 1 < argc)
+		{
+			threads = atoi(argv[++i]);
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	BuiltinScopePtr builtinScope;
+
+	if (builtinFile != "")
+	{
+		builtinScope = BuiltinScope::Parse(builtinFile, snapshotFile);
+	}
+#ifdef MONDX_COMPILED_BUILTINS
+	else
+	{
+		builtinScope.reset(new BuiltinScope(CompiledBuiltinTable));
+	}
+#endif
+
+	// stdout carries the protocol, so everything else goes to stderr. One
+	// thread is kept for the document being edited, so there are at least two.
+	LspServer server(builtinScope, threads < 2 ? 2 : threads, stdin, stdout);
+	return server.Run();
+}
@@ -0,0 +1,926 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include "Server.hpp"
+#include "../MondX/Sema.hpp"
+#include "../MondX/Lexer.hpp"
+#include "../MondX/Rename.hpp"
+#include "../MondX/Completion.hpp"
+#include "../MondX/SemanticTokens.hpp"
+
+// How long a document has to go without edits before it's checked again.
+// Only the statements an edit touches are checked again, 10 to 30 ms in a
+// file of 20,000 lines, the flow checks of the top level are what's left
+// that grows with the file. An edit that changes what's declared at the top
+// has the whole file checked, that and the first check can take far longer
+// than the 50 ms we aim for.
+static const std::chrono::milliseconds Debounce(20);
+
+// JSON-RPC error codes.
+static const int MethodNotFound = -32601;
+static const int InvalidRequest = -32600;
+static const int RequestFailed = -32803;
+
+// The protocol's completion item kinds, indexed by CompletionItem::Kind.
+static const int CompletionKinds[] = { 6, 21, 3, 3, 6, 5 };
+
+// The semantic token legend, indexed by SemanticToken::Type and by the bits
+// of SemanticToken::Modifier.
+static const char *SemanticTokenTypes[] = { "keyword", "variable", "variable", "function", "parameter", "property", "number", "string" };
+static const char *SemanticTokenModifiers[] = { "declaration", "defaultLibrary", "readonly" };
+
+// ---------------------------------------------------------------------------
+// Positions
+// ---------------------------------------------------------------------------
+
+// The protocol counts columns in UTF-16 units, the library in bytes.
+static int utf8Length(unsigned char c)
+{
+	return c < 0xC0 ? 1 : c < 0xE0 ? 2 : c < 0xF0 ? 3 : 4;
+}
+
+// Byte offset of a protocol position, positions past the end of a line or
+// the text are clamped to it.
+static size_t toOffset(const string &text, int64_t line, int64_t character)
+{
+	size_t i = 0;
+
+	for (; line > 0 && i < text.size(); i++)
+	{
+		line -= IsLineBreak(text, i);
+	}
+
+	while (character > 0 && i < text.size() && text[i] != '\n' && text[i] != '\r')
+	{
+		auto length = utf8Length(text[i]);
+		character -= length == 4 ? 2 : 1;
+		i += length;
+	}
+
+	return std::min(i, text.size());
+}
+
+static vector<size_t> lineStarts(const string &text)
+{
+	vector<size_t> lines(1, 0);
+
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (IsLineBreak(text, i))
+		{
+			lines.push_back(i + 1);
+		}
+	}
+
+	return lines;
+}
+
+static JsonValue toPosition(const string &text, const vector<size_t> &lines, Pos pos)
+{
+	auto line = std::max<int64_t>(pos.line - 1, 0);
+	auto character = 0;
+
+	if ((size_t)line < lines.size())
+	{
+		auto end = std::min(lines[line] + std::max<int64_t>(pos.column - 1, 0), text.size());
+
+		for (auto i = lines[line]; i < end; i += utf8Length(text[i]))
+		{
+			character += utf8Length(text[i]) == 4 ? 2 : 1;
+		}
+	}
+
+	auto position = JsonValue::MakeObject();
+	position.Set("line", (int64_t)line);
+	position.Set("character", character);
+	return position;
+}
+
+static JsonValue toRange(const string &text, const vector<size_t> &lines, Range range)
+{
+	auto lspRange = JsonValue::MakeObject();
+	lspRange.Set("start", toPosition(text, lines, range.beg));
+	lspRange.Set("end", toPosition(text, lines, range.end));
+	return lspRange;
+}
+
+// A protocol position as a library one, which counts from one.
+static Pos toPos(const string &text, const vector<size_t> &lines, int64_t line, int64_t character)
+{
+	line = std::max<int64_t>(0, std::min<int64_t>(line, lines.size() - 1));
+	auto offset = toOffset(text, line, character);
+	return Pos(line + 1, offset - lines[line] + 1);
+}
+
+// Semantic tokens come with byte columns too. They're in order, so each
+// line is only walked once.
+static void toUtf16(const string &text, const vector<size_t> &lines, vector<uint32_t> &data)
+{
+	size_t line = 0;
+	size_t column = 0;
+	size_t cursor = 0;
+	uint32_t character = 0;
+	uint32_t prevCharacter = 0;
+
+	auto advance = [&](size_t to)
+	{
+		to = std::min(to, text.size());
+
+		while (cursor < to)
+		{
+			auto length = utf8Length(text[cursor]);
+			character += length == 4 ? 2 : 1;
+			cursor += length;
+		}
+	};
+
+	for (size_t i = 0; i + 4 < data.size(); i += 5)
+	{
+		if (data[i] != 0 || i == 0)
+		{
+			line += data[i];
+			column = data[i + 1];
+			prevCharacter = 0;
+			cursor = line < lines.size() ? lines[line] : text.size();
+			character = 0;
+		}
+		else
+		{
+			column += data[i + 1];
+		}
+
+		auto start = line < lines.size() ? lines[line] : text.size();
+		advance(start + column);
+		auto tokenStart = character;
+		advance(start + column + data[i + 2]);
+
+		data[i + 1] = tokenStart - prevCharacter;
+		data[i + 2] = character - tokenStart;
+		prevCharacter = tokenStart;
+	}
+}
+
+static SourceInt countLineBreaks(const string &text)
+{
+	SourceInt count = 0;
+
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		count += IsLineBreak(text, i);
+	}
+
+	return count;
+}
+
+// ---------------------------------------------------------------------------
+// LspServer
+// ---------------------------------------------------------------------------
+
+LspServer::LspServer(BuiltinScopePtr builtinScope, int threads, FILE *in, FILE *out) :
+	m_builtinScope(builtinScope),
+	m_in(in),
+	m_out(out),
+	m_shutdown(false),
+	m_quit(false),
+	m_scheduler(threads)
+{
+	m_checker = std::thread([this]
+	{
+		CheckLoop();
+	});
+}
+
+LspServer::~LspServer()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+
+	m_changed.notify_all();
+	m_checker.join();
+}
+
+int LspServer::Run()
+{
+	string body;
+
+	while (ReadMessage(body))
+	{
+		JsonValue message;
+
+		if (!JsonValue::Parse(body, message) || message.GetType() != JsonValue::Object)
+		{
+			fprintf(stderr, "mondx-lsp: malformed message\n");
+			continue;
+		}
+
+		if (message["method"].AsString() == "exit")
+		{
+			auto stats = m_scheduler.GetStats();
+			fprintf(stderr, "mondx-lsp: tasks: %llu completed, %llu skipped, %llu interrupted (%llu ms wasted), %llu failed\n",
+				(unsigned long long)stats.completed, (unsigned long long)stats.skipped,
+				(unsigned long long)stats.interrupted, (unsigned long long)stats.wastedMicroseconds / 1000,
+				(unsigned long long)stats.failed);
+
+			return m_shutdown ? 0 : 1;
+		}
+
+		Handle(message);
+	}
+
+	return 1;
+}
+
+bool LspServer::ReadMessage(string &body)
+{
+	char line[1024];
+	long length = -1;
+
+	// Headers end with an empty line, Content-Length is the only one we need.
+	while (fgets(line, sizeof(line), m_in))
+	{
+		if (strcmp(line, "\r\n") == 0 || strcmp(line, "\n") == 0)
+		{
+			if (length < 0)
+			{
+				continue;
+			}
+
+			body.resize(length);
+			return fread(&body[0], 1, length, m_in) == (size_t)length;
+		}
+
+		if (strncmp(line, "Content-Length:", 15) == 0)
+		{
+			length = strtol(line + 15, NULL, 10);
+		}
+	}
+
+	return false;
+}
+
+void LspServer::Send(const JsonValue &message)
+{
+	auto body = message.Dump();
+
+	std::lock_guard<std::mutex> lock(m_outMutex);
+	fprintf(m_out, "Content-Length: %u\r\n\r\n", (unsigned)body.size());
+	fwrite(body.data(), 1, body.size(), m_out);
+	fflush(m_out);
+}
+
+void LspServer::Respond(const JsonValue &id, const JsonValue &result)
+{
+	auto response = JsonValue::MakeObject();
+	response.Set("jsonrpc", "2.0");
+	response.Set("id", id);
+	response.Set("result", result);
+	Send(response);
+}
+
+void LspServer::RespondError(const JsonValue &id, int code, const string &message)
+{
+	auto error = JsonValue::MakeObject();
+	error.Set("code", code);
+	error.Set("message", message);
+
+	auto response = JsonValue::MakeObject();
+	response.Set("jsonrpc", "2.0");
+	response.Set("id", id);
+	response.Set("error", error);
+	Send(response);
+}
+
+void LspServer::Publish(const string &uri, const vector<Diag> &diags, const string &text)
+{
+	auto lines = lineStarts(text);
+	auto list = JsonValue::MakeArray();
+
+	for (auto &diag : diags)
+	{
+		auto range = diag.range.IsValid() ? diag.range : Range(diag.caret, 1);
+
+		auto item = JsonValue::MakeObject();
+		item.Set("range", toRange(text, lines, range));
+		item.Set("severity", diag.severity == Error ? 1 : diag.severity == Warning ? 2 : 3);
+		item.Set("source", "mondx");
+		item.Set("message", diag.message);
+		list.Push(item);
+	}
+
+	auto params = JsonValue::MakeObject();
+	params.Set("uri", uri);
+	params.Set("diagnostics", list);
+
+	auto notification = JsonValue::MakeObject();
+	notification.Set("jsonrpc", "2.0");
+	notification.Set("method", "textDocument/publishDiagnostics");
+	notification.Set("params", params);
+	Send(notification);
+}
+
+void LspServer::Handle(const JsonValue &message)
+{
+	auto &method = message["method"].AsString();
+	auto &params = message["params"];
+	auto &id = message["id"];
+
+	if (method == "initialize")
+	{
+		auto sync = JsonValue::MakeObject();
+		sync.Set("openClose", true);
+		sync.Set("change", 2);
+
+		auto completion = JsonValue::MakeObject();
+		completion.Set("triggerCharacters", JsonValue::MakeArray().Push("."));
+
+		auto capabilities = JsonValue::MakeObject();
+		capabilities.Set("textDocumentSync", sync);
+		capabilities.Set("completionProvider", completion);
+		capabilities.Set("hoverProvider", true);
+		capabilities.Set("definitionProvider", true);
+		capabilities.Set("renameProvider", true);
+
+		auto tokenTypes = JsonValue::MakeArray();
+		auto tokenModifiers = JsonValue::MakeArray();
+
+		for (auto type : SemanticTokenTypes)
+		{
+			tokenTypes.Push(type);
+		}
+
+		for (auto modifier : SemanticTokenModifiers)
+		{
+			tokenModifiers.Push(modifier);
+		}
+
+		auto legend = JsonValue::MakeObject();
+		legend.Set("tokenTypes", tokenTypes);
+		legend.Set("tokenModifiers", tokenModifiers);
+
+		auto semanticTokens = JsonValue::MakeObject();
+		semanticTokens.Set("legend", legend);
+		semanticTokens.Set("full", true);
+		semanticTokens.Set("range", true);
+		capabilities.Set("semanticTokensProvider", semanticTokens);
+
+		auto info = JsonValue::MakeObject();
+		info.Set("name", "mondx-lsp");
+
+		auto result = JsonValue::MakeObject();
+		result.Set("capabilities", capabilities);
+		result.Set("serverInfo", info);
+		Respond(id, result);
+	}
+	else if (method == "shutdown")
+	{
+		m_shutdown = true;
+		Respond(id, JsonValue());
+	}
+	else if (m_shutdown && !id.IsNull())
+	{
+		RespondError(id, InvalidRequest, "server is shutting down");
+	}
+	else if (method == "textDocument/didOpen")
+	{
+		DidOpen(params);
+	}
+	else if (method == "textDocument/didChange")
+	{
+		DidChange(params);
+	}
+	else if (method == "textDocument/didClose")
+	{
+		DidClose(params);
+	}
+	else if (method == "textDocument/completion")
+	{
+		Completion(id, params);
+	}
+	else if (method == "textDocument/hover")
+	{
+		Hover(id, params);
+	}
+	else if (method == "textDocument/definition")
+	{
+		Definition(id, params);
+	}
+	else if (method == "textDocument/rename")
+	{
+		Rename(id, params);
+	}
+	else if (method == "textDocument/semanticTokens/full")
+	{
+		SemanticTokens(id, params, false);
+	}
+	else if (method == "textDocument/semanticTokens/range")
+	{
+		SemanticTokens(id, params, true);
+	}
+	else if (!id.IsNull())
+	{
+		// Notifications we don't know are fine to drop, requests need an answer.
+		RespondError(id, MethodNotFound, "unknown method '" + method + "'");
+	}
+}
+
+void LspServer::DidOpen(const JsonValue &params)
+{
+	auto &item = params["textDocument"];
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto &document = m_documents[item["uri"].AsString()];
+		document.text = item["text"].AsString();
+		document.version = item["version"].AsInt();
+		document.dirty = true;
+		document.changed = Clock::now() - Debounce;
+		document.analysis.reset(new Analysis);
+		document.edits.clear();
+		m_active = item["uri"].AsString();
+	}
+
+	m_changed.notify_one();
+}
+
+void LspServer::DidChange(const JsonValue &params)
+{
+	auto &item = params["textDocument"];
+	auto &changes = params["contentChanges"];
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_documents.find(item["uri"].AsString());
+
+		if (it == m_documents.end())
+		{
+			return;
+		}
+
+		auto &document = it->second;
+		document.check.Cancel();
+		document.version = item["version"].AsInt();
+
+		// Changes apply one after another, each to the text the last one left.
+		for (size_t i = 0; i < changes.Size(); i++)
+		{
+			auto &change = changes[i];
+			auto &text = change["text"].AsString();
+
+			LineEdit edit;
+			edit.version = document.version;
+
+			if (!change.Has("range"))
+			{
+				document.text = text;
+				edit.firstLine = 1;
+				edit.lastLine = std::numeric_limits<SourceInt>::max();
+				edit.lineDelta = 0;
+				document.edits.push_back(edit);
+				continue;
+			}
+
+			auto &range = change["range"];
+			auto &start = range["start"];
+			auto &stop = range["end"];
+			auto beg = toOffset(document.text, start["line"].AsInt(), start["character"].AsInt());
+			auto end = toOffset(document.text, stop["line"].AsInt(), stop["character"].AsInt());
+			document.text.replace(beg, std::max(beg, end) - beg, text);
+
+			edit.firstLine = start["line"].AsInt() + 1;
+			edit.lastLine = std::max(stop["line"].AsInt(), start["line"].AsInt()) + 1;
+			edit.lineDelta = countLineBreaks(text) - (edit.lastLine - edit.firstLine);
+
+			// Whole lines put in or taken out before the start of a line leave
+			// its columns where they were, so it only moves.
+			auto lineStart = stop["character"].AsInt() == 0 && (text.empty() ? start["character"].AsInt() == 0 : IsLineBreak(text, text.size() - 1));
+
+			if (lineStart)
+			{
+				edit.lastLine--;
+			}
+
+			document.edits.push_back(edit);
+		}
+
+		document.dirty = true;
+		document.changed = Clock::now();
+		m_active = it->first;
+	}
+
+	m_changed.notify_one();
+}
+
+void LspServer::DidClose(const JsonValue &params)
+{
+	auto uri = params["textDocument"]["uri"].AsString();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_documents.find(uri);
+
+		if (it != m_documents.end())
+		{
+			it->second.check.Cancel();
+			m_documents.erase(it);
+		}
+	}
+
+	Publish(uri, vector<Diag>(), "");
+}
+
+void LspServer::Completion(const JsonValue &id, const JsonValue &params)
+{
+	string text;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_documents.find(params["textDocument"]["uri"].AsString());
+
+		if (it != m_documents.end())
+		{
+			text = it->second.text;
+		}
+	}
+
+	auto &position = params["position"];
+	auto offset = toOffset(text, position["line"].AsInt(), position["character"].AsInt());
+
+	// Someone's waiting on this, so it goes ahead of any checks.
+	m_scheduler.Submit(Scheduler::Interactive, [this, id, text, offset](const CancelToken &token)
+	{
+		auto result = Complete(text, offset, m_builtinScope, token);
+		auto items = JsonValue::MakeArray();
+
+		for (size_t i = 0; i < result.items.size(); i++)
+		{
+			auto &item = result.items[i];
+			char sortText[16];
+			snprintf(sortText, sizeof(sortText), "%06u", (unsigned)i);
+
+			auto lspItem = JsonValue::MakeObject();
+			lspItem.Set("label", item.name);
+			lspItem.Set("kind", CompletionKinds[item.kind]);
+			lspItem.Set("sortText", sortText);
+
+			if (item.builtin)
+			{
+				lspItem.Set("detail", "builtin");
+			}
+
+			items.Push(lspItem);
+		}
+
+		auto list = JsonValue::MakeObject();
+		list.Set("isIncomplete", false);
+		list.Set("items", items);
+		Respond(id, list);
+	});
+}
+
+void LspServer::Hover(const JsonValue &id, const JsonValue &params)
+{
+	View view;
+	auto expr = dynamic_cast<ExprId *>(NodeAt(params, view));
+
+	if (!expr || !expr->decl)
+	{
+		Respond(id, JsonValue());
+		return;
+	}
+
+	auto decl = expr->decl;
+	auto value = string(GetDeclTypeName(decl->type)) + " " + expr->name;
+
+	if (decl->type == Decl::Function || decl->type == Decl::Sequence)
+	{
+		value += "(" + std::to_string(decl->arity) + (decl->varargs ? "+" : "") + " args)";
+	}
+
+	if (!decl->scope)
+	{
+		value += ", builtin";
+	}
+
+	auto contents = JsonValue::MakeObject();
+	contents.Set("kind", "plaintext");
+	contents.Set("value", value);
+
+	auto result = JsonValue::MakeObject();
+	result.Set("contents", contents);
+	result.Set("range", toRange(view.text, view.lines, Moved(view, expr->range)));
+	Respond(id, result);
+}
+
+void LspServer::Definition(const JsonValue &id, const JsonValue &params)
+{
+	View view;
+	auto expr = dynamic_cast<ExprId *>(NodeAt(params, view));
+
+	// Builtins aren't declared anywhere the client can open, and a
+	// declaration an edit has since touched may not be there anymore.
+	auto range = expr && expr->decl && expr->decl->scope ? Moved(view, expr->decl->range) : Range();
+
+	if (!range.IsValid())
+	{
+		Respond(id, JsonValue());
+		return;
+	}
+
+	auto location = JsonValue::MakeObject();
+	location.Set("uri", params["textDocument"]["uri"]);
+	location.Set("range", toRange(view.text, view.lines, range));
+	Respond(id, location);
+}
+
+void LspServer::Rename(const JsonValue &id, const JsonValue &params)
+{
+	auto uri = params["textDocument"]["uri"].AsString();
+	string text;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_documents.find(uri);
+
+		if (it != m_documents.end())
+		{
+			text = it->second.text;
+		}
+	}
+
+	auto &position = params["position"];
+	auto newName = params["newName"].AsString();
+
+	m_scheduler.Submit(Scheduler::Interactive, [this, id, uri, text, position, newName](const CancelToken &)
+	{
+		// Other documents aren't files we can read, so an undeclared name is
+		// only renamed in this one.
+		auto lines = lineStarts(text);
+		auto pos = toPos(text, lines, position["line"].AsInt(), position["character"].AsInt());
+		auto result = Mond::Rename(uri, text, pos, newName, m_builtinScope);
+
+		if (result.error != "")
+		{
+			RespondError(id, RequestFailed, result.error);
+			return;
+		}
+
+		auto edits = JsonValue::MakeArray();
+
+		for (auto &file : result.files)
+		{
+			for (auto &range : file.ranges)
+			{
+				auto edit = JsonValue::MakeObject();
+				edit.Set("range", toRange(text, lines, range));
+				edit.Set("newText", newName);
+				edits.Push(edit);
+			}
+		}
+
+		auto changes = JsonValue::MakeObject();
+		changes.Set(uri, edits);
+
+		auto workspaceEdit = JsonValue::MakeObject();
+		workspaceEdit.Set("changes", changes);
+		Respond(id, workspaceEdit);
+	});
+}
+
+void LspServer::SemanticTokens(const JsonValue &id, const JsonValue &params, bool range)
+{
+	string text;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_documents.find(params["textDocument"]["uri"].AsString());
+
+		if (it != m_documents.end())
+		{
+			text = it->second.text;
+		}
+	}
+
+	// Lines are all that's needed of the range, whole ones are classified.
+	SourceInt firstLine = 0;
+	SourceInt lastLine = 0;
+
+	if (range)
+	{
+		firstLine = params["range"]["start"]["line"].AsInt() + 1;
+		lastLine = params["range"]["end"]["line"].AsInt() + 1;
+	}
+
+	// Highlighting is what the user sees first on opening a file.
+	m_scheduler.Submit(Scheduler::Interactive, [this, id, text, range, firstLine, lastLine](const CancelToken &token)
+	{
+		auto tokens = range ?
+			ClassifyTokens(text, firstLine, lastLine, m_builtinScope, token) :
+			ClassifyTokens(text, m_builtinScope, token);
+
+		toUtf16(text, lineStarts(text), tokens);
+
+		auto data = JsonValue::MakeArray();
+
+		for (auto n : tokens)
+		{
+			data.Push((int64_t)n);
+		}
+
+		auto result = JsonValue::MakeObject();
+		result.Set("data", data);
+		Respond(id, result);
+	});
+}
+
+// Where a range of the checked tree is after the edits made since, invalid if
+// an edit took out its first line.
+Range LspServer::Moved(const View &view, Range range)
+{
+	for (auto &edit : view.edits)
+	{
+		if (range.beg.line < edit.firstLine)
+		{
+			continue;
+		}
+		else if (range.beg.line <= edit.lastLine)
+		{
+			return Range();
+		}
+
+		range.beg.line += edit.lineDelta;
+		range.end.line += edit.lineDelta;
+	}
+
+	return range;
+}
+
+AstNode *LspServer::NodeAt(const JsonValue &params, View &view)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_documents.find(params["textDocument"]["uri"].AsString());
+
+		if (it == m_documents.end())
+		{
+			return NULL;
+		}
+
+		view.text = it->second.text;
+		view.edits = it->second.edits;
+		view.analysis = it->second.analysis;
+	}
+
+	view.lock = std::unique_lock<std::mutex>(view.analysis->mutex);
+
+	if (!view.analysis->file)
+	{
+		return NULL;
+	}
+
+	auto version = view.analysis->version;
+
+	view.edits.erase(std::remove_if(view.edits.begin(), view.edits.end(), [version](const LineEdit &edit)
+	{
+		return edit.version <= version;
+	}), view.edits.end());
+
+	view.lines = lineStarts(view.text);
+
+	auto &position = params["position"];
+	auto pos = toPos(view.text, view.lines, position["line"].AsInt(), position["character"].AsInt());
+
+	// Back through the edits to where it was when checked, the lines an edit
+	// put in weren't there.
+	for (auto it = view.edits.rbegin(); it != view.edits.rend(); ++it)
+	{
+		if (pos.line < it->firstLine)
+		{
+			continue;
+		}
+		else if (pos.line <= it->lastLine + it->lineDelta)
+		{
+			return NULL;
+		}
+
+		pos.line -= it->lineDelta;
+	}
+
+	return view.analysis->file->GetIndex().NodeAt(pos);
+}
+
+void LspServer::CheckLoop()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (!m_quit)
+	{
+		// The document that's been quiet longest goes first.
+		auto next = m_documents.end();
+
+		for (auto it = m_documents.begin(); it != m_documents.end(); ++it)
+		{
+			if (it->second.dirty && (next == m_documents.end() || it->second.changed < next->second.changed))
+			{
+				next = it;
+			}
+		}
+
+		if (next == m_documents.end())
+		{
+			m_changed.wait(lock);
+			continue;
+		}
+
+		auto due = next->second.changed + Debounce;
+
+		if (Clock::now() < due)
+		{
+			m_changed.wait_until(lock, due);
+			continue;
+		}
+
+		auto uri = next->first;
+		auto text = next->second.text;
+		auto version = next->second.version;
+		auto priority = uri == m_active ? Scheduler::Interactive : Scheduler::Background;
+		next->second.dirty = false;
+
+		auto analysis = next->second.analysis;
+		next->second.check = m_scheduler.Submit(priority, [this, uri, text, version, analysis](const CancelToken &token)
+		{
+			vector<Diag> diags;
+
+			if (!Check(analysis, text, version, token, diags))
+			{
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = m_documents.find(uri);
+
+			if (it == m_documents.end() || it->second.analysis != analysis)
+			{
+				return;
+			}
+
+			// Positions only have to go through the edits made since.
+			auto &edits = it->second.edits;
+
+			edits.erase(std::remove_if(edits.begin(), edits.end(), [version](const LineEdit &edit)
+			{
+				return edit.version <= version;
+			}), edits.end());
+
+			// Anything edited while we were checking is stale, an edit will
+			// have marked it dirty again.
+			if (it->second.version == version && !it->second.dirty)
+			{
+				Publish(uri, diags, text);
+			}
+		});
+	}
+}
+
+// Brings the analysis up to text, checking again only the statements the
+// edits since the last check touched when it can. False if another check got
+// it there first.
+bool LspServer::Check(AnalysisPtr analysis, const string &text, int64_t version, const CancelToken &token, vector<Diag> &diags)
+{
+	{
+		std::lock_guard<std::mutex> lock(analysis->mutex);
+
+		if (analysis->version >= version)
+		{
+			return false;
+		}
+
+		if (analysis->file && analysis->file->Update(text))
+		{
+			analysis->version = version;
+			diags = analysis->file->GetDiags();
+			return true;
+		}
+
+		// Hover and definition go without until it's checked from scratch,
+		// which is too slow to do under the lock.
+		analysis->file.reset();
+		analysis->version = -1;
+	}
+
+	unique_ptr<CheckedFile> file(new CheckedFile(text, m_builtinScope, token));
+	std::lock_guard<std::mutex> lock(analysis->mutex);
+
+	if (analysis->version >= version)
+	{
+		return false;
+	}
+
+	diags = file->GetDiags();
+	analysis->file = std::move(file);
+	analysis->version = version;
+	return true;
+}
@@ -0,0 +1,124 @@
+#ifndef MOND_LSP_SERVER_HPP
+#define MOND_LSP_SERVER_HPP
+
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <condition_variable>
+#include "Json.hpp"
+#include "../MondX/Diag.hpp"
+#include "../MondX/CheckedFile.hpp"
+#include "../MondX/Scheduler.hpp"
+#include "../MondX/BuiltinScope.hpp"
+
+// Speaks the language server protocol on a pair of streams. Edits are
+// applied on the reading thread as they arrive, a document is checked a short
+// while after it stops changing, so a burst of keystrokes is checked once.
+// Checks run on a scheduler, the document being edited goes before the rest,
+// and an edit cancels any check of the text it replaced.
+class LspServer
+{
+public:
+	LspServer(BuiltinScopePtr builtinScope, int threads, FILE *in, FILE *out);
+	~LspServer();
+
+	// Serves until the client sends exit or closes the stream, returns the
+	// process exit status.
+	int Run();
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	// Lines firstLine to lastLine of the text were replaced with lines that
+	// are lineDelta more or fewer, making the document version. Lines only put
+	// in or taken out touch no line, lastLine is then the one before
+	// firstLine.
+	struct LineEdit
+	{
+		SourceInt firstLine;
+		SourceInt lastLine;
+		SourceInt lineDelta;
+		int64_t version;
+	};
+
+	// A document as of its last check, kept for hover and go to definition
+	// and brought up to the next version by checking only what changed.
+	// Checks update it in place, so it's only used under its lock. Positions
+	// in the tree go through the edits since version to get to where they
+	// are in the text.
+	struct Analysis
+	{
+		Analysis() : version(-1)
+		{
+		}
+
+		std::mutex mutex;
+		unique_ptr<CheckedFile> file;
+		int64_t version;
+	};
+
+	typedef shared_ptr<Analysis> AnalysisPtr;
+
+	struct Document
+	{
+		string text;
+		int64_t version;
+		bool dirty;
+		Clock::time_point changed;
+		CancelToken check;
+		AnalysisPtr analysis;
+		vector<LineEdit> edits;
+	};
+
+	// The analysis of a document locked, with what's needed to find the
+	// current text's positions in it.
+	struct View
+	{
+		string text;
+		vector<size_t> lines;
+		vector<LineEdit> edits;
+		AnalysisPtr analysis;
+		std::unique_lock<std::mutex> lock;
+	};
+
+	bool ReadMessage(string &body);
+	void Send(const JsonValue &message);
+	void Respond(const JsonValue &id, const JsonValue &result);
+	void RespondError(const JsonValue &id, int code, const string &message);
+	void Publish(const string &uri, const vector<Diag> &diags, const string &text);
+
+	void Handle(const JsonValue &message);
+	void DidOpen(const JsonValue &params);
+	void DidChange(const JsonValue &params);
+	void DidClose(const JsonValue &params);
+	void Completion(const JsonValue &id, const JsonValue &params);
+	void Hover(const JsonValue &id, const JsonValue &params);
+	void Definition(const JsonValue &id, const JsonValue &params);
+	void Rename(const JsonValue &id, const JsonValue &params);
+	void SemanticTokens(const JsonValue &id, const JsonValue &params, bool range);
+
+	// The checked node under a protocol position, NULL if there's none or an
+	// edit since the check touched its line.
+	AstNode *NodeAt(const JsonValue &params, View &view);
+	static Range Moved(const View &view, Range range);
+
+	void CheckLoop();
+	bool Check(AnalysisPtr analysis, const string &text, int64_t version, const CancelToken &token, vector<Diag> &diags);
+
+	BuiltinScopePtr m_builtinScope;
+	FILE *m_in;
+	FILE *m_out;
+	bool m_shutdown;
+
+	std::mutex m_outMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	unordered_map<string, Document> m_documents;
+	string m_active;
+	bool m_quit;
+	std::thread m_checker;
+
+	// Last, so it's gone before anything its tasks use.
+	Scheduler m_scheduler;
+};
+
+#endif
@@ -7,7 +7,11 @@
 
 namespace Mond
 {
-	struct AstNode
+	typedef shared_ptr<struct ConstValue> ConstValuePtr;
+
+	struct Decl;
+
+	struct AstNode : public std::enable_shared_from_this<AstNode>
 	{
 		virtual ~AstNode() {}
 		virtual void Accept(Visitor *) = 0;
@@ -18,8 +22,13 @@ namespace Mond
 
 	struct Expr : public AstNode
 	{
+		Expr() : folded(false) {}
+
 		virtual bool IsConstant() { return false; }
 		virtual bool IsStorable() { return false; }
+
+		bool folded;
+		ConstValuePtr constant;
 	};
 
 	struct Stmt : public AstNode
@@ -35,6 +44,16 @@ namespace Mond
 	typedef shared_ptr<Stmt> StmtPtr;
 	typedef vector<StmtPtr> StmtPtrList;
 
+	// A name introduced by a declaration, kept in the tree so Sema can declare
+	// it without the parser.
+	struct DeclName
+	{
+		string name;
+		Range range;
+	};
+
+	typedef vector<DeclName> DeclNameList;
+
 	// --------------------------------------------------------------------------
 	// Expressions
 	// --------------------------------------------------------------------------
@@ -82,12 +101,33 @@ namespace Mond
 		ExprPtr left;
 	};
 
+	struct Binding
+	{
+		enum Kind
+		{
+			Global,
+			Local,
+			Upvalue,
+			Builtin
+		};
+
+		Binding() : kind(Global), depth(0), index(-1) {}
+
+		Kind kind;
+		int depth;
+		int index;
+	};
+
 	struct ExprId : public Expr
 	{
+		ExprId() : decl(NULL) {}
+
 		void Accept(Visitor *v) { v->Visit(this); }
 		bool IsStorable() { return true; }
 
 		string name;
+		const Decl *decl;
+		Binding binding;
 	};
 
 	struct ExprIndexAccess : public Expr
@@ -101,11 +141,14 @@ namespace Mond
 
 	struct ExprLambda : public Expr
 	{
+		ExprLambda() : varargs(false), sequence(false) {}
+
 		void Accept(Visitor *v) { v->Visit(this); }
 
 		bool varargs;
 		bool sequence;
 		StmtPtr body;
+		DeclNameList arguments;
 	};
 
 	struct ExprNumberLiteral : public Expr
@@ -208,19 +251,28 @@ namespace Mond
 
 	struct StmtForeach : public Stmt
 	{
+		StmtForeach() : decl(NULL) {}
+
 		void Accept(Visitor *v) { v->Visit(this); }
 
+		DeclName name;
 		ExprPtr from;
 		StmtPtr body;
+		const Decl *decl;
 	};
 
 	struct StmtFunDecl : public Stmt
 	{
+		StmtFunDecl() : varargs(false), sequence(false), decl(NULL) {}
+
 		void Accept(Visitor *v) { v->Visit(this); }
 
 		bool varargs;
 		bool sequence;
+		DeclName name;
+		DeclNameList arguments;
 		StmtPtr body;
+		const Decl *decl;
 	};
 
 	struct StmtIfElse : public Stmt
@@ -266,7 +318,10 @@ namespace Mond
 	{
 		void Accept(Visitor *v) { v->Visit(this); }
 
+		TokenType type;
+		DeclNameList names;
 		ExprPtrList values;
+		vector<const Decl *> decls;
 	};
 
 	struct StmtWhile : public Stmt
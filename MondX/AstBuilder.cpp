@@ -0,0 +1,318 @@
+#include "AstBuilder.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+template<class T>
+static T *NewNode(Pos pos, Range range)
+{
+	auto node = new T;
+	node->pos = pos;
+	node->range = range;
+	return node;
+}
+
+// ---------------------------------------------------------------------------
+// Builder interface
+// ---------------------------------------------------------------------------
+
+AstBuilder::AstBuilder(Source &source) : m_source(source)
+{
+}
+
+Pos AstBuilder::Beg(const ExprRef &expr, Pos fallback) const
+{
+	return expr ? expr->range.beg : fallback;
+}
+
+Pos AstBuilder::End(const ExprRef &expr, Pos fallback) const
+{
+	return expr ? expr->range.end : fallback;
+}
+
+Pos AstBuilder::End(const StmtRef &stmt, Pos fallback) const
+{
+	return stmt ? stmt->range.end : fallback;
+}
+
+string AstBuilder::IdString(Slice s)
+{
+	return m_source.GetSlice(s);
+}
+
+string AstBuilder::LiteralString(Slice s)
+{
+	// TODO: Implement.
+	return m_source.GetSlice(s);
+}
+
+double AstBuilder::LiteralNumber(Slice s)
+{
+	// TODO: Yeah uh, this ain't gonna work. Handle 0x 0b and underscores.
+	return strtod(m_source.GetSlice(s).c_str(), NULL);
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+// ---------------------------------------------------------------------------
+
+ExprPtr AstBuilder::Id(const Token &token)
+{
+	auto expr = NewNode<ExprId>(token.range.beg, token.range);
+	expr->name = IdString(token.slice);
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::StringLiteral(const Token &token)
+{
+	auto expr = NewNode<ExprStringLiteral>(token.range.beg, token.range);
+	expr->contents = LiteralString(token.slice);
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::NumberLiteral(const Token &token)
+{
+	auto expr = NewNode<ExprNumberLiteral>(token.range.beg, token.range);
+	expr->value = LiteralNumber(token.slice);
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::SimpleLiteral(const Token &token)
+{
+	auto expr = NewNode<ExprSimpleLiteral>(token.range.beg, token.range);
+	expr->type = token.type;
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::Parens(ExprPtr expr, Range range)
+{
+	if (expr)
+	{
+		expr->range = range;
+	}
+
+	return expr;
+}
+
+ExprPtr AstBuilder::ObjectLiteral(Pos pos, Range range, EntryList &entries)
+{
+	auto expr = NewNode<ExprObjectLiteral>(pos, range);
+	expr->entries.swap(entries);
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::ArrayLiteral(Pos pos, Range range, ExprPtrList &elems)
+{
+	auto expr = NewNode<ExprArrayLiteral>(pos, range);
+	expr->elems.swap(elems);
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::Yield(Pos pos, Range range, ExprPtr value)
+{
+	auto expr = NewNode<ExprYield>(pos, range);
+	expr->value = value;
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::Call(Pos pos, Range range, ExprPtr left, ExprPtrList &args)
+{
+	auto expr = NewNode<ExprCall>(pos, range);
+	expr->left = left;
+	expr->args.swap(args);
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::IndexAccess(Pos pos, Range range, ExprPtr left, ExprPtr index)
+{
+	auto expr = NewNode<ExprIndexAccess>(pos, range);
+	expr->left = left;
+	expr->index = index;
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::FieldAccess(Pos pos, Range range, ExprPtr left, const Token &member)
+{
+	auto expr = NewNode<ExprFieldAccess>(pos, range);
+	expr->left = left;
+	expr->name = IdString(member.slice);
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::UnaryOp(Pos pos, Range range, TokenType type, bool post, ExprPtr value)
+{
+	auto expr = NewNode<ExprUnaryOp>(pos, range);
+	expr->type = type;
+	expr->post = post;
+	expr->value = value;
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::BinaryOp(Pos pos, Range range, TokenType type, ExprPtr left, ExprPtr right)
+{
+	auto expr = NewNode<ExprBinaryOp>(pos, range);
+	expr->type = type;
+	expr->left = left;
+	expr->right = right;
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::TernaryOp(Pos pos, Range range, ExprPtr cond, ExprPtr thenExpr, ExprPtr elseExpr)
+{
+	auto expr = NewNode<ExprTernaryOp>(pos, range);
+	expr->cond = cond;
+	expr->thenExpr = thenExpr;
+	expr->elseExpr = elseExpr;
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::Lambda(Pos pos, Range range, bool sequence, bool varargs, DeclNameList &arguments, StmtPtr body)
+{
+	auto expr = NewNode<ExprLambda>(pos, range);
+	expr->sequence = sequence;
+	expr->varargs = varargs;
+	expr->arguments.swap(arguments);
+	expr->body = body;
+	return ExprPtr(expr);
+}
+
+ExprPtr AstBuilder::ArraySlice(Pos pos, Range range, ExprPtr left, ExprPtr start, ExprPtr end, ExprPtr step)
+{
+	auto expr = NewNode<ExprArraySlice>(pos, range);
+	expr->left = left;
+	expr->start = start;
+	expr->end = end;
+	expr->step = step;
+	return ExprPtr(expr);
+}
+
+DeclName AstBuilder::Name(const Token &token)
+{
+	DeclName name = { IdString(token.slice), token.range };
+	return name;
+}
+
+ExprObjectLiteral::KeyValue AstBuilder::Entry(const Token &key, ExprPtr value)
+{
+	ExprObjectLiteral::KeyValue entry;
+	entry.key = key.type == TokStringLiteral ? LiteralString(key.slice) : IdString(key.slice);
+	entry.value = value;
+	return entry;
+}
+
+// ---------------------------------------------------------------------------
+// Statements
+// ---------------------------------------------------------------------------
+
+StmtPtr AstBuilder::Block(Pos pos, Range range, StmtPtrList &statements)
+{
+	auto stmt = NewNode<StmtBlock>(pos, range);
+	stmt->statements.swap(statements);
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::Control(Pos pos, Range range, TokenType type)
+{
+	auto stmt = NewNode<StmtControl>(pos, range);
+	stmt->type = type;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::DoWhile(Pos pos, Range range, StmtPtr body, ExprPtr cond)
+{
+	auto stmt = NewNode<StmtDoWhile>(pos, range);
+	stmt->body = body;
+	stmt->cond = cond;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::For(Pos pos, Range range, StmtPtr init, ExprPtr cond, ExprPtrList &steps, StmtPtr body)
+{
+	auto stmt = NewNode<StmtFor>(pos, range);
+	stmt->init = init;
+	stmt->cond = cond;
+	stmt->steps.swap(steps);
+	stmt->body = body;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::Foreach(Pos pos, Range range, DeclName name, ExprPtr from, StmtPtr body)
+{
+	auto stmt = NewNode<StmtForeach>(pos, range);
+	stmt->name = name;
+	stmt->from = from;
+	stmt->body = body;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::FunDecl(Pos pos, Range range, bool sequence, DeclName name, bool varargs, DeclNameList &arguments, StmtPtr body)
+{
+	auto stmt = NewNode<StmtFunDecl>(pos, range);
+	stmt->sequence = sequence;
+	stmt->name = name;
+	stmt->varargs = varargs;
+	stmt->arguments.swap(arguments);
+	stmt->body = body;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::IfElse(Pos pos, Range range, ExprPtr cond, StmtPtr thenBody, StmtPtr elseBody)
+{
+	auto stmt = NewNode<StmtIfElse>(pos, range);
+	stmt->cond = cond;
+	stmt->thenBody = thenBody;
+	stmt->elseBody = elseBody;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::Return(Pos pos, Range range, ExprPtr value)
+{
+	auto stmt = NewNode<StmtReturn>(pos, range);
+	stmt->value = value;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::VarDecl(Pos pos, Range range, TokenType type, DeclNameList &names, ExprPtrList &values)
+{
+	auto stmt = NewNode<StmtVarDecl>(pos, range);
+	stmt->type = type;
+	stmt->names.swap(names);
+	stmt->values.swap(values);
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::Switch(Pos pos, Range range, ExprPtr value, CaseList &cases)
+{
+	auto stmt = NewNode<StmtSwitch>(pos, range);
+	stmt->value = value;
+	stmt->cases.swap(cases);
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::While(Pos pos, Range range, ExprPtr cond, StmtPtr body)
+{
+	auto stmt = NewNode<StmtWhile>(pos, range);
+	stmt->cond = cond;
+	stmt->body = body;
+	return StmtPtr(stmt);
+}
+
+StmtPtr AstBuilder::NakedExpr(Pos pos, Range range, ExprPtr value)
+{
+	auto stmt = NewNode<StmtNakedExpr>(pos, range);
+	stmt->value = value;
+	return StmtPtr(stmt);
+}
+
+StmtSwitch::Case AstBuilder::Case(bool def, Range headRange, ExprPtr value, StmtPtrList &body)
+{
+	StmtSwitch::Case switchCase;
+	switchCase.def = def;
+	switchCase.headRange = headRange;
+	switchCase.value = value;
+	switchCase.body.swap(body);
+	return switchCase;
+}
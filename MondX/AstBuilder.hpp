@@ -0,0 +1,93 @@
+#ifndef MOND_AST_BUILDER_HPP
+#define MOND_AST_BUILDER_HPP
+
+#include "AST.hpp"
+#include "Source.hpp"
+
+namespace Mond
+{
+	// Tree policy for BasicParser that builds the syntax tree. The parser
+	// works out positions and ranges and hands every finished production
+	// here; lists are swapped into the nodes, so they're left empty.
+	class AstBuilder
+	{
+	public:
+		typedef ExprPtr ExprRef;
+		typedef StmtPtr StmtRef;
+		typedef DeclName NameRef;
+		typedef ExprObjectLiteral::KeyValue EntryRef;
+		typedef StmtSwitch::Case CaseRef;
+
+		typedef ExprPtrList ExprList;
+		typedef StmtPtrList StmtList;
+		typedef DeclNameList NameList;
+		typedef vector<EntryRef> EntryList;
+		typedef vector<CaseRef> CaseList;
+
+		explicit AstBuilder(Source &source);
+
+		// -------------------------------------------------------------------
+		// Ranges
+		// -------------------------------------------------------------------
+
+		Pos Beg(const ExprRef &expr, Pos fallback) const;
+		Pos End(const ExprRef &expr, Pos fallback) const;
+		Pos End(const StmtRef &stmt, Pos fallback) const;
+
+		// -------------------------------------------------------------------
+		// Expressions
+		// -------------------------------------------------------------------
+
+		ExprRef Id(const Token &token);
+		ExprRef StringLiteral(const Token &token);
+		ExprRef NumberLiteral(const Token &token);
+		ExprRef SimpleLiteral(const Token &token);
+
+		ExprRef Parens(ExprRef expr, Range range);
+		ExprRef ObjectLiteral(Pos pos, Range range, EntryList &entries);
+		ExprRef ArrayLiteral(Pos pos, Range range, ExprList &elems);
+
+		ExprRef Yield(Pos pos, Range range, ExprRef value);
+
+		ExprRef Call(Pos pos, Range range, ExprRef left, ExprList &args);
+		ExprRef IndexAccess(Pos pos, Range range, ExprRef left, ExprRef index);
+		ExprRef FieldAccess(Pos pos, Range range, ExprRef left, const Token &member);
+
+		ExprRef UnaryOp(Pos pos, Range range, TokenType type, bool post, ExprRef value);
+		ExprRef BinaryOp(Pos pos, Range range, TokenType type, ExprRef left, ExprRef right);
+		ExprRef TernaryOp(Pos pos, Range range, ExprRef cond, ExprRef thenExpr, ExprRef elseExpr);
+
+		ExprRef Lambda(Pos pos, Range range, bool sequence, bool varargs, NameList &arguments, StmtRef body);
+		ExprRef ArraySlice(Pos pos, Range range, ExprRef left, ExprRef start, ExprRef end, ExprRef step);
+
+		NameRef Name(const Token &token);
+		EntryRef Entry(const Token &key, ExprRef value);
+
+		// -------------------------------------------------------------------
+		// Statements
+		// -------------------------------------------------------------------
+
+		StmtRef Block(Pos pos, Range range, StmtList &statements);
+		StmtRef Control(Pos pos, Range range, TokenType type);
+		StmtRef DoWhile(Pos pos, Range range, StmtRef body, ExprRef cond);
+		StmtRef For(Pos pos, Range range, StmtRef init, ExprRef cond, ExprList &steps, StmtRef body);
+		StmtRef Foreach(Pos pos, Range range, NameRef name, ExprRef from, StmtRef body);
+		StmtRef FunDecl(Pos pos, Range range, bool sequence, NameRef name, bool varargs, NameList &arguments, StmtRef body);
+		StmtRef IfElse(Pos pos, Range range, ExprRef cond, StmtRef thenBody, StmtRef elseBody);
+		StmtRef Return(Pos pos, Range range, ExprRef value);
+		StmtRef VarDecl(Pos pos, Range range, TokenType type, NameList &names, ExprList &values);
+		StmtRef Switch(Pos pos, Range range, ExprRef value, CaseList &cases);
+		StmtRef While(Pos pos, Range range, ExprRef cond, StmtRef body);
+
+		StmtRef NakedExpr(Pos pos, Range range, ExprRef value);
+		CaseRef Case(bool def, Range headRange, ExprRef value, StmtList &body);
+	private:
+		string IdString(Slice s);
+		string LiteralString(Slice s);
+		double LiteralNumber(Slice s);
+
+		Source &m_source;
+	};
+}
+
+#endif
@@ -0,0 +1,479 @@
+#include <cstring>
+#include <algorithm>
+#include "Hash.hpp"
+#include "Parser.hpp"
+#include "MappedFile.hpp"
+#include "FileSystem.hpp"
+#include "BuiltinScope.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Snapshot format
+// ---------------------------------------------------------------------------
+
+// A snapshot is a header, followed by one entry per declaration, followed by
+// a pool holding the names and string constants. Everything is stored in the
+// byte order of the machine that wrote it.
+
+static const char SnapshotMagic[4] = { 'M', 'X', 'B', 'S' };
+static const uint32_t SnapshotVersion = 1;
+
+struct SnapshotHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t sourceHash;
+	uint32_t count;
+	uint32_t poolSize;
+};
+
+struct SnapshotEntry
+{
+	uint32_t name;
+	uint32_t nameLength;
+	uint32_t contents;
+	uint32_t contentsLength;
+	int32_t arity;
+	int32_t range[4];
+	uint8_t type;
+	uint8_t constant;
+	uint8_t varargs;
+	uint8_t padding;
+	double number;
+};
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static ExprPtr MakeConstantExpr(const BuiltinEntry &entry)
+{
+	Expr *expr;
+	auto value = new ConstValue;
+	value->type = (ConstValue::Type)(entry.constant - 1);
+	value->number = entry.number;
+
+	switch (value->type)
+	{
+	case ConstValue::Number:
+	{
+		auto literal = new ExprNumberLiteral;
+		literal->value = value->number;
+		expr = literal;
+		break;
+	}
+	case ConstValue::String:
+	{
+		auto literal = new ExprStringLiteral;
+		literal->contents = string(entry.contents, entry.contentsLength);
+		value->contents = literal->contents;
+		expr = literal;
+		break;
+	}
+	default:
+	{
+		auto literal = new ExprSimpleLiteral;
+		literal->type =
+			value->type == ConstValue::Undefined ? KwUndefined :
+			value->type == ConstValue::Null ? KwNull :
+			value->type == ConstValue::True ? KwTrue : KwFalse;
+		expr = literal;
+		break;
+	}
+	}
+
+	expr->folded = true;
+	expr->constant = ConstValuePtr(value);
+	return ExprPtr(expr);
+}
+
+static Decl MakeDecl(const BuiltinEntry &entry, uint32_t index)
+{
+	Decl decl;
+	decl.slot = index;
+	decl.arity = entry.arity;
+	decl.varargs = entry.varargs;
+	decl.captured = false;
+	decl.initialized = false;
+	decl.type = entry.type;
+	decl.range = Range(Pos(entry.range[0], entry.range[1]), Pos(entry.range[2], entry.range[3]));
+	decl.scope = NULL;
+
+	if (entry.constant)
+	{
+		decl.value = MakeConstantExpr(entry);
+	}
+
+	return decl;
+}
+
+static uint64_t HashName(const char *name, uint32_t length, uint64_t seed)
+{
+	return HashBytes(name, length, seed);
+}
+
+// Hash and displace: names are spread over buckets, then each bucket,
+// largest first, searches for a seed that sends all of its names to free
+// slots. Keeping the slot table at most half full makes that search short.
+static void BuildPerfectHash(const vector<BuiltinEntry> &entries, vector<uint32_t> &seeds, vector<int32_t> &slots)
+{
+	uint32_t slotCount = 2;
+	while (slotCount < entries.size() * 2)
+	{
+		slotCount *= 2;
+	}
+
+	auto bucketCount = std::max<uint32_t>(1, entries.size() / 2);
+	vector<vector<uint32_t>> buckets(bucketCount);
+
+	for (uint32_t i = 0; i < entries.size(); i++)
+	{
+		auto &entry = entries[i];
+		buckets[HashName(entry.name, entry.nameLength, 0) % bucketCount].push_back(i);
+	}
+
+	vector<uint32_t> order(bucketCount);
+	for (uint32_t i = 0; i < bucketCount; i++)
+	{
+		order[i] = i;
+	}
+
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return buckets[a].size() > buckets[b].size();
+	});
+
+	seeds.assign(bucketCount, 0);
+	slots.assign(slotCount, -1);
+
+	vector<uint32_t> taken;
+
+	for (auto b : order)
+	{
+		auto &bucket = buckets[b];
+		if (bucket.empty())
+		{
+			break;
+		}
+
+		for (uint32_t seed = 1;; seed++)
+		{
+			if (seed == 0x1000000)
+			{
+				throw logic_error("unable to build builtin hash table");
+			}
+
+			taken.clear();
+
+			for (auto i : bucket)
+			{
+				auto &entry = entries[i];
+				uint32_t slot = HashName(entry.name, entry.nameLength, seed) & (slotCount - 1);
+
+				if (slots[slot] != -1 || std::find(taken.begin(), taken.end(), slot) != taken.end())
+				{
+					break;
+				}
+
+				taken.push_back(slot);
+			}
+
+			if (taken.size() == bucket.size())
+			{
+				for (uint32_t i = 0; i < bucket.size(); i++)
+				{
+					slots[taken[i]] = bucket[i];
+				}
+
+				seeds[b] = seed;
+				break;
+			}
+		}
+	}
+}
+
+// ---------------------------------------------------------------------------
+// BuiltinScope
+// ---------------------------------------------------------------------------
+
+BuiltinScope::BuiltinScope()
+{
+}
+
+BuiltinScope::BuiltinScope(const Scope &scope)
+{
+	ConstFolder folder;
+	vector<uint32_t> offsets;
+
+	// Entries go in name order, so the table, snapshots and generated source
+	// don't depend on the order the scope's map iterates in.
+	typedef const std::pair<const string, Decl> *NamedDecl;
+	vector<NamedDecl> sorted;
+
+	for (auto &pair : scope.decls)
+	{
+		sorted.push_back(&pair);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](NamedDecl a, NamedDecl b)
+	{
+		return a->first < b->first;
+	});
+
+	for (auto named : sorted)
+	{
+		auto &pair = *named;
+		auto &decl = pair.second;
+		auto constant = decl.type == Decl::Constant ? folder.Fold(decl.value.get()) : NULL;
+
+		BuiltinEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.nameLength = pair.first.size();
+		entry.type = decl.type;
+		entry.range[0] = (int32_t)decl.range.beg.line;
+		entry.range[1] = (int32_t)decl.range.beg.column;
+		entry.range[2] = (int32_t)decl.range.end.line;
+		entry.range[3] = (int32_t)decl.range.end.column;
+		entry.arity = decl.arity;
+		entry.varargs = decl.varargs;
+
+		offsets.push_back(m_pool.size());
+		m_pool += pair.first;
+
+		offsets.push_back(m_pool.size());
+
+		if (constant)
+		{
+			entry.constant = constant->type + 1;
+			entry.number = constant->number;
+			entry.contentsLength = constant->contents.size();
+			m_pool += constant->contents;
+		}
+
+		m_entries.push_back(entry);
+	}
+
+	Freeze(offsets);
+}
+
+BuiltinScope::BuiltinScope(const BuiltinTable &table) : m_table(table)
+{
+	m_decls.reserve(table.count);
+
+	for (uint32_t i = 0; i < table.count; i++)
+	{
+		m_decls.push_back(MakeDecl(table.entries[i], i));
+	}
+}
+
+BuiltinScopePtr BuiltinScope::Load(const string &filename, uint64_t sourceHash)
+{
+	MappedFile file(filename);
+	if (!file.IsValid() || file.Size() < sizeof(SnapshotHeader))
+	{
+		return NULL;
+	}
+
+	SnapshotHeader header;
+	memcpy(&header, file.Data(), sizeof(header));
+
+	if (memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 ||
+		header.version != SnapshotVersion ||
+		header.sourceHash != sourceHash ||
+		file.Size() != sizeof(header) + (size_t)header.count * sizeof(SnapshotEntry) + header.poolSize)
+	{
+		return NULL;
+	}
+
+	auto data = file.Data() + sizeof(header);
+	auto scope = new BuiltinScope;
+	auto sptr = BuiltinScopePtr(scope);
+	vector<uint32_t> offsets;
+
+	scope->m_pool.assign(data + (size_t)header.count * sizeof(SnapshotEntry), header.poolSize);
+
+	for (uint32_t i = 0; i < header.count; i++)
+	{
+		SnapshotEntry snap;
+		memcpy(&snap, data + i * sizeof(SnapshotEntry), sizeof(snap));
+
+		if ((uint64_t)snap.name + snap.nameLength > header.poolSize ||
+			(uint64_t)snap.contents + snap.contentsLength > header.poolSize ||
+			snap.type > Decl::Argument ||
+			snap.constant > ConstValue::String + 1)
+		{
+			return NULL;
+		}
+
+		BuiltinEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		entry.nameLength = snap.nameLength;
+		entry.type = (Decl::Type)snap.type;
+		memcpy(entry.range, snap.range, sizeof(entry.range));
+		entry.arity = snap.arity;
+		entry.varargs = snap.varargs != 0;
+		entry.constant = snap.constant;
+		entry.number = snap.number;
+		entry.contentsLength = snap.contentsLength;
+
+		offsets.push_back(snap.name);
+		offsets.push_back(snap.contents);
+		scope->m_entries.push_back(entry);
+	}
+
+	scope->Freeze(offsets);
+	return sptr;
+}
+
+bool BuiltinScope::Save(const string &filename, uint64_t sourceHash) const
+{
+	string pool;
+	vector<SnapshotEntry> entries;
+
+	for (uint32_t i = 0; i < m_table.count; i++)
+	{
+		auto &entry = m_table.entries[i];
+
+		SnapshotEntry snap;
+		memset(&snap, 0, sizeof(snap));
+		snap.name = pool.size();
+		snap.nameLength = entry.nameLength;
+		pool.append(entry.name, entry.nameLength);
+		snap.contents = pool.size();
+		snap.contentsLength = entry.contentsLength;
+		pool.append(entry.contents, entry.contentsLength);
+		snap.arity = entry.arity;
+		memcpy(snap.range, entry.range, sizeof(snap.range));
+		snap.type = entry.type;
+		snap.constant = entry.constant;
+		snap.varargs = entry.varargs;
+		snap.number = entry.number;
+
+		entries.push_back(snap);
+	}
+
+	SnapshotHeader header;
+	memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+	header.version = SnapshotVersion;
+	header.sourceHash = sourceHash;
+	header.count = entries.size();
+	header.poolSize = pool.size();
+
+	string contents;
+	contents.append((const char *)&header, sizeof(header));
+	contents.append((const char *)entries.data(), entries.size() * sizeof(SnapshotEntry));
+	contents.append(pool);
+
+	// Other processes may have the old snapshot mapped, so it's replaced
+	// rather than written over.
+	return WriteFileAtomic(filename, contents);
+}
+
+BuiltinScopePtr BuiltinScope::Parse(const string &filename, const string &snapshotFile)
+{
+	FileSource source(filename);
+	auto sourceHash = HashString(source.Contents());
+	BuiltinScopePtr scope;
+
+	if (snapshotFile != "")
+	{
+		scope = Load(snapshotFile, sourceHash);
+	}
+
+	if (!scope)
+	{
+		DiagBuilder diag;
+		Lexer lexer(diag, source);
+		Sema sema(diag, NULL);
+		Parser parser(diag, source, lexer, sema);
+
+		parser.ParseFile();
+		scope.reset(new BuiltinScope(*sema.RootScope()));
+
+		// A stale or missing snapshot is simply rebuilt for the next run, one
+		// that can't be written just means parsing again next time.
+		if (snapshotFile != "")
+		{
+			scope->Save(snapshotFile, sourceHash);
+		}
+	}
+
+	return scope;
+}
+
+const Decl *BuiltinScope::Find(const string &name) const
+{
+	if (m_table.count == 0)
+	{
+		return NULL;
+	}
+
+	auto bucket = HashName(name.data(), name.size(), 0) % m_table.bucketCount;
+	auto slot = m_table.slots[HashName(name.data(), name.size(), m_table.seeds[bucket]) & m_table.slotMask];
+
+	if (slot < 0)
+	{
+		return NULL;
+	}
+
+	auto &entry = m_table.entries[slot];
+	if (entry.nameLength != name.size() || memcmp(entry.name, name.data(), name.size()) != 0)
+	{
+		return NULL;
+	}
+
+	return &m_decls[slot];
+}
+
+uint64_t BuiltinScope::Hash() const
+{
+	uint64_t hash = m_table.count;
+
+	for (uint32_t i = 0; i < m_table.count; i++)
+	{
+		auto &entry = m_table.entries[i];
+		int64_t fields[] =
+		{
+			entry.type, entry.range[0], entry.range[1], entry.range[2], entry.range[3],
+			entry.arity, entry.varargs, entry.constant
+		};
+
+		hash = HashBytes(entry.name, entry.nameLength, hash);
+		hash = HashBytes(entry.contents, entry.contentsLength, hash);
+		hash = HashBytes(fields, sizeof(fields), hash);
+		hash = HashBytes(&entry.number, sizeof(entry.number), hash);
+	}
+
+	return hash;
+}
+
+const BuiltinTable &BuiltinScope::Table() const
+{
+	return m_table;
+}
+
+const Decl &BuiltinScope::GetDecl(uint32_t index) const
+{
+	return m_decls[index];
+}
+
+void BuiltinScope::Freeze(const vector<uint32_t> &offsets)
+{
+	// The pool is complete by now, so pointers into it stay put.
+	for (uint32_t i = 0; i < m_entries.size(); i++)
+	{
+		m_entries[i].name = m_pool.data() + offsets[i * 2];
+		m_entries[i].contents = m_pool.data() + offsets[i * 2 + 1];
+		m_decls.push_back(MakeDecl(m_entries[i], i));
+	}
+
+	BuildPerfectHash(m_entries, m_seeds, m_slots);
+
+	m_table.count = m_entries.size();
+	m_table.bucketCount = m_seeds.size();
+	m_table.slotMask = m_slots.size() - 1;
+	m_table.entries = m_entries.data();
+	m_table.seeds = m_seeds.data();
+	m_table.slots = m_slots.data();
+}
@@ -0,0 +1,82 @@
+#ifndef MOND_BUILTIN_SCOPE_HPP
+#define MOND_BUILTIN_SCOPE_HPP
+
+#include "Sema.hpp"
+
+namespace Mond
+{
+	// Plain data so that tables generated at build time can be constexpr.
+	struct BuiltinEntry
+	{
+		const char *name;
+		uint32_t nameLength;
+		Decl::Type type;
+		int32_t range[4];
+		int32_t arity;
+		bool varargs;
+		int32_t constant;
+		double number;
+		const char *contents;
+		uint32_t contentsLength;
+	};
+
+	// Lookup goes through a perfect hash: the bucket of a name picks the seed
+	// that hashes it straight to the slot holding its entry.
+	struct BuiltinTable
+	{
+		uint32_t count;
+		uint32_t bucketCount;
+		uint32_t slotMask;
+		const BuiltinEntry *entries;
+		const uint32_t *seeds;
+		const int32_t *slots;
+	};
+
+	// Defined by the source mondx-genbuiltin generates at build time.
+	extern const BuiltinTable CompiledBuiltinTable;
+
+	// A frozen copy of the declarations in a builtin file. Nothing in it
+	// changes after construction, so one instance can be shared by any number
+	// of Sema instances on any number of threads.
+	class BuiltinScope
+	{
+	public:
+		explicit BuiltinScope(const Scope &scope);
+		explicit BuiltinScope(const BuiltinTable &table);
+
+		// Snapshots are tagged with a hash of the builtin source they were
+		// made from, loading returns NULL if the snapshot is missing, corrupt
+		// or was made from a different source. Saving returns false if the
+		// snapshot couldn't be written.
+		static BuiltinScopePtr Load(const string &filename, uint64_t sourceHash);
+		bool Save(const string &filename, uint64_t sourceHash) const;
+
+		// Checks a builtin file. Given a snapshot file, the snapshot is used
+		// if it matches the source and rebuilt from it otherwise.
+		static BuiltinScopePtr Parse(const string &filename, const string &snapshotFile = "");
+
+		const Decl *Find(const string &name) const;
+
+		// Changes whenever a declaration does, for keying anything that was
+		// computed against these builtins.
+		uint64_t Hash() const;
+
+		const BuiltinTable &Table() const;
+		const Decl &GetDecl(uint32_t index) const;
+	private:
+		BuiltinScope();
+		BuiltinScope(const BuiltinScope &);
+		BuiltinScope &operator=(const BuiltinScope &);
+
+		void Freeze(const vector<uint32_t> &offsets);
+
+		string m_pool;
+		vector<Decl> m_decls;
+		vector<BuiltinEntry> m_entries;
+		vector<uint32_t> m_seeds;
+		vector<int32_t> m_slots;
+		BuiltinTable m_table;
+	};
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef MOND_CANCEL_TOKEN_HPP
+#define MOND_CANCEL_TOKEN_HPP
+
+#include <atomic>
+#include <exception>
+#include "Util.hpp"
+
+namespace Mond
+{
+	// Thrown out of the lexer, parser or sema once their token is cancelled.
+	// Whatever they built by then is half done and should be thrown away.
+	class Cancelled : public std::exception
+	{
+	public:
+		const char *what() const throw();
+	};
+
+	// Copies share one flag, so whoever started the work can keep a copy and
+	// cancel it from another thread. The work only notices at statement
+	// boundaries, checking is a load and a branch.
+	class CancelToken
+	{
+	public:
+		// A token that's never cancelled.
+		CancelToken();
+
+		static CancelToken Create();
+
+		void Cancel();
+		bool IsCancelled() const;
+
+		// Throws Cancelled if the token has been cancelled.
+		void Check() const;
+	private:
+		shared_ptr<std::atomic<bool>> m_flag;
+	};
+
+	// -----------------------------------------------------------------------
+	// Cancelled implementation
+	// -----------------------------------------------------------------------
+
+	inline const char *Cancelled::what() const throw()
+	{
+		return "cancelled";
+	}
+
+	// -----------------------------------------------------------------------
+	// CancelToken implementation
+	// -----------------------------------------------------------------------
+
+	inline CancelToken::CancelToken()
+	{
+	}
+
+	inline CancelToken CancelToken::Create()
+	{
+		CancelToken token;
+		token.m_flag = std::make_shared<std::atomic<bool>>(false);
+		return token;
+	}
+
+	inline void CancelToken::Cancel()
+	{
+		if (m_flag)
+		{
+			m_flag->store(true, std::memory_order_relaxed);
+		}
+	}
+
+	inline bool CancelToken::IsCancelled() const
+	{
+		return m_flag && m_flag->load(std::memory_order_relaxed);
+	}
+
+	inline void CancelToken::Check() const
+	{
+		if (IsCancelled())
+		{
+			throw Cancelled();
+		}
+	}
+}
+
+#endif
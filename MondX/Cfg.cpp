@@ -0,0 +1,498 @@
+#include "Cfg.hpp"
+#include "OperatorUtil.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Graph interface
+// ---------------------------------------------------------------------------
+
+void Mond::CollectFrames(Scope *scope, vector<Scope *> &frames)
+{
+	if (scope->frame == scope)
+	{
+		frames.push_back(scope);
+	}
+
+	for (auto &child : scope->children)
+	{
+		CollectFrames(child.get(), frames);
+	}
+}
+
+Stmt *Mond::GetFrameBody(Scope *frame)
+{
+	if (auto lambda = dynamic_cast<ExprLambda *>(frame->node.get()))
+	{
+		return lambda->body.get();
+	}
+
+	if (auto fun = dynamic_cast<StmtFunDecl *>(frame->node.get()))
+	{
+		return fun->body.get();
+	}
+
+	return NULL;
+}
+
+void Mond::BuildCfgs(Stmt *file, Scope *root, vector<Cfg> &cfgs)
+{
+	vector<Scope *> frames;
+	CollectFrames(root, frames);
+
+	cfgs.resize(frames.size());
+
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		auto body = frames[i] == root ? file : GetFrameBody(frames[i]);
+		CfgBuilder(cfgs[i]).Build(frames[i], body);
+	}
+}
+
+vector<bool> Mond::FindReachable(const Cfg &cfg)
+{
+	vector<bool> reachable(cfg.blocks.size(), false);
+	vector<int> stack(1, Cfg::Entry);
+	reachable[Cfg::Entry] = true;
+
+	while (!stack.empty())
+	{
+		auto block = stack.back();
+		stack.pop_back();
+
+		for (auto succ : cfg.blocks[block].succs)
+		{
+			if (!reachable[succ])
+			{
+				reachable[succ] = true;
+				stack.push_back(succ);
+			}
+		}
+	}
+
+	return reachable;
+}
+
+// ---------------------------------------------------------------------------
+// Builder interface
+// ---------------------------------------------------------------------------
+
+CfgBuilder::CfgBuilder(Cfg &cfg) : m_cfg(cfg), m_curr(Cfg::Entry)
+{
+}
+
+void CfgBuilder::Build(Scope *frame, Stmt *body)
+{
+	m_cfg.frame = frame;
+	m_cfg.body = body;
+	m_cfg.blocks.clear();
+	m_loops.clear();
+
+	NewBlock();
+	NewBlock();
+	m_curr = Cfg::Entry;
+
+	// Arguments are assigned by the caller before the body runs.
+	if (frame->type == Scope::Function || frame->type == Scope::Sequence)
+	{
+		for (auto &entry : frame->decls)
+		{
+			if (entry.second.type == Decl::Argument)
+			{
+				Emit(CfgEvent::Write, &entry.second, entry.second.node.get());
+			}
+		}
+	}
+
+	AcceptChild(this, body);
+	m_cfg.end = m_curr;
+	Edge(m_curr, Cfg::Exit);
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+// ---------------------------------------------------------------------------
+
+void CfgBuilder::Visit(ExprBinaryOp *expr)
+{
+	if (expr->type == OpConditionalAnd || expr->type == OpConditionalOr)
+	{
+		AcceptChild(this, expr->left.get());
+
+		auto right = NewBlock();
+		auto join = NewBlock();
+		Edge(m_curr, right);
+		Edge(m_curr, join);
+
+		m_curr = right;
+		AcceptChild(this, expr->right.get());
+		Edge(m_curr, join);
+
+		m_curr = join;
+		return;
+	}
+
+	auto id = dynamic_cast<ExprId *>(expr->left.get());
+	if (!IsMutatingOperator(expr->type) || !id)
+	{
+		AcceptChild(this, expr->left.get());
+		AcceptChild(this, expr->right.get());
+		return;
+	}
+
+	// Compound assignments read the old value before the right side runs.
+	if (expr->type != OpAssign)
+	{
+		Emit(CfgEvent::Read, id->decl, id);
+	}
+
+	AcceptChild(this, expr->right.get());
+	Emit(CfgEvent::Write, id->decl, id);
+}
+
+void CfgBuilder::Visit(ExprId *expr)
+{
+	Emit(CfgEvent::Read, expr->decl, expr);
+}
+
+void CfgBuilder::Visit(ExprLambda *)
+{
+	// The body belongs to another frame and runs whenever it's called.
+}
+
+void CfgBuilder::Visit(ExprTernaryOp *expr)
+{
+	AcceptChild(this, expr->cond.get());
+
+	auto thenBlock = NewBlock();
+	auto elseBlock = NewBlock();
+	auto join = NewBlock();
+	Edge(m_curr, thenBlock);
+	Edge(m_curr, elseBlock);
+
+	m_curr = thenBlock;
+	AcceptChild(this, expr->thenExpr.get());
+	Edge(m_curr, join);
+
+	m_curr = elseBlock;
+	AcceptChild(this, expr->elseExpr.get());
+	Edge(m_curr, join);
+
+	m_curr = join;
+}
+
+void CfgBuilder::Visit(ExprUnaryOp *expr)
+{
+	auto id = dynamic_cast<ExprId *>(expr->value.get());
+	if (!IsMutatingOperator(expr->type) || !id)
+	{
+		AcceptChild(this, expr->value.get());
+		return;
+	}
+
+	Emit(CfgEvent::Read, id->decl, id);
+	Emit(CfgEvent::Write, id->decl, id);
+}
+
+// ---------------------------------------------------------------------------
+// Statements
+// ---------------------------------------------------------------------------
+
+void CfgBuilder::Visit(StmtBlock *stmt)
+{
+	for (auto &child : stmt->statements)
+	{
+		AcceptChild(this, child.get());
+	}
+}
+
+void CfgBuilder::Visit(StmtControl *stmt)
+{
+	EmitStatement(stmt);
+
+	// Sema has already reported control statements outside of loops.
+	if (!m_loops.empty())
+	{
+		auto &loop = m_loops.back();
+		Edge(m_curr, stmt->type == KwBreak ? loop.breakTarget : loop.continueTarget);
+	}
+
+	Unreachable();
+}
+
+void CfgBuilder::Visit(StmtDoWhile *stmt)
+{
+	EmitStatement(stmt);
+
+	auto body = NewBlock();
+	auto cond = NewBlock();
+	auto exit = NewBlock();
+	Edge(m_curr, body);
+
+	Loop loop = { exit, cond };
+	m_loops.push_back(loop);
+	m_curr = body;
+	AcceptChild(this, stmt->body.get());
+	Edge(m_curr, cond);
+	m_loops.pop_back();
+
+	m_curr = cond;
+	AcceptChild(this, stmt->cond.get());
+	Edge(m_curr, body);
+
+	if (!IsAlwaysTrue(stmt->cond.get()))
+	{
+		Edge(m_curr, exit);
+	}
+
+	m_curr = exit;
+}
+
+void CfgBuilder::Visit(StmtFor *stmt)
+{
+	EmitStatement(stmt);
+	AcceptChild(this, stmt->init.get());
+
+	auto head = NewBlock();
+	auto body = NewBlock();
+	auto step = NewBlock();
+	auto exit = NewBlock();
+	Edge(m_curr, head);
+
+	m_curr = head;
+	AcceptChild(this, stmt->cond.get());
+	Edge(m_curr, body);
+
+	if (stmt->cond && !IsAlwaysTrue(stmt->cond.get()))
+	{
+		Edge(m_curr, exit);
+	}
+
+	Loop loop = { exit, step };
+	m_loops.push_back(loop);
+	m_curr = body;
+	AcceptChild(this, stmt->body.get());
+	Edge(m_curr, step);
+	m_loops.pop_back();
+
+	m_curr = step;
+	for (auto &expr : stmt->steps)
+	{
+		AcceptChild(this, expr.get());
+	}
+
+	Edge(m_curr, head);
+	m_curr = exit;
+}
+
+void CfgBuilder::Visit(StmtForeach *stmt)
+{
+	EmitStatement(stmt);
+	AcceptChild(this, stmt->from.get());
+
+	auto head = NewBlock();
+	auto body = NewBlock();
+	auto exit = NewBlock();
+	Edge(m_curr, head);
+	Edge(head, body);
+	Edge(head, exit);
+
+	Loop loop = { exit, head };
+	m_loops.push_back(loop);
+	m_curr = body;
+	Emit(CfgEvent::Write, stmt->decl, stmt);
+	AcceptChild(this, stmt->body.get());
+	Edge(m_curr, head);
+	m_loops.pop_back();
+
+	m_curr = exit;
+}
+
+void CfgBuilder::Visit(StmtFunDecl *stmt)
+{
+	EmitStatement(stmt);
+	Emit(CfgEvent::Write, stmt->decl, stmt);
+}
+
+void CfgBuilder::Visit(StmtIfElse *stmt)
+{
+	EmitStatement(stmt);
+	AcceptChild(this, stmt->cond.get());
+
+	auto thenBlock = NewBlock();
+	auto join = NewBlock();
+	auto elseBlock = stmt->elseBody ? NewBlock() : join;
+	Edge(m_curr, thenBlock);
+	Edge(m_curr, elseBlock);
+
+	m_curr = thenBlock;
+	AcceptChild(this, stmt->thenBody.get());
+	Edge(m_curr, join);
+
+	if (stmt->elseBody)
+	{
+		m_curr = elseBlock;
+		AcceptChild(this, stmt->elseBody.get());
+		Edge(m_curr, join);
+	}
+
+	m_curr = join;
+}
+
+void CfgBuilder::Visit(StmtNakedExpr *stmt)
+{
+	EmitStatement(stmt);
+	AcceptChild(this, stmt->value.get());
+}
+
+void CfgBuilder::Visit(StmtReturn *stmt)
+{
+	EmitStatement(stmt);
+	AcceptChild(this, stmt->value.get());
+	Edge(m_curr, Cfg::Exit);
+	Unreachable();
+}
+
+void CfgBuilder::Visit(StmtSwitch *stmt)
+{
+	EmitStatement(stmt);
+	AcceptChild(this, stmt->value.get());
+
+	auto exit = NewBlock();
+	auto fallback = exit;
+	vector<int> bodies;
+
+	for (size_t i = 0; i < stmt->cases.size(); i++)
+	{
+		bodies.push_back(NewBlock());
+	}
+
+	// Case values are tested in order until one matches, the default case is
+	// taken when none of them do.
+	for (size_t i = 0; i < stmt->cases.size(); i++)
+	{
+		auto &c = stmt->cases[i];
+
+		if (c.def)
+		{
+			fallback = bodies[i];
+			continue;
+		}
+
+		AcceptChild(this, c.value.get());
+		Edge(m_curr, bodies[i]);
+
+		auto next = NewBlock();
+		Edge(m_curr, next);
+		m_curr = next;
+	}
+
+	Edge(m_curr, fallback);
+
+	// An empty case shares the body of the one after it.
+	for (size_t i = 0; i < stmt->cases.size(); i++)
+	{
+		auto &c = stmt->cases[i];
+		m_curr = bodies[i];
+
+		for (auto &child : c.body)
+		{
+			AcceptChild(this, child.get());
+		}
+
+		Edge(m_curr, c.body.empty() && i + 1 < bodies.size() ? bodies[i + 1] : exit);
+	}
+
+	m_curr = exit;
+}
+
+void CfgBuilder::Visit(StmtVarDecl *stmt)
+{
+	EmitStatement(stmt);
+
+	for (size_t i = 0; i < stmt->values.size(); i++)
+	{
+		Emit(CfgEvent::Declare, stmt->decls[i], stmt);
+
+		if (stmt->values[i])
+		{
+			AcceptChild(this, stmt->values[i].get());
+			Emit(CfgEvent::Write, stmt->decls[i], stmt);
+		}
+	}
+}
+
+void CfgBuilder::Visit(StmtWhile *stmt)
+{
+	EmitStatement(stmt);
+
+	auto head = NewBlock();
+	auto body = NewBlock();
+	auto exit = NewBlock();
+	Edge(m_curr, head);
+
+	m_curr = head;
+	AcceptChild(this, stmt->cond.get());
+	Edge(m_curr, body);
+
+	if (!IsAlwaysTrue(stmt->cond.get()))
+	{
+		Edge(m_curr, exit);
+	}
+
+	Loop loop = { exit, head };
+	m_loops.push_back(loop);
+	m_curr = body;
+	AcceptChild(this, stmt->body.get());
+	Edge(m_curr, head);
+	m_loops.pop_back();
+
+	m_curr = exit;
+}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+int CfgBuilder::NewBlock()
+{
+	m_cfg.blocks.push_back(CfgBlock());
+	return m_cfg.blocks.size() - 1;
+}
+
+void CfgBuilder::Edge(int from, int to)
+{
+	m_cfg.blocks[from].succs.push_back(to);
+	m_cfg.blocks[to].preds.push_back(from);
+}
+
+void CfgBuilder::Emit(CfgEvent::Kind kind, const Decl *decl, AstNode *node)
+{
+	if (!decl || !decl->scope || decl->scope->frame != m_cfg.frame)
+	{
+		return;
+	}
+
+	CfgEvent event = { kind, decl->slot, decl, node };
+	m_cfg.blocks[m_curr].events.push_back(event);
+}
+
+void CfgBuilder::EmitStatement(Stmt *stmt)
+{
+	CfgEvent event = { CfgEvent::Statement, -1, NULL, stmt };
+	m_cfg.blocks[m_curr].events.push_back(event);
+}
+
+// Whatever follows a jump starts a block nothing flows into.
+void CfgBuilder::Unreachable()
+{
+	m_curr = NewBlock();
+}
+
+// Only constant true conditions matter, they make the loop exit through
+// break or return alone.
+bool CfgBuilder::IsAlwaysTrue(Expr *cond)
+{
+	auto value = m_folder.Fold(cond);
+	return value && value->type == ConstValue::True;
+}
@@ -0,0 +1,110 @@
+#ifndef MOND_CFG_HPP
+#define MOND_CFG_HPP
+
+#include "Sema.hpp"
+
+namespace Mond
+{
+	// Something a basic block does, in evaluation order. Declarations, reads
+	// and writes are only recorded for locals of the frame the graph belongs
+	// to, slot is the declaration's frame slot. A var or const declaration
+	// comes before the write of its initial value.
+	struct CfgEvent
+	{
+		enum Kind
+		{
+			Statement,
+			Declare,
+			Read,
+			Write
+		};
+
+		Kind kind;
+		int slot;
+		const Decl *decl;
+		AstNode *node;
+	};
+
+	struct CfgBlock
+	{
+		vector<CfgEvent> events;
+		vector<int> succs;
+		vector<int> preds;
+	};
+
+	// One graph per frame: the file and every function, sequence and lambda
+	// body. Nested functions only show up as the write declaring them.
+	struct Cfg
+	{
+		enum
+		{
+			Entry = 0,
+			Exit = 1
+		};
+
+		Scope *frame;
+		AstNode *body;
+		vector<CfgBlock> blocks;
+		// The block that falls off the end of the body into Exit.
+		int end;
+	};
+
+	// The body of a function frame, or NULL for the root frame whose body is
+	// the file itself.
+	Stmt *GetFrameBody(Scope *frame);
+
+	// Every frame starting at scope, in preorder.
+	void CollectFrames(Scope *scope, vector<Scope *> &frames);
+
+	// Builds graphs for the root frame and every frame nested in it.
+	void BuildCfgs(Stmt *file, Scope *root, vector<Cfg> &cfgs);
+
+	vector<bool> FindReachable(const Cfg &cfg);
+
+	class CfgBuilder : public Visitor
+	{
+	public:
+		explicit CfgBuilder(Cfg &cfg);
+
+		void Build(Scope *frame, Stmt *body);
+
+		virtual void Visit(ExprBinaryOp *);
+		virtual void Visit(ExprId *);
+		virtual void Visit(ExprLambda *);
+		virtual void Visit(ExprTernaryOp *);
+		virtual void Visit(ExprUnaryOp *);
+
+		virtual void Visit(StmtBlock *);
+		virtual void Visit(StmtControl *);
+		virtual void Visit(StmtDoWhile *);
+		virtual void Visit(StmtFor *);
+		virtual void Visit(StmtForeach *);
+		virtual void Visit(StmtFunDecl *);
+		virtual void Visit(StmtIfElse *);
+		virtual void Visit(StmtNakedExpr *);
+		virtual void Visit(StmtReturn *);
+		virtual void Visit(StmtSwitch *);
+		virtual void Visit(StmtVarDecl *);
+		virtual void Visit(StmtWhile *);
+	private:
+		struct Loop
+		{
+			int breakTarget;
+			int continueTarget;
+		};
+
+		int NewBlock();
+		void Edge(int from, int to);
+		void Emit(CfgEvent::Kind kind, const Decl *decl, AstNode *node);
+		void EmitStatement(Stmt *stmt);
+		void Unreachable();
+		bool IsAlwaysTrue(Expr *cond);
+
+		Cfg &m_cfg;
+		int m_curr;
+		vector<Loop> m_loops;
+		ConstFolder m_folder;
+	};
+}
+
+#endif
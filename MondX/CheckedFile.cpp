@@ -0,0 +1,666 @@
+#include <cstring>
+#include <algorithm>
+#include "Parser.hpp"
+#include "FlowChecker.hpp"
+#include "CheckedFile.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static void shift(Pos &pos, SourceInt lines)
+{
+	if (pos.IsValid())
+	{
+		pos.line += lines;
+	}
+}
+
+static void shift(Range &range, SourceInt lines)
+{
+	shift(range.beg, lines);
+	shift(range.end, lines);
+}
+
+static void shift(vector<Diag> &diags, SourceInt lines)
+{
+	for (auto &diag : diags)
+	{
+		shift(diag.caret, lines);
+		shift(diag.range, lines);
+	}
+}
+
+static void shift(Scope *scope, SourceInt lines)
+{
+	for (auto &entry : scope->decls)
+	{
+		shift(entry.second.range, lines);
+	}
+
+	for (auto &child : scope->children)
+	{
+		shift(child.get(), lines);
+	}
+}
+
+// Moves every position in a statement's tree down a number of lines.
+class LineShifter : public Visitor
+{
+public:
+	using Visitor::Visit;
+
+	explicit LineShifter(SourceInt lines) : m_lines(lines)
+	{
+	}
+
+	void Visit(AstNode *node)
+	{
+		shift(node->pos, m_lines);
+		shift(node->range, m_lines);
+	}
+
+	void Visit(ExprLambda *expr)
+	{
+		ShiftNames(expr->arguments);
+		Visitor::Visit(expr);
+	}
+
+	void Visit(StmtForeach *stmt)
+	{
+		shift(stmt->name.range, m_lines);
+		Visitor::Visit(stmt);
+	}
+
+	void Visit(StmtFunDecl *stmt)
+	{
+		shift(stmt->name.range, m_lines);
+		ShiftNames(stmt->arguments);
+		Visitor::Visit(stmt);
+	}
+
+	void Visit(StmtSwitch *stmt)
+	{
+		for (auto &switchCase : stmt->cases)
+		{
+			shift(switchCase.headRange, m_lines);
+		}
+
+		Visitor::Visit(stmt);
+	}
+
+	void Visit(StmtVarDecl *stmt)
+	{
+		ShiftNames(stmt->names);
+		Visitor::Visit(stmt);
+	}
+private:
+	void ShiftNames(DeclNameList &names)
+	{
+		for (auto &name : names)
+		{
+			shift(name.range, m_lines);
+		}
+	}
+
+	SourceInt m_lines;
+};
+
+// Line breaks that can differ between two texts sharing everything before
+// beg and after end, a carriage return right before beg can stop ending a
+// line if what follows it changed.
+static SourceInt countLineBreaks(const string &text, SourceInt beg, SourceInt end)
+{
+	SourceInt count = 0;
+
+	for (auto i = std::max<SourceInt>(beg, 1) - 1; i < end; i++)
+	{
+		count += IsLineBreak(text, i);
+	}
+
+	return count;
+}
+
+static Pos getPos(const Diag &diag)
+{
+	return diag.range.IsValid() ? diag.range.beg : diag.caret;
+}
+
+// Messages quoting a position, which moving the statement doesn't update.
+static bool quotesPosition(const Diag &diag)
+{
+	switch (diag.messageId)
+	{
+	case SemaAlreadyDeclaredAt:
+	case SemaDuplicateCaseValue:
+	case SemaDuplicateDefaultCase:
+	case SemaMutatingConstant:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static vector<const DeclName *> getRootNames(Stmt *stmt)
+{
+	vector<const DeclName *> names;
+
+	if (auto var = dynamic_cast<StmtVarDecl *>(stmt))
+	{
+		for (auto &name : var->names)
+		{
+			names.push_back(&name);
+		}
+	}
+	else if (auto fun = dynamic_cast<StmtFunDecl *>(stmt))
+	{
+		names.push_back(&fun->name);
+	}
+
+	return names;
+}
+
+static void collectCaptures(Scope *scope, Scope *root, vector<Decl *> &captures)
+{
+	for (auto &capture : scope->captures)
+	{
+		if (capture.decl->scope == root)
+		{
+			captures.push_back(capture.decl);
+		}
+	}
+
+	for (auto &child : scope->children)
+	{
+		collectCaptures(child.get(), root, captures);
+	}
+}
+
+static bool sameValue(const ConstValuePtr &a, const ConstValuePtr &b)
+{
+	if (!a || !b)
+	{
+		return !a && !b;
+	}
+
+	return a->type == b->type && memcmp(&a->number, &b->number, sizeof(double)) == 0 && a->contents == b->contents;
+}
+
+// ---------------------------------------------------------------------------
+// CheckedFile
+// ---------------------------------------------------------------------------
+
+CheckedFile::CheckedFile(const string &text, BuiltinScopePtr builtinScope, const CancelToken &token) :
+	m_text(text),
+	m_builtin(builtinScope),
+	m_file(new StmtBlock())
+{
+	Token end;
+	m_statements = Parse(m_text, 0, Pos(1, 1), token, nullptr, m_leading, end);
+	m_file->pos = m_statements.empty() ? end.range.beg : m_statements.front().pos;
+	m_file->range = Range(m_file->pos, end.range.beg);
+
+	vector<Diag> diags;
+	DiagCollector collector(diags);
+	DiagBuilder diag(collector);
+
+	Sema sema(diag, m_builtin);
+	sema.SetCancelToken(token);
+	m_root = sema.RootScope();
+
+	for (auto &statement : m_statements)
+	{
+		m_file->statements.push_back(statement.stmt);
+		CheckStatement(sema, diags, statement);
+	}
+
+	token.Check();
+
+	for (auto &statement : m_statements)
+	{
+		for (auto decl : statement.captures)
+		{
+			m_captured[decl]++;
+		}
+
+		CheckFlow(statement);
+	}
+
+	CheckRoot();
+	m_index = NodeIndex(m_file, m_root.get());
+}
+
+// The edit is what's left between the prefix and suffix the texts share.
+// Parsing starts again a statement before the first one it reaches, the
+// parser may have looked into that one to see where the one before ends,
+// and goes on until a statement starts where an old one did on a line past
+// the edit. Everything from there on is as it was, lineDelta lines away.
+bool CheckedFile::Update(const string &text)
+{
+	auto oldSize = (SourceInt)m_text.size();
+	auto newSize = (SourceInt)text.size();
+	SourceInt beg = 0;
+
+	while (beg < oldSize && beg < newSize && m_text[beg] == text[beg])
+	{
+		beg++;
+	}
+
+	if (beg == oldSize && beg == newSize)
+	{
+		return true;
+	}
+
+	auto oldEnd = oldSize;
+	auto newEnd = newSize;
+
+	while (oldEnd > beg && newEnd > beg && m_text[oldEnd - 1] == text[newEnd - 1])
+	{
+		oldEnd--;
+		newEnd--;
+	}
+
+	auto byteDelta = newEnd - oldEnd;
+	auto lineDelta = countLineBreaks(text, beg, newEnd) - countLineBreaks(m_text, beg, oldEnd);
+
+	auto touched = std::lower_bound(m_statements.begin(), m_statements.end(), beg, [](const Statement &s, SourceInt offset)
+	{
+		return s.offset < offset;
+	}) - m_statements.begin();
+
+	size_t first = std::max<ptrdiff_t>(touched - 2, 0);
+
+	// A statement ending in an error the parser only noticed at the next
+	// token has that error from before the next statement was parsed.
+	auto reaches = [](const Statement &s, Pos pos)
+	{
+		return std::any_of(s.parseDiags.begin(), s.parseDiags.end(), [&](const Diag &diag)
+		{
+			return !(getPos(diag) < pos);
+		});
+	};
+
+	while (first > 0 && reaches(m_statements[first - 1], m_statements[first].pos))
+	{
+		first--;
+	}
+
+	auto resync = oldEnd;
+
+	while (resync < oldSize && !IsLineBreak(m_text, resync))
+	{
+		resync++;
+	}
+
+	resync++;
+
+	auto last = m_statements.size();
+	auto stop = [&](const Token &token)
+	{
+		auto offset = token.slice.beg - byteDelta;
+
+		if (offset < resync)
+		{
+			return false;
+		}
+
+		auto it = std::lower_bound(m_statements.begin() + first, m_statements.end(), offset, [](const Statement &s, SourceInt offset)
+		{
+			return s.offset < offset;
+		});
+
+		if (it == m_statements.end() || it->offset != offset || Pos(it->pos.line + lineDelta, it->pos.column) != token.range.beg)
+		{
+			return false;
+		}
+
+		last = it - m_statements.begin();
+		return true;
+	};
+
+	vector<Diag> leading;
+	Token next;
+	auto offset = first > 0 ? m_statements[first].offset : 0;
+	auto pos = first > 0 ? m_statements[first].pos : Pos(1, 1);
+	auto statements = Parse(text, offset, pos, CancelToken(), stop, leading, next);
+
+	// Nothing has changed yet, these are cheap to give up on. A name
+	// declared twice at the top leaves only the second in the root scope,
+	// and a message quoting a position can't be moved.
+	for (auto i = first; i < last; i++)
+	{
+		if (Redeclares(m_statements[i]))
+		{
+			return false;
+		}
+	}
+
+	for (auto i = last; i < m_statements.size(); i++)
+	{
+		auto &diags = m_statements[i].semaDiags;
+
+		if (std::any_of(diags.begin(), diags.end(), quotesPosition))
+		{
+			return false;
+		}
+	}
+
+	// The rest of the file was checked against these, so the new statements
+	// have to declare them just the same.
+	struct Declared
+	{
+		Decl *decl;
+		Decl::Type type;
+		int arity;
+		bool varargs;
+		ConstValuePtr value;
+	};
+
+	ConstFolder folder;
+	vector<Declared> declared;
+
+	for (auto i = first; i < last; i++)
+	{
+		for (auto decl : m_statements[i].decls)
+		{
+			Declared old = { decl, decl->type, decl->arity, decl->varargs, decl->type == Decl::Constant ? folder.Fold(decl->value.get()) : ConstValuePtr() };
+			declared.push_back(old);
+		}
+	}
+
+	vector<Diag> diags;
+	DiagCollector collector(diags);
+	DiagBuilder diag(collector);
+
+	Sema sema(diag, m_builtin, m_root);
+	auto scopes = m_root->children.size();
+	auto firstSlot = first < m_statements.size() ? m_statements[first].firstSlot : m_root->frameSize;
+	auto endSlot = last < m_statements.size() ? m_statements[last].firstSlot : m_root->frameSize;
+
+	sema.BeginRecheck(firstSlot);
+
+	for (auto &statement : statements)
+	{
+		CheckStatement(sema, diags, statement);
+	}
+
+	if (!sema.EndRecheck(endSlot))
+	{
+		return false;
+	}
+
+	m_root->children.resize(scopes);
+
+	size_t i = 0;
+
+	for (auto &statement : statements)
+	{
+		for (auto decl : statement.decls)
+		{
+			if (i == declared.size())
+			{
+				return false;
+			}
+
+			auto &old = declared[i++];
+			auto value = decl->type == Decl::Constant ? folder.Fold(decl->value.get()) : ConstValuePtr();
+
+			if (old.decl != decl || old.type != decl->type || old.arity != decl->arity || old.varargs != decl->varargs || !sameValue(old.value, value))
+			{
+				return false;
+			}
+		}
+	}
+
+	if (i != declared.size())
+	{
+		return false;
+	}
+
+	// Declaring again cleared the flags of what the new statements declare,
+	// captures anywhere else still count.
+	vector<Decl *> recount;
+
+	for (auto i = first; i < last; i++)
+	{
+		for (auto decl : m_statements[i].captures)
+		{
+			m_captured[decl]--;
+			recount.push_back(decl);
+		}
+	}
+
+	for (auto &statement : statements)
+	{
+		for (auto decl : statement.captures)
+		{
+			m_captured[decl]++;
+			recount.push_back(decl);
+		}
+
+		recount.insert(recount.end(), statement.decls.begin(), statement.decls.end());
+	}
+
+	for (auto decl : recount)
+	{
+		decl->captured = m_captured[decl] > 0;
+	}
+
+	for (auto i = last; i < m_statements.size(); i++)
+	{
+		auto &statement = m_statements[i];
+		statement.offset += byteDelta;
+
+		if (lineDelta != 0)
+		{
+			LineShifter shifter(lineDelta);
+			AcceptChild(&shifter, statement.stmt.get());
+
+			for (auto &scope : statement.scopes)
+			{
+				shift(scope.get(), lineDelta);
+			}
+
+			for (auto decl : statement.decls)
+			{
+				shift(decl->range, lineDelta);
+			}
+
+			shift(statement.pos, lineDelta);
+			shift(statement.parseDiags, lineDelta);
+			shift(statement.semaDiags, lineDelta);
+			shift(statement.flowDiags, lineDelta);
+		}
+	}
+
+	StmtPtrList stmts;
+	ScopePtrList stmtScopes;
+
+	for (auto &statement : statements)
+	{
+		stmts.push_back(statement.stmt);
+		stmtScopes.insert(stmtScopes.end(), statement.scopes.begin(), statement.scopes.end());
+	}
+
+	m_file->statements.erase(m_file->statements.begin() + first, m_file->statements.begin() + last);
+	m_file->statements.insert(m_file->statements.begin() + first, stmts.begin(), stmts.end());
+
+	m_statements.erase(m_statements.begin() + first, m_statements.begin() + last);
+	m_statements.insert(m_statements.begin() + first, std::make_move_iterator(statements.begin()), std::make_move_iterator(statements.end()));
+
+	m_root->children.clear();
+
+	for (auto &statement : m_statements)
+	{
+		m_root->children.insert(m_root->children.end(), statement.scopes.begin(), statement.scopes.end());
+	}
+
+	for (auto i = first; i < first + stmts.size(); i++)
+	{
+		CheckFlow(m_statements[i]);
+	}
+
+	CheckRoot();
+	m_index.Replace(first, last - first, stmts, stmtScopes, lineDelta);
+
+	if (first == 0)
+	{
+		m_leading = leading;
+		m_file->pos = m_statements.empty() ? next.range.beg : m_statements.front().pos;
+		m_file->range.beg = m_file->pos;
+	}
+
+	if (next.type == TokEndOfFile)
+	{
+		m_file->range.end = next.range.beg;
+	}
+	else
+	{
+		shift(m_file->range.end, lineDelta);
+	}
+
+	m_text = text;
+	return true;
+}
+
+const string &CheckedFile::GetText() const
+{
+	return m_text;
+}
+
+ScopePtr CheckedFile::RootScope() const
+{
+	return m_root;
+}
+
+const NodeIndex &CheckedFile::GetIndex() const
+{
+	return m_index;
+}
+
+// Parse errors come first, then what Sema reports statement by statement,
+// then the flow warnings of the whole file sorted together. Each statement's
+// are in order already, so sorting all of them the way FlowChecker sorts its
+// own keeps ties in the same order.
+vector<Diag> CheckedFile::GetDiags() const
+{
+	vector<Diag> diags(m_leading);
+	vector<Diag> flow(m_rootFlow);
+
+	for (auto &statement : m_statements)
+	{
+		diags.insert(diags.end(), statement.parseDiags.begin(), statement.parseDiags.end());
+	}
+
+	for (auto &statement : m_statements)
+	{
+		diags.insert(diags.end(), statement.semaDiags.begin(), statement.semaDiags.end());
+		flow.insert(flow.end(), statement.flowDiags.begin(), statement.flowDiags.end());
+	}
+
+	std::stable_sort(flow.begin(), flow.end(), [](const Diag &a, const Diag &b)
+	{
+		return a.range.beg < b.range.beg;
+	});
+
+	diags.insert(diags.end(), flow.begin(), flow.end());
+	return diags;
+}
+
+auto CheckedFile::Parse(const string &text, SourceInt offset, Pos pos, const CancelToken &token, const function<bool (const Token &)> &stop, vector<Diag> &leading, Token &next) const -> vector<Statement>
+{
+	vector<Diag> diags;
+	DiagCollector collector(diags);
+	DiagBuilder diag(collector);
+
+	StringSource source(text.c_str());
+	Lexer lexer(diag, source);
+	lexer.SetCancelToken(token);
+	lexer.SetPosition(offset, pos);
+
+	Parser parser(diag, source, lexer);
+	parser.SetCancelToken(token);
+	leading = diags;
+
+	vector<Statement> statements;
+
+	while (parser.CurrentToken().type != TokEndOfFile && !(stop && stop(parser.CurrentToken())))
+	{
+		auto count = diags.size();
+
+		Statement statement;
+		statement.offset = parser.CurrentToken().slice.beg;
+		statement.pos = parser.CurrentToken().range.beg;
+		statement.stmt = parser.ParseStmt();
+		statement.parseDiags.assign(diags.begin() + count, diags.end());
+		statements.push_back(std::move(statement));
+	}
+
+	next = parser.CurrentToken();
+	return statements;
+}
+
+void CheckedFile::CheckStatement(Sema &sema, vector<Diag> &diags, Statement &statement)
+{
+	auto scopes = m_root->children.size();
+	auto count = diags.size();
+
+	statement.firstSlot = m_root->frameSize;
+	sema.CheckStatement(statement.stmt);
+
+	statement.scopes.assign(m_root->children.begin() + scopes, m_root->children.end());
+	statement.semaDiags.assign(diags.begin() + count, diags.end());
+
+	for (auto name : getRootNames(statement.stmt.get()))
+	{
+		statement.decls.push_back(&m_root->decls.at(name->name));
+	}
+
+	for (auto &scope : statement.scopes)
+	{
+		collectCaptures(scope.get(), m_root.get(), statement.captures);
+	}
+}
+
+void CheckedFile::CheckFlow(Statement &statement)
+{
+	statement.flowDiags.clear();
+
+	DiagCollector collector(statement.flowDiags);
+	DiagBuilder diag(collector);
+	FlowChecker(diag).CheckStatement(statement.scopes);
+}
+
+void CheckedFile::CheckRoot()
+{
+	m_rootFlow.clear();
+
+	DiagCollector collector(m_rootFlow);
+	DiagBuilder diag(collector);
+	FlowChecker(diag).CheckRoot(m_file.get(), m_root.get());
+}
+
+bool CheckedFile::Redeclares(const Statement &statement) const
+{
+	auto names = getRootNames(statement.stmt.get());
+
+	for (auto &diag : statement.semaDiags)
+	{
+		if (diag.messageId != SemaAlreadyDeclaredAt)
+		{
+			continue;
+		}
+
+		for (auto name : names)
+		{
+			if (name->range.beg == diag.range.beg && name->range.end == diag.range.end)
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,75 @@
+#ifndef MOND_CHECKED_FILE_HPP
+#define MOND_CHECKED_FILE_HPP
+
+#include "Diag.hpp"
+#include "Token.hpp"
+#include "NodeIndex.hpp"
+#include "CancelToken.hpp"
+
+namespace Mond
+{
+	// A file checked the way the parser and Sema::Check would, with what each
+	// top-level statement made kept apart, so after an edit only the
+	// statements it touches are parsed and checked again. Those after them
+	// just move, the flow checks of the top level are all that's redone for
+	// the whole file.
+	class CheckedFile
+	{
+	public:
+		CheckedFile(const string &text, BuiltinScopePtr builtinScope, const CancelToken &token = CancelToken());
+
+		// Brings the file up to text. False if the edit can't be checked apart
+		// from the rest of the file, say it changes what a name at the top is
+		// or the file declares a name at the top twice, the file is then left
+		// half updated and has to be checked from scratch.
+		bool Update(const string &text);
+
+		const string &GetText() const;
+		ScopePtr RootScope() const;
+		const NodeIndex &GetIndex() const;
+
+		// What checking the text from scratch reports, in the same order.
+		vector<Diag> GetDiags() const;
+	private:
+		struct Statement
+		{
+			StmtPtr stmt;
+			// Where its first token is.
+			SourceInt offset;
+			Pos pos;
+			// The size of the root frame before it.
+			int firstSlot;
+			ScopePtrList scopes;
+			// What it declares at the top and the declarations at the top its
+			// functions capture.
+			vector<Decl *> decls;
+			vector<Decl *> captures;
+			vector<Diag> parseDiags;
+			vector<Diag> semaDiags;
+			vector<Diag> flowDiags;
+		};
+
+		// Parses statements from offset, which is at pos, until the file ends
+		// or stop says the old statements pick up again at the next token.
+		// Diagnostics from before the first statement go to leading, next is
+		// the token parsing stopped at.
+		vector<Statement> Parse(const string &text, SourceInt offset, Pos pos, const CancelToken &token, const function<bool (const Token &)> &stop, vector<Diag> &leading, Token &next) const;
+
+		void CheckStatement(Sema &sema, vector<Diag> &diags, Statement &statement);
+		void CheckFlow(Statement &statement);
+		void CheckRoot();
+		bool Redeclares(const Statement &statement) const;
+
+		string m_text;
+		BuiltinScopePtr m_builtin;
+		shared_ptr<StmtBlock> m_file;
+		ScopePtr m_root;
+		vector<Statement> m_statements;
+		vector<Diag> m_leading;
+		vector<Diag> m_rootFlow;
+		unordered_map<Decl *, int> m_captured;
+		NodeIndex m_index;
+	};
+}
+
+#endif
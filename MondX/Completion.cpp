@@ -0,0 +1,277 @@
+#include <cctype>
+#include <algorithm>
+#include <unordered_set>
+#include "Parser.hpp"
+#include "Completion.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Ranking
+// ---------------------------------------------------------------------------
+
+// The name points into a scope, the builtins or the field counts, so no
+// string is copied until the candidates are sorted. Key is its first eight
+// characters, most names differ within those so sorting rarely has to
+// follow the pointer.
+struct Candidate
+{
+	int match;
+	int rank;
+	uint64_t key;
+	CompletionItem::Kind kind;
+	const string *name;
+	bool builtin;
+};
+
+// Zero for a prefix match, one for a prefix match ignoring case, minus one
+// for no match.
+static int matchPrefix(const string &prefix, const string &name)
+{
+	if (name.size() < prefix.size())
+	{
+		return -1;
+	}
+	else if (name.compare(0, prefix.size(), prefix) == 0)
+	{
+		return 0;
+	}
+
+	for (size_t i = 0; i < prefix.size(); i++)
+	{
+		if (tolower((unsigned char)prefix[i]) != tolower((unsigned char)name[i]))
+		{
+			return -1;
+		}
+	}
+
+	return 1;
+}
+
+static void addCandidate(vector<Candidate> &candidates, const string &prefix, CompletionItem::Kind kind, const string &name, bool builtin, int rank)
+{
+	auto match = matchPrefix(prefix, name);
+
+	if (match < 0)
+	{
+		return;
+	}
+
+	Candidate candidate;
+	candidate.match = match;
+	candidate.rank = rank;
+	candidate.key = 0;
+	candidate.kind = kind;
+	candidate.name = &name;
+	candidate.builtin = builtin;
+
+	for (size_t i = 0; i < 8; i++)
+	{
+		candidate.key = candidate.key << 8 | (i < name.size() ? (unsigned char)name[i] : 0);
+	}
+
+	candidates.push_back(candidate);
+}
+
+static CompletionItem::Kind kindOf(Decl::Type type)
+{
+	switch (type)
+	{
+	case Decl::Variable: return CompletionItem::Variable;
+	case Decl::Constant: return CompletionItem::Constant;
+	case Decl::Function: return CompletionItem::Function;
+	case Decl::Sequence: return CompletionItem::Sequence;
+	case Decl::Argument: return CompletionItem::Argument;
+	}
+
+	throw logic_error("unreachable in kindOf");
+}
+
+// ---------------------------------------------------------------------------
+// Completion
+// ---------------------------------------------------------------------------
+
+CompletionResult Mond::Complete(const string &text, SourceInt offset, BuiltinScopePtr builtinScope, const CancelToken &token)
+{
+	CompletionResult result;
+	unordered_map<string, int> fields;
+
+	offset = std::max<SourceInt>(0, std::min<SourceInt>(offset, text.size()));
+
+	// Field names are counted across the whole text: names after a dot and
+	// object literal keys.
+	TopLevel topLevel;
+	auto skips = FindSkips(text, offset, offset, [&](Slice name, char prev, char prevPrev)
+	{
+		// The name being completed doesn't count as a use.
+		if (name.beg <= offset && name.end >= offset)
+		{
+			return;
+		}
+
+		auto next = name.end;
+
+		while (next < (SourceInt)text.size() && (text[next] == ' ' || text[next] == '\t'))
+		{
+			next++;
+		}
+
+		auto isField = prev == '.' && prevPrev != '.';
+		auto isKey = (prev == '{' || prev == ',') && next < (SourceInt)text.size() && text[next] == ':';
+
+		if (isField || isKey)
+		{
+			fields[text.substr(name.beg, name.end - name.beg)]++;
+		}
+	}, &topLevel);
+
+	DiagBuilder diag;
+	StringSource source(text.c_str());
+	Lexer lexer(diag, source);
+	lexer.SetCompletion(offset);
+	lexer.SetSkips(skips);
+	lexer.SetCancelToken(token);
+	lexer.SetPosition(topLevel.offset, topLevel.pos);
+
+	Parser parser(diag, source, lexer);
+	parser.SetCancelToken(token);
+
+	StmtPtrList statements;
+
+	parser.ParseFile([&](StmtPtr stmt)
+	{
+		statements.push_back(stmt);
+	});
+
+	auto target = parser.CompletionExpr();
+
+	if (!target)
+	{
+		return result;
+	}
+
+	// Only the statement being completed in is resolved, those before it
+	// count for the names they declare.
+	shared_ptr<StmtBlock> file(new StmtBlock());
+
+	for (auto &stmt : statements)
+	{
+		if (stmt->range.IsValid() && stmt->range.end < target->range.beg)
+		{
+			CollectTopLevelNames(stmt.get(), topLevel.names);
+		}
+		else
+		{
+			file->statements.push_back(stmt);
+		}
+	}
+
+	Sema sema(diag, builtinScope);
+	sema.SetCancelToken(token);
+
+	sema.RootScope()->decls.reserve(topLevel.names.size());
+
+	for (auto &name : topLevel.names)
+	{
+		sema.Declare(GetDeclType(name.second), Range(), name.first, nullptr);
+	}
+
+	auto scope = sema.Complete(file, target.get());
+	auto field = dynamic_cast<ExprFieldAccess *>(target.get());
+	vector<Candidate> candidates;
+	vector<string> builtinNames;
+
+	if (field)
+	{
+		result.prefix = field->name;
+		result.range.end = field->range.end;
+		result.range.beg = Pos(field->range.end.line, field->range.end.column - result.prefix.size());
+
+		for (auto &entry : fields)
+		{
+			addCandidate(candidates, result.prefix, CompletionItem::Field, entry.first, false, -entry.second);
+		}
+	}
+	else
+	{
+		result.prefix = static_cast<ExprId *>(target.get())->name;
+		result.range = target->range;
+
+		// Inner declarations shadow outer ones and builtins. The root scope
+		// can hold every name in a file, so those are looked up in it instead
+		// of being copied into seen.
+		std::unordered_set<string> seen;
+		Scope *root = NULL;
+		auto depth = 0;
+
+		for (; scope; scope = scope->parent, depth++)
+		{
+			for (auto &entry : scope->decls)
+			{
+				if (!seen.count(entry.first))
+				{
+					addCandidate(candidates, result.prefix, kindOf(entry.second.type), entry.first, false, depth);
+				}
+			}
+
+			if (!scope->parent)
+			{
+				root = scope;
+				continue;
+			}
+
+			for (auto &entry : scope->decls)
+			{
+				seen.insert(entry.first);
+			}
+		}
+
+		if (builtinScope)
+		{
+			auto &table = builtinScope->Table();
+			builtinNames.reserve(table.count);
+
+			for (uint32_t i = 0; i < table.count; i++)
+			{
+				builtinNames.push_back(string(table.entries[i].name, table.entries[i].nameLength));
+				auto &name = builtinNames.back();
+
+				if (!seen.count(name) && !(root && root->decls.count(name)))
+				{
+					addCandidate(candidates, result.prefix, kindOf(table.entries[i].type), name, true, depth);
+				}
+			}
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end(), [](const Candidate &a, const Candidate &b)
+	{
+		if (a.match != b.match)
+		{
+			return a.match < b.match;
+		}
+		else if (a.rank != b.rank)
+		{
+			return a.rank < b.rank;
+		}
+		else if (a.key != b.key)
+		{
+			return a.key < b.key;
+		}
+
+		return *a.name < *b.name;
+	});
+
+	result.items.reserve(candidates.size());
+
+	for (auto &candidate : candidates)
+	{
+		CompletionItem item;
+		item.kind = candidate.kind;
+		item.name = *candidate.name;
+		item.builtin = candidate.builtin;
+		result.items.push_back(item);
+	}
+
+	return result;
+}
@@ -0,0 +1,48 @@
+#ifndef MOND_COMPLETION_HPP
+#define MOND_COMPLETION_HPP
+
+#include "BuiltinScope.hpp"
+#include "CancelToken.hpp"
+
+namespace Mond
+{
+	struct CompletionItem
+	{
+		// The declaration kinds, plus fields.
+		enum Kind
+		{
+			Variable,
+			Constant,
+			Function,
+			Sequence,
+			Argument,
+			Field
+		};
+
+		Kind kind;
+		string name;
+		bool builtin;
+	};
+
+	struct CompletionResult
+	{
+		// What's been typed of the name, and where, so it can be replaced.
+		string prefix;
+		Range range;
+
+		// Best first: names starting with the prefix before those that only
+		// do ignoring case, then declarations from the innermost scope out
+		// with builtins last, or fields by how often the file uses them.
+		vector<CompletionItem> items;
+	};
+
+	// Completes the name at offset. After a dot it's any field name the file
+	// uses, otherwise anything declared in scope there. Only the top-level
+	// statement containing the offset is parsed, from the first one scanning
+	// the file can't follow if there's a syntax error before it, the names
+	// the statements before declare are taken from the scan. So the cost is
+	// little more than scanning the file and listing what's in scope.
+	CompletionResult Complete(const string &text, SourceInt offset, BuiltinScopePtr builtinScope, const CancelToken &token = CancelToken());
+}
+
+#endif
@@ -0,0 +1,337 @@
+#include <cmath>
+#include "Sema.hpp"
+#include "ConstFolder.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static ConstValuePtr MakeValue(ConstValue::Type type)
+{
+	auto value = new ConstValue;
+	value->type = type;
+	value->number = 0;
+	return ConstValuePtr(value);
+}
+
+static ConstValuePtr MakeNumber(double number)
+{
+	auto value = MakeValue(ConstValue::Number);
+	value->number = number;
+	return value;
+}
+
+static ConstValuePtr MakeBool(bool b)
+{
+	return MakeValue(b ? ConstValue::True : ConstValue::False);
+}
+
+// Only values whose truthiness can't be argued about take part in conditions.
+static bool IsCondition(const ConstValue &v)
+{
+	switch (v.type)
+	{
+	case ConstValue::Undefined:
+	case ConstValue::Null:
+	case ConstValue::True:
+	case ConstValue::False:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static bool IsTruthy(const ConstValue &v)
+{
+	return v.type == ConstValue::True;
+}
+
+// Bitwise operators work on 32-bit integers, anything outside of that is left
+// for the runtime to deal with.
+static bool IsInt32(const ConstValue &v)
+{
+	return v.IsNumber() && v.number >= -2147483648.0 && v.number <= 2147483647.0;
+}
+
+static ConstValuePtr FoldArithmetic(TokenType op, double a, double b)
+{
+	switch (op)
+	{
+	case OpAdd:
+		return MakeNumber(a + b);
+	case OpSubtract:
+		return MakeNumber(a - b);
+	case OpMultiply:
+		return MakeNumber(a * b);
+	case OpDivide:
+		return MakeNumber(a / b);
+	case OpModulo:
+		return MakeNumber(fmod(a, b));
+	case OpExponent:
+		return MakeNumber(pow(a, b));
+	case OpGreaterThan:
+		return MakeBool(a > b);
+	case OpGreaterThanOrEqual:
+		return MakeBool(a >= b);
+	case OpLessThan:
+		return MakeBool(a < b);
+	case OpLessThanOrEqual:
+		return MakeBool(a <= b);
+	default:
+		return NULL;
+	}
+}
+
+static ConstValuePtr FoldBitwise(TokenType op, int32_t a, int32_t b)
+{
+	switch (op)
+	{
+	case OpBitLeftShift:
+		return MakeNumber((int32_t)((uint32_t)a << (b & 31)));
+	case OpBitRightShift:
+		return MakeNumber(a >> (b & 31));
+	case OpBitAnd:
+		return MakeNumber(a & b);
+	case OpBitOr:
+		return MakeNumber(a | b);
+	case OpBitXor:
+		return MakeNumber(a ^ b);
+	default:
+		return NULL;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Folder interface
+// ---------------------------------------------------------------------------
+
+ConstValuePtr ConstFolder::Fold(Expr *expr)
+{
+	if (!expr)
+	{
+		return NULL;
+	}
+
+	if (!expr->folded)
+	{
+		// Marking the node before descending also stops self-referencing
+		// constants from recursing forever.
+		expr->folded = true;
+		expr->Accept(this);
+	}
+
+	return expr->constant;
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+// ---------------------------------------------------------------------------
+
+void ConstFolder::Visit(Expr *)
+{
+	throw logic_error("unreachable in const folder visit expr");
+}
+
+void ConstFolder::Visit(ExprArrayLiteral *)
+{
+}
+
+void ConstFolder::Visit(ExprArraySlice *)
+{
+}
+
+void ConstFolder::Visit(ExprBinaryOp *expr)
+{
+	auto left = Fold(expr->left.get());
+	if (!left)
+	{
+		return;
+	}
+
+	// Short circuiting operators may fold without looking at the right side.
+	if (expr->type == OpConditionalAnd || expr->type == OpConditionalOr)
+	{
+		if (!left->IsBool())
+		{
+			return;
+		}
+
+		if (IsTruthy(*left) == (expr->type == OpConditionalOr))
+		{
+			expr->constant = left;
+			return;
+		}
+
+		auto right = Fold(expr->right.get());
+		if (right && right->IsBool())
+		{
+			expr->constant = right;
+		}
+
+		return;
+	}
+
+	auto right = Fold(expr->right.get());
+	if (!right)
+	{
+		return;
+	}
+
+	switch (expr->type)
+	{
+	case OpEqualTo:
+	case OpNotEqualTo:
+		// String contents are still raw source slices (see
+		// Parser::LiteralString) so comparing them would be wrong.
+		if (left->type != right->type || left->type == ConstValue::String)
+		{
+			return;
+		}
+
+		if (left->IsNumber())
+		{
+			expr->constant = MakeBool((left->number == right->number) == (expr->type == OpEqualTo));
+		}
+		else
+		{
+			expr->constant = MakeBool(expr->type == OpEqualTo);
+		}
+
+		return;
+	case OpBitLeftShift:
+	case OpBitRightShift:
+	case OpBitAnd:
+	case OpBitOr:
+	case OpBitXor:
+		if (IsInt32(*left) && IsInt32(*right))
+		{
+			expr->constant = FoldBitwise(expr->type, (int32_t)left->number, (int32_t)right->number);
+		}
+
+		return;
+	default:
+		if (left->IsNumber() && right->IsNumber())
+		{
+			expr->constant = FoldArithmetic(expr->type, left->number, right->number);
+		}
+
+		return;
+	}
+}
+
+void ConstFolder::Visit(ExprCall *)
+{
+}
+
+void ConstFolder::Visit(ExprFieldAccess *)
+{
+}
+
+void ConstFolder::Visit(ExprId *expr)
+{
+	if (expr->decl && expr->decl->type == Decl::Constant)
+	{
+		expr->constant = Fold(expr->decl->value.get());
+	}
+}
+
+void ConstFolder::Visit(ExprIndexAccess *)
+{
+}
+
+void ConstFolder::Visit(ExprLambda *)
+{
+}
+
+void ConstFolder::Visit(ExprNumberLiteral *expr)
+{
+	expr->constant = MakeNumber(expr->value);
+}
+
+void ConstFolder::Visit(ExprObjectLiteral *)
+{
+}
+
+void ConstFolder::Visit(ExprSimpleLiteral *expr)
+{
+	switch (expr->type)
+	{
+	case KwNull:
+		expr->constant = MakeValue(ConstValue::Null);
+		break;
+	case KwUndefined:
+		expr->constant = MakeValue(ConstValue::Undefined);
+		break;
+	case KwTrue:
+		expr->constant = MakeValue(ConstValue::True);
+		break;
+	case KwFalse:
+		expr->constant = MakeValue(ConstValue::False);
+		break;
+	case KwNaN:
+		expr->constant = MakeNumber(NAN);
+		break;
+	case KwInfinity:
+		expr->constant = MakeNumber(INFINITY);
+		break;
+	default:
+		break;
+	}
+}
+
+void ConstFolder::Visit(ExprStringLiteral *expr)
+{
+	auto value = MakeValue(ConstValue::String);
+	value->contents = expr->contents;
+	expr->constant = value;
+}
+
+void ConstFolder::Visit(ExprTernaryOp *expr)
+{
+	auto cond = Fold(expr->cond.get());
+	if (!cond || !IsCondition(*cond))
+	{
+		return;
+	}
+
+	expr->constant = Fold(IsTruthy(*cond) ? expr->thenExpr.get() : expr->elseExpr.get());
+}
+
+void ConstFolder::Visit(ExprUnaryOp *expr)
+{
+	auto value = Fold(expr->value.get());
+	if (!value)
+	{
+		return;
+	}
+
+	switch (expr->type)
+	{
+	case OpSubtract:
+		if (value->IsNumber())
+		{
+			expr->constant = MakeNumber(-value->number);
+		}
+		break;
+	case OpBitNot:
+		if (IsInt32(*value))
+		{
+			expr->constant = MakeNumber(~(int32_t)value->number);
+		}
+		break;
+	case OpNot:
+		if (IsCondition(*value))
+		{
+			expr->constant = MakeBool(!IsTruthy(*value));
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+void ConstFolder::Visit(ExprYield *)
+{
+}
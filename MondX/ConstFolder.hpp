@@ -0,0 +1,66 @@
+#ifndef MOND_CONST_FOLDER_HPP
+#define MOND_CONST_FOLDER_HPP
+
+#include "AST.hpp"
+
+namespace Mond
+{
+	struct ConstValue
+	{
+		enum Type
+		{
+			Undefined,
+			Null,
+			True,
+			False,
+			Number,
+			String
+		};
+
+		bool IsBool() const;
+		bool IsNumber() const;
+
+		Type type;
+		double number;
+		string contents;
+	};
+
+	class ConstFolder : public Visitor
+	{
+	public:
+		ConstValuePtr Fold(Expr *expr);
+
+		virtual void Visit(Expr *);
+		virtual void Visit(ExprArrayLiteral *);
+		virtual void Visit(ExprArraySlice *);
+		virtual void Visit(ExprBinaryOp *);
+		virtual void Visit(ExprCall *);
+		virtual void Visit(ExprFieldAccess *);
+		virtual void Visit(ExprId *);
+		virtual void Visit(ExprIndexAccess *);
+		virtual void Visit(ExprLambda *);
+		virtual void Visit(ExprNumberLiteral *);
+		virtual void Visit(ExprObjectLiteral *);
+		virtual void Visit(ExprSimpleLiteral *);
+		virtual void Visit(ExprStringLiteral *);
+		virtual void Visit(ExprTernaryOp *);
+		virtual void Visit(ExprUnaryOp *);
+		virtual void Visit(ExprYield *);
+	};
+
+	// -----------------------------------------------------------------------
+	// ConstValue implementation
+	// -----------------------------------------------------------------------
+
+	inline bool ConstValue::IsBool() const
+	{
+		return type == True || type == False;
+	}
+
+	inline bool ConstValue::IsNumber() const
+	{
+		return type == Number;
+	}
+}
+
+#endif
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include "Dataflow.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// Slots are solved 64 at a time, one machine word per block.
+static const size_t SliceBits = 64;
+
+struct EventRef
+{
+	int block;
+	int event;
+	int bit;
+};
+
+// Position of every block in reverse postorder from the entry, blocks that
+// can't be reached from it come last. Working through blocks in this order
+// lets forward problems settle in a couple of passes.
+static vector<int> ReversePostorder(const Cfg &cfg)
+{
+	vector<int> order;
+	vector<bool> visited(cfg.blocks.size(), false);
+	vector<pair<int, size_t>> stack;
+
+	order.reserve(cfg.blocks.size());
+	stack.push_back(std::make_pair((int)Cfg::Entry, (size_t)0));
+	visited[Cfg::Entry] = true;
+
+	while (!stack.empty())
+	{
+		auto &top = stack.back();
+		auto &succs = cfg.blocks[top.first].succs;
+
+		if (top.second < succs.size())
+		{
+			auto succ = succs[top.second++];
+
+			if (!visited[succ])
+			{
+				visited[succ] = true;
+				stack.push_back(std::make_pair(succ, (size_t)0));
+			}
+
+			continue;
+		}
+
+		order.push_back(top.first);
+		stack.pop_back();
+	}
+
+	std::reverse(order.begin(), order.end());
+
+	for (size_t i = 0; i < cfg.blocks.size(); i++)
+	{
+		if (!visited[i])
+		{
+			order.push_back(i);
+		}
+	}
+
+	vector<int> position(cfg.blocks.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		position[order[i]] = i;
+	}
+
+	return position;
+}
+
+static DataflowProblem::Effect GetEffect(const DataflowProblem &problem, const CfgEvent &event)
+{
+	switch (event.kind)
+	{
+	case CfgEvent::Declare:
+		return problem.declare;
+	case CfgEvent::Read:
+		return problem.read;
+	default:
+		return problem.write;
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Solver
+// ---------------------------------------------------------------------------
+
+// Solving only ever happens for union problems: an intersection problem is
+// the complement of the union problem with gen and kill swapped. Starting
+// from empty sets, a block can only change once something it depends on
+// gens, so the worklist is seeded with the blocks holding events and bits
+// spread no further than they actually flow. A local is then only paid for
+// in the blocks it's alive in, rather than in every block of the frame.
+class SliceSolver
+{
+public:
+	SliceSolver(const Cfg &cfg, const DataflowProblem &problem);
+
+	void Solve(const vector<EventRef> &events, const DataflowObserver &observer);
+private:
+	DataflowProblem::Effect EffectOf(const CfgEvent &event) const;
+	void Touch(int block);
+
+	const Cfg &m_cfg;
+	const DataflowProblem &m_problem;
+	bool m_forward;
+	bool m_complement;
+	int m_boundary;
+	vector<int> m_position;
+	vector<uint64_t> m_gen;
+	vector<uint64_t> m_kill;
+	vector<uint64_t> m_before;
+	vector<uint64_t> m_after;
+	vector<bool> m_queued;
+	vector<bool> m_touched;
+	vector<int> m_touchedList;
+};
+
+SliceSolver::SliceSolver(const Cfg &cfg, const DataflowProblem &problem) :
+	m_cfg(cfg),
+	m_problem(problem),
+	m_forward(problem.direction == DataflowProblem::Forward),
+	m_complement(problem.meet == DataflowProblem::Intersection),
+	m_boundary(m_forward ? Cfg::Entry : Cfg::Exit),
+	m_position(ReversePostorder(cfg)),
+	m_gen(cfg.blocks.size(), 0),
+	m_kill(cfg.blocks.size(), 0),
+	m_before(cfg.blocks.size(), 0),
+	m_after(cfg.blocks.size(), 0),
+	m_queued(cfg.blocks.size(), false),
+	m_touched(cfg.blocks.size(), false)
+{
+	if (!m_forward)
+	{
+		for (auto &position : m_position)
+		{
+			position = cfg.blocks.size() - position - 1;
+		}
+	}
+}
+
+// Events of one slice in block order, bits relative to the slice.
+void SliceSolver::Solve(const vector<EventRef> &events, const DataflowObserver &observer)
+{
+	// Gen and kill are built walking each block in the direction of the
+	// problem, a later event on a slot overrides an earlier one.
+	for (size_t i = 0; i < events.size(); i++)
+	{
+		auto &ref = events[m_forward ? i : events.size() - i - 1];
+		auto mask = (uint64_t)1 << ref.bit;
+		auto effect = EffectOf(m_cfg.blocks[ref.block].events[ref.event]);
+
+		if (effect == DataflowProblem::Gen)
+		{
+			m_gen[ref.block] |= mask;
+			m_kill[ref.block] &= ~mask;
+		}
+		else if (effect == DataflowProblem::Kill)
+		{
+			m_kill[ref.block] |= mask;
+			m_gen[ref.block] &= ~mask;
+		}
+
+		Touch(ref.block);
+	}
+
+	vector<int> seeds(m_touchedList);
+	if (m_problem.boundary != m_complement)
+	{
+		m_before[m_boundary] = ~(uint64_t)0;
+		Touch(m_boundary);
+		seeds.push_back(m_boundary);
+	}
+
+	std::sort(seeds.begin(), seeds.end(), [&](int a, int b)
+	{
+		return m_position[a] < m_position[b];
+	});
+
+	seeds.erase(std::unique(seeds.begin(), seeds.end()), seeds.end());
+
+	deque<int> worklist(seeds.begin(), seeds.end());
+	for (auto block : seeds)
+	{
+		m_queued[block] = true;
+	}
+
+	while (!worklist.empty())
+	{
+		auto block = worklist.front();
+		worklist.pop_front();
+		m_queued[block] = false;
+
+		auto &blockInfo = m_cfg.blocks[block];
+
+		if (block != m_boundary)
+		{
+			uint64_t in = 0;
+			for (auto prev : m_forward ? blockInfo.preds : blockInfo.succs)
+			{
+				in |= m_after[prev];
+			}
+
+			m_before[block] = in;
+		}
+
+		auto value = (m_before[block] & ~m_kill[block]) | m_gen[block];
+		Touch(block);
+
+		if (value == m_after[block])
+		{
+			continue;
+		}
+
+		m_after[block] = value;
+
+		for (auto next : m_forward ? blockInfo.succs : blockInfo.preds)
+		{
+			if (!m_queued[next])
+			{
+				m_queued[next] = true;
+				worklist.push_back(next);
+			}
+		}
+	}
+
+	// Replay each block from its fixed point to hand out the value in front
+	// of every event.
+	for (size_t i = 0; i < events.size();)
+	{
+		auto block = events[i].block;
+		auto end = i;
+
+		while (end < events.size() && events[end].block == block)
+		{
+			end++;
+		}
+
+		auto value = m_before[block];
+
+		for (size_t j = 0; j < end - i; j++)
+		{
+			auto &ref = events[m_forward ? i + j : end - j - 1];
+			auto &event = m_cfg.blocks[block].events[ref.event];
+			auto mask = (uint64_t)1 << ref.bit;
+			auto effect = EffectOf(event);
+
+			observer(block, event, ((value & mask) != 0) != m_complement);
+
+			if (effect == DataflowProblem::Gen)
+			{
+				value |= mask;
+			}
+			else if (effect == DataflowProblem::Kill)
+			{
+				value &= ~mask;
+			}
+		}
+
+		i = end;
+	}
+
+	// Only what this slice touched needs clearing for the next one.
+	for (auto block : m_touchedList)
+	{
+		m_gen[block] = 0;
+		m_kill[block] = 0;
+		m_before[block] = 0;
+		m_after[block] = 0;
+		m_touched[block] = false;
+	}
+
+	m_touchedList.clear();
+}
+
+DataflowProblem::Effect SliceSolver::EffectOf(const CfgEvent &event) const
+{
+	auto effect = GetEffect(m_problem, event);
+
+	if (m_complement && effect != DataflowProblem::None)
+	{
+		return effect == DataflowProblem::Gen ? DataflowProblem::Kill : DataflowProblem::Gen;
+	}
+
+	return effect;
+}
+
+void SliceSolver::Touch(int block)
+{
+	if (!m_touched[block])
+	{
+		m_touched[block] = true;
+		m_touchedList.push_back(block);
+	}
+}
+
+void Mond::SolveDataflow(const Cfg &cfg, const DataflowProblem &problem, const DataflowObserver &observer)
+{
+	auto slots = (size_t)cfg.frame->frameSize;
+
+	if (!problem.tracked.empty() && problem.tracked.size() != slots)
+	{
+		throw invalid_argument("dataflow problem doesn't match the frame");
+	}
+
+	// Tracked slots are packed together so untracked ones cost nothing.
+	vector<int> bits(slots, -1);
+	size_t count = 0;
+
+	for (size_t i = 0; i < slots; i++)
+	{
+		if (problem.tracked.empty() || problem.tracked[i])
+		{
+			bits[i] = count++;
+		}
+	}
+
+	if (count == 0)
+	{
+		return;
+	}
+
+	vector<vector<EventRef>> slices((count + SliceBits - 1) / SliceBits);
+
+	for (size_t b = 0; b < cfg.blocks.size(); b++)
+	{
+		auto &events = cfg.blocks[b].events;
+
+		for (size_t e = 0; e < events.size(); e++)
+		{
+			if (events[e].kind == CfgEvent::Statement || bits[events[e].slot] < 0)
+			{
+				continue;
+			}
+
+			auto bit = bits[events[e].slot];
+			EventRef ref = { (int)b, (int)e, (int)(bit % SliceBits) };
+			slices[bit / SliceBits].push_back(ref);
+		}
+	}
+
+	SliceSolver solver(cfg, problem);
+
+	for (auto &slice : slices)
+	{
+		solver.Solve(slice, observer);
+	}
+}
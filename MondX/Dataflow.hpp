@@ -0,0 +1,53 @@
+#ifndef MOND_DATAFLOW_HPP
+#define MOND_DATAFLOW_HPP
+
+#include "Cfg.hpp"
+
+namespace Mond
+{
+	// A gen/kill problem with one bit per tracked frame slot, where the
+	// declaration, reads and writes of a slot gen, kill or leave its bit. The
+	// boundary is the value of every bit flowing into the entry block of
+	// forward problems and out of the exit block of backward ones.
+	struct DataflowProblem
+	{
+		enum Direction
+		{
+			Forward,
+			Backward
+		};
+
+		enum Meet
+		{
+			Union,
+			Intersection
+		};
+
+		enum Effect
+		{
+			None,
+			Gen,
+			Kill
+		};
+
+		Direction direction;
+		Meet meet;
+		bool boundary;
+		Effect declare;
+		Effect read;
+		Effect write;
+
+		// Indexed by slot, an empty vector tracks every slot of the frame.
+		vector<bool> tracked;
+	};
+
+	// Receives every event on a tracked slot, the block holding it and the
+	// bit of that slot right before the event, "before" in the direction of
+	// the problem. Large frames are solved a slice of slots at a time, so
+	// events arrive in no particular order.
+	typedef function<void(int block, const CfgEvent &event, bool value)> DataflowObserver;
+
+	void SolveDataflow(const Cfg &cfg, const DataflowProblem &problem, const DataflowObserver &observer);
+}
+
+#endif
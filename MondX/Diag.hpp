@@ -15,6 +15,7 @@ namespace Mond
 
 	struct Diag
 	{
+		FileId file;
 		Pos caret;
 		Range range;
 		string message;
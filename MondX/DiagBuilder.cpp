@@ -2,11 +2,68 @@
 
 using namespace Mond;
 
+static void appendUnsigned(string &out, uint64_t n, int base)
+{
+	char digits[24];
+	auto end = digits + sizeof(digits);
+	auto p = end;
+
+	do
+	{
+		*--p = "0123456789abcdef"[n % base];
+		n /= base;
+	}
+	while (n);
+
+	out.append(p, end);
+}
+
+static void appendInt(string &out, int64_t n)
+{
+	if (n < 0)
+	{
+		out += '-';
+		appendUnsigned(out, 0 - (uint64_t)n, 10);
+	}
+	else
+	{
+		appendUnsigned(out, n, 10);
+	}
+}
+
+DiagBuilder::DiagBuilder() :
+	m_pos(0),
+	m_fmt(NULL),
+	m_file(0),
+	m_diag(),
+	m_sink(NULL),
+	m_observer(DiagObserver())
+{
+}
+
+DiagBuilder::DiagBuilder(DiagSink &sink) :
+	m_pos(0),
+	m_fmt(NULL),
+	m_file(0),
+	m_diag(),
+	m_sink(&sink),
+	m_observer(DiagObserver())
+{
+}
+
 DiagBuilder::DiagBuilder(DiagObserver fn) :
 	m_pos(0),
 	m_fmt(NULL),
-	m_func(fn)
+	m_file(0),
+	m_diag(),
+	m_sink(&m_observer),
+	m_observer(fn)
+{
+}
+
+void DiagBuilder::SetFile(FileId file)
 {
+	m_file = file;
 }
 
 DiagBuilder &DiagBuilder::operator<<(Pos caret)
@@ -37,22 +94,38 @@ DiagBuilder &DiagBuilder::operator<<(DiagMessage m)
 
 DiagBuilder &DiagBuilder::operator<<(int n)
 {
-	WriteUntilFormatter('d');
-	m_msg << n;
+	return *this << (int64_t)n;
+}
+
+DiagBuilder &DiagBuilder::operator<<(int64_t n)
+{
+	if (m_sink)
+	{
+		WriteUntilFormatter('d');
+		appendInt(m_diag.message, n);
+	}
+
 	return *this;
 }
 
 DiagBuilder &DiagBuilder::operator<<(uint32_t c)
 {
+	if (!m_sink)
+	{
+		return *this;
+	}
+
 	WriteUntilFormatter('c');
 
 	if (isprint(c))
 	{
-		m_msg << (char)c;
+		m_diag.message += (char)c;
 	}
 	else
 	{
-		m_msg << "<0x" << hex << c << ">";
+		m_diag.message += "<0x";
+		appendUnsigned(m_diag.message, c, 16);
+		m_diag.message += '>';
 	}
 
 	return *this;
@@ -60,36 +133,51 @@ DiagBuilder &DiagBuilder::operator<<(uint32_t c)
 
 DiagBuilder &DiagBuilder::operator<<(TokenType t)
 {
-	WriteUntilFormatter('t');
-	m_msg << GetTokenTypeName(t);
+	if (m_sink)
+	{
+		WriteUntilFormatter('t');
+		m_diag.message += GetTokenTypeName(t);
+	}
+
 	return *this;
 }
 
 DiagBuilder &DiagBuilder::operator<<(const string &s)
 {
-	WriteUntilFormatter('s');
-	m_msg << s;
+	if (m_sink)
+	{
+		WriteUntilFormatter('s');
+		m_diag.message += s;
+	}
+
 	return *this;
 }
 
+// The message is cleared rather than the whole diagnostic reset, so its
+// buffer carries over to the next one.
 DiagBuilder &DiagBuilder::operator<<(DiagSentinel b)
 {
-	WriteRest();
-
-	m_diag.message = m_msg.str();
-	m_func(m_diag);
+	if (m_sink)
+	{
+		WriteRest();
+		m_diag.file = m_file;
+		m_sink->Report(m_diag);
+	}
 
 	m_pos = 0;
 	m_fmt = NULL;
-	m_msg.str("");
-	m_diag = Diag();
+	m_diag.caret = Pos();
+	m_diag.range = Range();
+	m_diag.severity = Info;
+	m_diag.messageId = DiagMessage();
+	m_diag.message.clear();
 
 	return *this;
 }
 
 void DiagBuilder::WriteRest()
 {
-	m_msg << &m_fmt[m_pos];
+	m_diag.message += &m_fmt[m_pos];
 }
 
 void DiagBuilder::WriteUntilFormatter(char expect)
@@ -100,10 +188,10 @@ void DiagBuilder::WriteUntilFormatter(char expect)
 	{
 	}
 
-	m_msg.write(&m_fmt[beg], m_pos - beg - 1);
+	m_diag.message.append(&m_fmt[beg], m_pos - beg - 1);
 
 	if (m_fmt[m_pos++] != expect)
 	{
 		throw logic_error("invalid diagnostic format string");
 	}
-}
\ No newline at end of file
+}
@@ -13,32 +13,76 @@ namespace Mond
 
 	typedef function<void(const Diag &)> DiagObserver;
 
+	// Where finished diagnostics go. The diagnostic and its message are
+	// reused for the next one, anything kept has to be copied.
+	class DiagSink
+	{
+	public:
+		virtual ~DiagSink() {}
+
+		virtual void Report(const Diag &diag) = 0;
+	};
+
+	// Keeps every diagnostic.
+	class DiagCollector : public DiagSink
+	{
+	public:
+		DiagCollector(vector<Diag> &diags) : m_diags(diags) {}
+
+		void Report(const Diag &diag) { m_diags.push_back(diag); }
+	private:
+		vector<Diag> &m_diags;
+	};
+
+	// Formats each message into a buffer that's kept between diagnostics, so
+	// past the first few nothing is allocated.
 	class DiagBuilder
 	{
 	public:
+		// Discards everything, without formatting it.
+		DiagBuilder();
+		DiagBuilder(DiagSink &sink);
 		DiagBuilder(DiagObserver fn);
 
+		// Diagnostics built from here on belong to this file.
+		void SetFile(FileId file);
+
 		DiagBuilder &operator<<(Pos caret);
 		DiagBuilder &operator<<(Range range);
 		DiagBuilder &operator<<(Severity s);
 		DiagBuilder &operator<<(DiagMessage m);
 
 		DiagBuilder &operator<<(int n);
+		DiagBuilder &operator<<(int64_t n);
 		DiagBuilder &operator<<(uint32_t c);
 		DiagBuilder &operator<<(TokenType t);
 		DiagBuilder &operator<<(const string &s);
 
 		DiagBuilder &operator<<(DiagSentinel b);
 	private:
+		class ObserverSink : public DiagSink
+		{
+		public:
+			ObserverSink(DiagObserver fn) : m_fn(fn) {}
+
+			void Report(const Diag &diag) { m_fn(diag); }
+		private:
+			DiagObserver m_fn;
+		};
+
+		DiagBuilder(const DiagBuilder &);
+		DiagBuilder &operator=(const DiagBuilder &);
+
 		void WriteRest();
 		void WriteUntilFormatter(char expect);
 
 		int m_pos;
 		const char *m_fmt;
+		FileId m_file;
 
 		Diag m_diag;
-		stringstream m_msg;
-		DiagObserver m_func;
+		DiagSink *m_sink;
+		ObserverSink m_observer;
 	};
 }
 
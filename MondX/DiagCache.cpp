@@ -0,0 +1,261 @@
+#include <cstring>
+#include <algorithm>
+#include "Hash.hpp"
+#include "DiagCache.hpp"
+#include "FileSystem.hpp"
+#include "MappedFile.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Entry format
+// ---------------------------------------------------------------------------
+
+// An entry is a header, followed by one record per diagnostic, followed by a
+// pool holding the messages. Like builtin snapshots everything is stored in
+// the byte order of the machine that wrote it.
+
+static const char EntryMagic[4] = { 'M', 'X', 'D', 'C' };
+static const uint32_t EntryVersion = 1;
+
+struct EntryHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t key;
+	uint32_t count;
+	uint32_t poolSize;
+};
+
+// The name GetPath gives an entry, anything else in the directory isn't ours.
+static bool parseEntryName(const string &name, uint64_t &key)
+{
+	if (name.size() != 20 || name.compare(16, 4, ".mxd") != 0)
+	{
+		return false;
+	}
+
+	key = 0;
+
+	for (size_t i = 0; i < 16; i++)
+	{
+		auto c = name[i];
+
+		if (c >= '0' && c <= '9')
+		{
+			key = key * 16 + (c - '0');
+		}
+		else if (c >= 'a' && c <= 'f')
+		{
+			key = key * 16 + (c - 'a' + 10);
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+struct EntryRecord
+{
+	int64_t caret[2];
+	int64_t range[4];
+	uint32_t message;
+	uint32_t messageLength;
+	uint32_t messageId;
+	uint32_t severity;
+};
+
+// ---------------------------------------------------------------------------
+// DiagCache
+// ---------------------------------------------------------------------------
+
+DiagCache::DiagCache(const string &directory, uint64_t maxBytes) :
+	m_directory(directory),
+	m_maxBytes(maxBytes),
+	m_hits(0),
+	m_misses(0),
+	m_stores(0),
+	m_evictions(0)
+{
+	MakeDirectory(m_directory);
+}
+
+uint64_t DiagCache::MakeKey(uint64_t contentsHash, uint64_t configHash)
+{
+	static const uint64_t versionHash = HashBytes(MONDX_VERSION, strlen(MONDX_VERSION), sizeof(SourceInt));
+	return HashCombine(contentsHash, HashCombine(configHash, versionHash));
+}
+
+bool DiagCache::Load(uint64_t key, vector<Diag> &diags)
+{
+	auto path = GetPath(key);
+	MappedFile file(path);
+	EntryHeader header;
+
+	if (!file.IsValid() || file.Size() < sizeof(header))
+	{
+		m_misses++;
+		return false;
+	}
+
+	memcpy(&header, file.Data(), sizeof(header));
+
+	if (memcmp(header.magic, EntryMagic, sizeof(EntryMagic)) != 0 ||
+		header.version != EntryVersion ||
+		header.key != key ||
+		file.Size() != sizeof(header) + (size_t)header.count * sizeof(EntryRecord) + header.poolSize)
+	{
+		m_misses++;
+		return false;
+	}
+
+	auto data = file.Data() + sizeof(header);
+	auto pool = data + (size_t)header.count * sizeof(EntryRecord);
+	vector<Diag> loaded(header.count);
+
+	for (uint32_t i = 0; i < header.count; i++)
+	{
+		EntryRecord record;
+		memcpy(&record, data + i * sizeof(EntryRecord), sizeof(record));
+
+		if ((uint64_t)record.message + record.messageLength > header.poolSize || record.severity > Error)
+		{
+			m_misses++;
+			return false;
+		}
+
+		auto &diag = loaded[i];
+		diag.file = 0;
+		diag.caret = Pos((SourceInt)record.caret[0], (SourceInt)record.caret[1]);
+		diag.range.beg = Pos((SourceInt)record.range[0], (SourceInt)record.range[1]);
+		diag.range.end = Pos((SourceInt)record.range[2], (SourceInt)record.range[3]);
+		diag.message.assign(pool + record.message, record.messageLength);
+		diag.severity = (Severity)record.severity;
+		diag.messageId = (DiagMessage)record.messageId;
+	}
+
+	TouchFile(path);
+	diags.swap(loaded);
+	m_hits++;
+
+	std::lock_guard<std::mutex> lock(m_usedMutex);
+	m_used.insert(key);
+	return true;
+}
+
+void DiagCache::Store(uint64_t key, const vector<Diag> &diags)
+{
+	string pool;
+	vector<EntryRecord> records;
+
+	for (auto &diag : diags)
+	{
+		EntryRecord record;
+		memset(&record, 0, sizeof(record));
+		record.caret[0] = diag.caret.line;
+		record.caret[1] = diag.caret.column;
+		record.range[0] = diag.range.beg.line;
+		record.range[1] = diag.range.beg.column;
+		record.range[2] = diag.range.end.line;
+		record.range[3] = diag.range.end.column;
+		record.message = pool.size();
+		record.messageLength = diag.message.size();
+		record.messageId = diag.messageId;
+		record.severity = diag.severity;
+		pool += diag.message;
+
+		records.push_back(record);
+	}
+
+	EntryHeader header;
+	memcpy(header.magic, EntryMagic, sizeof(EntryMagic));
+	header.version = EntryVersion;
+	header.key = key;
+	header.count = records.size();
+	header.poolSize = pool.size();
+
+	string contents;
+	contents.append((const char *)&header, sizeof(header));
+	contents.append((const char *)records.data(), records.size() * sizeof(EntryRecord));
+	contents += pool;
+
+	// A failed write only costs the next run a miss.
+	if (WriteFileAtomic(GetPath(key), contents))
+	{
+		m_stores++;
+
+		std::lock_guard<std::mutex> lock(m_usedMutex);
+		m_used.insert(key);
+	}
+}
+
+void DiagCache::Evict()
+{
+	vector<FileInfo> entries;
+	uint64_t total = 0;
+
+	// Files being written have a .tmp name of their own until they're
+	// renamed into place, so they're never entries.
+	for (auto &file : ListFiles(m_directory))
+	{
+		uint64_t key;
+
+		if (parseEntryName(file.name, key))
+		{
+			total += file.size;
+			entries.push_back(file);
+		}
+	}
+
+	// Hits touch their entry, so the modification time is when it was last
+	// used, in whatever resolution the file system keeps.
+	std::stable_sort(entries.begin(), entries.end(), [](const FileInfo &a, const FileInfo &b)
+	{
+		return a.modified < b.modified;
+	});
+
+	std::lock_guard<std::mutex> lock(m_usedMutex);
+
+	// Another process may be evicting too, a file it got to first just
+	// isn't counted twice.
+	for (auto &entry : entries)
+	{
+		uint64_t key;
+
+		if (total <= m_maxBytes)
+		{
+			break;
+		}
+		else if (parseEntryName(entry.name, key) && m_used.count(key))
+		{
+			continue;
+		}
+
+		total -= entry.size;
+
+		if (RemoveFile(m_directory + "/" + entry.name))
+		{
+			m_evictions++;
+		}
+	}
+}
+
+auto DiagCache::GetStats() const -> Stats
+{
+	Stats stats;
+	stats.hits = m_hits;
+	stats.misses = m_misses;
+	stats.stores = m_stores;
+	stats.evictions = m_evictions;
+	return stats;
+}
+
+string DiagCache::GetPath(uint64_t key) const
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.mxd", (unsigned long long)key);
+	return m_directory + "/" + name;
+}
@@ -0,0 +1,65 @@
+#ifndef MOND_DIAG_CACHE_HPP
+#define MOND_DIAG_CACHE_HPP
+
+#include <mutex>
+#include <atomic>
+#include <unordered_set>
+#include "Diag.hpp"
+
+// Bump whenever a change can alter the diagnostics of an unchanged file, it's
+// part of every DiagCache key.
+#define MONDX_VERSION "0.1.0"
+
+namespace Mond
+{
+	// Diagnostics of earlier runs, one file per key in a directory. Entries
+	// are renamed into place once they're complete, so any number of threads
+	// and processes can share a directory and a reader sees either a whole
+	// entry or none at all. Reading an entry marks it as recently used.
+	class DiagCache
+	{
+	public:
+		struct Stats
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t stores;
+			uint64_t evictions;
+		};
+
+		// Eviction keeps the directory under maxBytes. The directory is
+		// created if needed.
+		DiagCache(const string &directory, uint64_t maxBytes);
+
+		// A key covers the file contents and everything else the diagnostics
+		// depend on: the builtins, the checks that were run and the version.
+		static uint64_t MakeKey(uint64_t contentsHash, uint64_t configHash);
+
+		// Diagnostics come back without a file, set it before using them.
+		bool Load(uint64_t key, vector<Diag> &diags);
+		void Store(uint64_t key, const vector<Diag> &diags);
+
+		// Deletes the least recently used entries until the directory's
+		// entries fit. Nothing but entries is ever deleted, not other files
+		// in the directory or entries still being written, and neither are
+		// the entries this cache loaded or stored.
+		void Evict();
+
+		Stats GetStats() const;
+	private:
+		string GetPath(uint64_t key) const;
+
+		string m_directory;
+		uint64_t m_maxBytes;
+
+		std::mutex m_usedMutex;
+		std::unordered_set<uint64_t> m_used;
+
+		std::atomic<uint64_t> m_hits;
+		std::atomic<uint64_t> m_misses;
+		std::atomic<uint64_t> m_stores;
+		std::atomic<uint64_t> m_evictions;
+	};
+}
+
+#endif
@@ -67,6 +67,19 @@ const char *Mond::GetDiagMessageFormat(DiagMessage msg)
 		return "expression not storable";
 	case SemaMutatingConstant:
 		return "can't change constant '%s' declared at %d:%d";
+
+	case FlowUnusedVariable:
+		return "variable '%s' is never used";
+	case FlowUnusedConstant:
+		return "constant '%s' is never used";
+	case FlowUnusedArgument:
+		return "argument '%s' is never used";
+	case FlowUnreachableCode:
+		return "unreachable code";
+	case FlowDeadStore:
+		return "value stored to '%s' is never read";
+	case FlowUseBeforeAssign:
+		return "'%s' may be used before it is assigned";
 	}
 
 	throw invalid_argument("unknown diagnostic message");
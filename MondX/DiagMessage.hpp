@@ -38,6 +38,13 @@ namespace Mond
 
 		SemaExprNotStorable,
 		SemaMutatingConstant,
+
+		FlowUnusedVariable,
+		FlowUnusedConstant,
+		FlowUnusedArgument,
+		FlowUnreachableCode,
+		FlowDeadStore,
+		FlowUseBeforeAssign,
 	};
 
 	const char *GetDiagMessageFormat(DiagMessage msg);
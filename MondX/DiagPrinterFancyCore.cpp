@@ -3,7 +3,17 @@
 
 using namespace Mond;
 
-DiagPrinterFancyCore::DiagPrinterFancyCore(Source &source) : m_source(source)
+DiagPrinterFancyCore::DiagPrinterFancyCore(Source &source, FILE *out) :
+	m_out(out),
+	m_source(&source),
+	m_manager(NULL)
+{
+}
+
+DiagPrinterFancyCore::DiagPrinterFancyCore(const SourceManager &manager, FILE *out) :
+	m_out(out),
+	m_source(NULL),
+	m_manager(&manager)
 {
 }
 
@@ -11,22 +21,38 @@ void DiagPrinterFancyCore::operator()(const Diag &d)
 {
 	PrintSev(d, "");
 
+	auto source = m_source;
+	StringSource fileSource("");
+
+	if (m_manager && d.file != 0)
+	{
+		fileSource = m_manager->GetSource(d.file);
+		source = &fileSource;
+		fprintf(m_out, "%s:", m_manager->GetName(d.file).c_str());
+	}
+
 	if (d.caret.IsValid())
 	{
-		printf("%d:%d", d.caret.line, d.caret.column);
+		fprintf(m_out, "%lld:%lld", (long long)d.caret.line, (long long)d.caret.column);
 	}
 
 	if (d.range.IsValid() && d.caret.IsValid())
 	{
-		printf(" (%d:%d to %d:%d)", d.range.beg.line, d.range.beg.column, d.range.end.line, d.range.end.column);
+		fprintf(m_out, " (%lld:%lld to %lld:%lld)", (long long)d.range.beg.line, (long long)d.range.beg.column, (long long)d.range.end.line, (long long)d.range.end.column);
 	}
 
 	if (d.range.IsValid() && !d.caret.IsValid())
 	{
-		printf("%d:%d to %d:%d", d.range.beg.line, d.range.beg.column, d.range.end.line, d.range.end.column);
+		fprintf(m_out, "%lld:%lld to %lld:%lld", (long long)d.range.beg.line, (long long)d.range.beg.column, (long long)d.range.end.line, (long long)d.range.end.column);
 	}
 
-	printf(": %s\n", d.message.c_str());
+	fprintf(m_out, ": %s\n", d.message.c_str());
+
+	if (!source)
+	{
+		fprintf(m_out, "\n");
+		return;
+	}
 
 	Range range;
 
@@ -39,17 +65,17 @@ void DiagPrinterFancyCore::operator()(const Diag &d)
 		range = Range(d.caret, 1);
 	}
 
-	for (int line = range.beg.line; line <= range.end.line; line++)
+	for (SourceInt line = range.beg.line; line <= range.end.line; line++)
 	{
 		if (range.end.line - range.beg.line > 1)
 		{
 			if (line == range.beg.line)
 			{
-				PrintSev(d, "starting at line %d with:\n", line);
+				PrintSev(d, "starting at line %lld with:\n", (long long)line);
 			}
 			else if (line == range.end.line)
 			{
-				PrintSev(d, "ending at line %d with:\n", line);
+				PrintSev(d, "ending at line %lld with:\n", (long long)line);
 			}
 			else
 			{
@@ -57,15 +83,15 @@ void DiagPrinterFancyCore::operator()(const Diag &d)
 			}
 		}
 
-		auto linest = m_source.GetLine(line);
+		auto linest = source->GetLine(line);
 		auto marker = linest;
-		auto begCol = line == range.beg.line ? range.beg.column : (unsigned int)1;
-		auto endCol = line == range.end.line ? range.end.column : linest.length() + 1;
+		SourceInt begCol = line == range.beg.line ? range.beg.column : 1;
+		SourceInt endCol = line == range.end.line ? range.end.column : (SourceInt)linest.length() + 1;
 
 		// The marker might extend one character past the line end.
 		marker += ' ';
 
-		for (unsigned int j = 0; j < marker.size(); j++)
+		for (SourceInt j = 0; j < (SourceInt)marker.size(); j++)
 		{
 			if (d.caret.IsValid() && d.caret.line == line && j + 1 == d.caret.column)
 			{
@@ -85,11 +111,11 @@ void DiagPrinterFancyCore::operator()(const Diag &d)
 		PrintSev(d, ">>> ");
 
 		SetColor(d.severity);
-		printf("%s\n", marker.c_str());
+		fprintf(m_out, "%s\n", marker.c_str());
 		ResetColor();
 	}
 
-	printf("\n");
+	fprintf(m_out, "\n");
 }
 
 void DiagPrinterFancyCore::PrintSev(const Diag &d, const char *fmt, ...)
@@ -101,11 +127,11 @@ void DiagPrinterFancyCore::PrintSev(const Diag &d, const char *fmt, ...)
 	vsnprintf(buffer, 1024, fmt, ap);
 	va_end(ap);
 
-	printf("[");
+	fprintf(m_out, "[");
 
 	SetColor(d.severity);
-	printf("%s", GetSeverityName(d.severity));
+	fprintf(m_out, "%s", GetSeverityName(d.severity));
 	ResetColor();
 
-	printf("] %s", buffer);
+	fprintf(m_out, "] %s", buffer);
 }
\ No newline at end of file
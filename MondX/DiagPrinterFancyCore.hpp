@@ -1,24 +1,30 @@
 #ifndef MOND_DIAG_PRINTER_FANCY_CORE_HPP
 #define MOND_DIAG_PRINTER_FANCY_CORE_HPP
 
+#include <cstdio>
 #include "Diag.hpp"
-#include "Source.hpp"
+#include "SourceManager.hpp"
 
 namespace Mond
 {
 	class DiagPrinterFancyCore
 	{
 	public:
-		DiagPrinterFancyCore(Source &source);
+		DiagPrinterFancyCore(Source &source, FILE *out);
+		// Prints diagnostics of any file in the manager, prefixed by its name.
+		DiagPrinterFancyCore(const SourceManager &manager, FILE *out);
 
 		void operator()(const Diag &d);
+	protected:
+		FILE *m_out;
 	private:
 		void PrintSev(const Diag &d, const char *fmt, ...);
 
 		virtual void SetColor(Severity s) = 0;
 		virtual void ResetColor() = 0;
 
-		Source &m_source;
+		Source *m_source;
+		const SourceManager *m_manager;
 	};
 }
 
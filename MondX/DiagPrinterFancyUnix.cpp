@@ -2,7 +2,11 @@
 
 using namespace Mond;
 
-DiagPrinterFancy::DiagPrinterFancy(Source &source) : DiagPrinterFancyCore(source)
+DiagPrinterFancy::DiagPrinterFancy(Source &source, FILE *out) : DiagPrinterFancyCore(source, out)
+{
+}
+
+DiagPrinterFancy::DiagPrinterFancy(const SourceManager &manager, FILE *out) : DiagPrinterFancyCore(manager, out)
 {
 }
 
@@ -10,18 +14,18 @@ void DiagPrinterFancy::SetColor(Severity s)
 {
 	switch (s) {
 	case Info:
-		printf("\x1B[1;36m");
+		fprintf(m_out, "\x1B[1;36m");
 		break;
 	case Warning:
-		printf("\x1B[1;33m");
+		fprintf(m_out, "\x1B[1;33m");
 		break;
 	case Error:
-		printf("\x1B[1;31m");
+		fprintf(m_out, "\x1B[1;31m");
 		break;
 	}
 }
 
 void DiagPrinterFancy::ResetColor()
 {
-		printf("\x1B[0m");
+		fprintf(m_out, "\x1B[0m");
 }
\ No newline at end of file
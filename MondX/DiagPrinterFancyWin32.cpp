@@ -2,7 +2,17 @@
 
 using namespace Mond;
 
-DiagPrinterFancy::DiagPrinterFancy(Source &source) : DiagPrinterFancyCore(source)
+DiagPrinterFancy::DiagPrinterFancy(Source &source, FILE *out) : DiagPrinterFancyCore(source, out)
+{
+	Init();
+}
+
+DiagPrinterFancy::DiagPrinterFancy(const SourceManager &manager, FILE *out) : DiagPrinterFancyCore(manager, out)
+{
+	Init();
+}
+
+void DiagPrinterFancy::Init()
 {
 	CONSOLE_SCREEN_BUFFER_INFO info;
 
@@ -9,8 +9,10 @@ namespace Mond
 	class DiagPrinterFancy : public DiagPrinterFancyCore
 	{
 	public:
-		DiagPrinterFancy(Source &source);
+		DiagPrinterFancy(Source &source, FILE *out = stdout);
+		DiagPrinterFancy(const SourceManager &manager, FILE *out = stdout);
 	private:
+		void Init();
 		void SetColor(Severity s);
 		void ResetColor();
 
@@ -2,21 +2,34 @@
 
 using namespace Mond;
 
-DiagPrinterTool::DiagPrinterTool()
+DiagPrinterTool::DiagPrinterTool(FILE *out) :
+	m_out(out),
+	m_manager(NULL)
+{
+}
+
+DiagPrinterTool::DiagPrinterTool(const SourceManager &manager, FILE *out) :
+	m_out(out),
+	m_manager(&manager)
 {
 }
 
 void DiagPrinterTool::operator()(const Diag &d)
 {
+	if (m_manager && d.file != 0)
+	{
+		fprintf(m_out, "%s:", m_manager->GetName(d.file).c_str());
+	}
+
 	if (d.caret.IsValid())
 	{
-		printf("%d:%d: ", d.caret.line, d.caret.column);
+		fprintf(m_out, "%lld:%lld: ", (long long)d.caret.line, (long long)d.caret.column);
 	}
 
 	if (d.range.IsValid())
 	{
-		printf("%d:%d-%d:%d: ", d.range.beg.line, d.range.beg.column, d.range.end.line, d.range.end.column);
+		fprintf(m_out, "%lld:%lld-%lld:%lld: ", (long long)d.range.beg.line, (long long)d.range.beg.column, (long long)d.range.end.line, (long long)d.range.end.column);
 	}
 
-	printf("%s: %s\n", GetSeverityName(d.severity), d.message.c_str());
+	fprintf(m_out, "%s: %s\n", GetSeverityName(d.severity), d.message.c_str());
 }
\ No newline at end of file
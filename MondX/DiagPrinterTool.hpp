@@ -1,16 +1,23 @@
 #ifndef MOND_DIAG_PRINTER_TOOL_HPP
 #define MOND_DIAG_PRINTER_TOOL_HPP
 
+#include <cstdio>
 #include "Diag.hpp"
+#include "SourceManager.hpp"
 
 namespace Mond
 {
 	class DiagPrinterTool
 	{
 	public:
-		DiagPrinterTool();
+		DiagPrinterTool(FILE *out = stdout);
+		// Prefixes diagnostics with the name of their file in the manager.
+		DiagPrinterTool(const SourceManager &manager, FILE *out = stdout);
 
 		void operator()(const Diag &d);
+	private:
+		FILE *m_out;
+		const SourceManager *m_manager;
 	};
 }
 
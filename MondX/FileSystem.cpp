@@ -0,0 +1,211 @@
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+#include "FileSystem.hpp"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#include <sys/stat.h>
+#endif
+
+using namespace Mond;
+
+bool Mond::IsDirectory(const string &path)
+{
+#ifdef _WIN32
+	auto attributes = GetFileAttributesA(path.c_str());
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat info;
+	return stat(path.c_str(), &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+bool Mond::MakeDirectory(const string &path)
+{
+#ifdef _WIN32
+	return CreateDirectoryA(path.c_str(), NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+	return mkdir(path.c_str(), 0777) == 0 || IsDirectory(path);
+#endif
+}
+
+vector<string> Mond::ListDirectory(const string &path)
+{
+	vector<string> names;
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA data;
+	auto handle = FindFirstFileA((path + "\\*").c_str(), &data);
+
+	if (handle != INVALID_HANDLE_VALUE)
+	{
+		do
+		{
+			names.push_back(data.cFileName);
+		}
+		while (FindNextFileA(handle, &data));
+
+		FindClose(handle);
+	}
+#else
+	auto dir = opendir(path.c_str());
+
+	if (dir)
+	{
+		while (auto entry = readdir(dir))
+		{
+			names.push_back(entry->d_name);
+		}
+
+		closedir(dir);
+	}
+#endif
+
+	names.erase(std::remove_if(names.begin(), names.end(), [](const string &name)
+	{
+		return name == "." || name == "..";
+	}), names.end());
+
+	std::sort(names.begin(), names.end());
+	return names;
+}
+
+vector<FileInfo> Mond::ListFiles(const string &path)
+{
+	vector<FileInfo> files;
+
+	for (auto &name : ListDirectory(path))
+	{
+		FileInfo file;
+
+		if (GetFileInfo(path + "/" + name, file))
+		{
+			file.name = name;
+			files.push_back(file);
+		}
+	}
+
+	return files;
+}
+
+bool Mond::GetFileInfo(const string &path, FileInfo &file)
+{
+	file.name = path;
+
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data) ||
+		(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+	{
+		return false;
+	}
+
+	file.size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	file.modified = ((int64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat info;
+	if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		return false;
+	}
+
+	file.size = info.st_size;
+#ifdef __APPLE__
+	file.modified = (int64_t)info.st_mtimespec.tv_sec * 1000000000 + info.st_mtimespec.tv_nsec;
+#else
+	file.modified = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+#endif
+#endif
+
+	return true;
+}
+
+bool Mond::RemoveFile(const string &path)
+{
+	return remove(path.c_str()) == 0;
+}
+
+bool Mond::TouchFile(const string &path)
+{
+#ifdef _WIN32
+	auto handle = CreateFileA(path.c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+	if (handle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	auto ok = SetFileTime(handle, NULL, NULL, &now) != 0;
+	CloseHandle(handle);
+	return ok;
+#else
+	return utime(path.c_str(), NULL) == 0;
+#endif
+}
+
+bool Mond::WriteFileAtomic(const string &path, const string &contents)
+{
+	static std::atomic<uint32_t> counter(0);
+
+	// Unique between the threads of a process and between processes.
+#ifdef _WIN32
+	auto process = (unsigned long)GetCurrentProcessId();
+#else
+	auto process = (unsigned long)getpid();
+#endif
+
+	char suffix[64];
+	snprintf(suffix, sizeof(suffix), ".%lu.%u.tmp", process, (unsigned int)counter++);
+	auto temp = path + suffix;
+
+	auto file = fopen(temp.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+
+	auto written = fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+
+	if (fclose(file) != 0 || !written)
+	{
+		remove(temp.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	auto renamed = MoveFileExA(temp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	auto renamed = rename(temp.c_str(), path.c_str()) == 0;
+#endif
+
+	if (!renamed)
+	{
+		remove(temp.c_str());
+	}
+
+	return renamed;
+}
+
+bool Mond::WriteFileAt(const string &path, uint64_t offset, const string &contents)
+{
+	auto file = fopen(path.c_str(), "r+b");
+	if (!file)
+	{
+		return false;
+	}
+
+#ifdef _WIN32
+	auto seeked = _fseeki64(file, (int64_t)offset, SEEK_SET) == 0;
+#else
+	auto seeked = fseeko(file, (off_t)offset, SEEK_SET) == 0;
+#endif
+
+	auto written = seeked && fwrite(contents.data(), 1, contents.size(), file) == contents.size();
+	return fclose(file) == 0 && written;
+}
@@ -0,0 +1,39 @@
+#ifndef MOND_FILE_SYSTEM_HPP
+#define MOND_FILE_SYSTEM_HPP
+
+#include "Util.hpp"
+
+namespace Mond
+{
+	struct FileInfo
+	{
+		string name;
+		uint64_t size;
+		int64_t modified;
+	};
+
+	bool IsDirectory(const string &path);
+	bool MakeDirectory(const string &path);
+
+	// Names in a directory except . and .., sorted.
+	vector<string> ListDirectory(const string &path);
+	// Plain files in a directory with their size and modification time, in
+	// the finest units the platform has, only good for comparing.
+	vector<FileInfo> ListFiles(const string &path);
+	// The same for one file, named by its path. False if it isn't a plain
+	// file.
+	bool GetFileInfo(const string &path, FileInfo &file);
+
+	bool RemoveFile(const string &path);
+	bool TouchFile(const string &path);
+
+	// Writes to a file of its own next to path and renames it over path, so
+	// readers see the old contents or all of the new ones. Returns false if
+	// the file couldn't be written.
+	bool WriteFileAtomic(const string &path, const string &contents);
+	// Writes over an existing file from offset on, growing it if contents
+	// go past its end. Readers can see it half written.
+	bool WriteFileAt(const string &path, uint64_t offset, const string &contents);
+}
+
+#endif
@@ -0,0 +1,493 @@
+#include <algorithm>
+#include "Dataflow.hpp"
+#include "FlowChecker.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// Prefixing a name with an underscore says it's unused on purpose.
+static bool IsIgnored(const string &name)
+{
+	return !name.empty() && name[0] == '_';
+}
+
+static bool ComesBefore(const Pos &a, const Pos &b)
+{
+	return a.line < b.line || (a.line == b.line && a.column < b.column);
+}
+
+// ---------------------------------------------------------------------------
+// Checker interface
+// ---------------------------------------------------------------------------
+
+FlowChecker::FlowChecker(DiagBuilder &diag) :
+	m_diag(diag),
+	m_rootEnded(false),
+	m_rootDeadReported(false)
+{
+}
+
+void FlowChecker::Check(Stmt *file, Scope *root)
+{
+	m_findings.clear();
+	m_names.clear();
+	m_locals.clear();
+
+	CollectDecls(root);
+
+	vector<Cfg> cfgs;
+	BuildCfgs(file, root, cfgs);
+
+	for (auto &cfg : cfgs)
+	{
+		CheckFrame(cfg);
+	}
+
+	Flush();
+}
+
+// Only the scopes of the statement are walked, the root scope's own
+// declarations are left for FinishTopLevel. Reads of them are collected from
+// a graph of just this statement.
+void FlowChecker::CheckTopLevel(Stmt *stmt, Scope *root)
+{
+	m_findings.clear();
+	m_names.clear();
+	m_locals.clear();
+
+	vector<Scope *> frames;
+
+	for (auto &child : root->children)
+	{
+		CollectDecls(child.get());
+		CollectFrames(child.get(), frames);
+	}
+
+	for (auto frame : frames)
+	{
+		Cfg cfg;
+		CfgBuilder(cfg).Build(frame, GetFrameBody(frame));
+		CheckFrame(cfg);
+	}
+
+	Cfg cfg;
+	CfgBuilder(cfg).Build(root, stmt);
+
+	m_rootReads.resize(root->frameSize, false);
+
+	for (auto &block : cfg.blocks)
+	{
+		for (auto &event : block.events)
+		{
+			if (event.kind == CfgEvent::Read)
+			{
+				m_rootReads[event.slot] = true;
+			}
+		}
+	}
+
+	// Locals of blocks at the top level can't be seen outside the statement,
+	// so they get every check right away. Once a statement can't complete,
+	// the rest of the file is dead and only reported at its first statement.
+	auto hasLocals = !m_locals[root].empty();
+
+	if (m_rootEnded)
+	{
+		if (!m_rootDeadReported)
+		{
+			Report(stmt->range, FlowUnreachableCode, NULL);
+			m_rootDeadReported = true;
+		}
+
+		if (hasLocals)
+		{
+			CheckUnused(cfg, FindReads(cfg));
+		}
+	}
+	else
+	{
+		if (hasLocals)
+		{
+			CheckFrame(cfg);
+		}
+		else
+		{
+			CheckUnreachable(cfg, FindReachable(cfg));
+		}
+
+		m_rootEnded = !FindReachable(cfg)[cfg.end];
+	}
+
+	Flush();
+}
+
+void FlowChecker::FinishTopLevel(Scope *root)
+{
+	m_findings.clear();
+	m_names.clear();
+	m_locals.clear();
+
+	CollectDecls(root);
+
+	Cfg cfg;
+	cfg.frame = root;
+	cfg.body = NULL;
+	m_rootReads.resize(root->frameSize, false);
+
+	CheckUnused(cfg, m_rootReads);
+	Flush();
+}
+
+void FlowChecker::CheckStatement(const ScopePtrList &scopes)
+{
+	m_findings.clear();
+	m_names.clear();
+	m_locals.clear();
+
+	vector<Scope *> frames;
+
+	for (auto &scope : scopes)
+	{
+		CollectDecls(scope.get());
+		CollectFrames(scope.get(), frames);
+	}
+
+	for (auto frame : frames)
+	{
+		Cfg cfg;
+		CfgBuilder(cfg).Build(frame, GetFrameBody(frame));
+		CheckFrame(cfg);
+	}
+
+	Flush();
+}
+
+// Functions are left out, they only show up in the graph as the writes
+// declaring them anyway.
+void FlowChecker::CheckRoot(Stmt *file, Scope *root)
+{
+	m_findings.clear();
+	m_names.clear();
+	m_locals.clear();
+
+	CollectFrameDecls(root);
+
+	Cfg cfg;
+	CfgBuilder(cfg).Build(root, file);
+	CheckFrame(cfg);
+	Flush();
+}
+
+// ---------------------------------------------------------------------------
+// Checks
+// ---------------------------------------------------------------------------
+
+void FlowChecker::CollectDecls(Scope *scope)
+{
+	auto &locals = m_locals[scope->frame];
+
+	for (auto &entry : scope->decls)
+	{
+		m_names[&entry.second] = &entry.first;
+		locals.push_back(&entry.second);
+	}
+
+	for (auto &child : scope->children)
+	{
+		CollectDecls(child.get());
+	}
+}
+
+// Same order as CollectDecls, without going into other frames.
+void FlowChecker::CollectFrameDecls(Scope *scope)
+{
+	auto &locals = m_locals[scope->frame];
+
+	for (auto &entry : scope->decls)
+	{
+		m_names[&entry.second] = &entry.first;
+		locals.push_back(&entry.second);
+	}
+
+	for (auto &child : scope->children)
+	{
+		if (child->frame == scope->frame)
+		{
+			CollectFrameDecls(child.get());
+		}
+	}
+}
+
+void FlowChecker::CheckFrame(const Cfg &cfg)
+{
+	auto read = FindReads(cfg);
+	auto reachable = FindReachable(cfg);
+
+	CheckUnused(cfg, read);
+	CheckUnreachable(cfg, reachable);
+	CheckDeadStores(cfg, read, reachable);
+	CheckAssignment(cfg, reachable);
+}
+
+vector<bool> FlowChecker::FindReads(const Cfg &cfg)
+{
+	vector<bool> read(cfg.frame->frameSize, false);
+
+	for (auto &block : cfg.blocks)
+	{
+		for (auto &event : block.events)
+		{
+			if (event.kind == CfgEvent::Read)
+			{
+				read[event.slot] = true;
+			}
+		}
+	}
+
+	return read;
+}
+
+// Reads from nested functions show up as captures, so a local is used if
+// either its own frame reads it or it's captured.
+void FlowChecker::CheckUnused(const Cfg &cfg, const vector<bool> &read)
+{
+	auto &locals = m_locals[cfg.frame];
+
+	// Arguments before one that is used can't be left out of the list, so
+	// only the unused ones after the last used argument are reported.
+	int lastUsedArgument = -1;
+
+	for (auto decl : locals)
+	{
+		if (decl->type == Decl::Argument && (read[decl->slot] || decl->captured))
+		{
+			lastUsedArgument = std::max(lastUsedArgument, decl->slot);
+		}
+	}
+
+	for (auto decl : locals)
+	{
+		auto name = m_names[decl];
+
+		if (read[decl->slot] || decl->captured || IsIgnored(*name))
+		{
+			continue;
+		}
+
+		switch (decl->type)
+		{
+		case Decl::Variable:
+			Report(decl->range, FlowUnusedVariable, name);
+			break;
+		case Decl::Constant:
+			Report(decl->range, FlowUnusedConstant, name);
+			break;
+		case Decl::Argument:
+			if (decl->slot > lastUsedArgument)
+			{
+				Report(decl->range, FlowUnusedArgument, name);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+// Only the first statement of each stretch of dead code is reported, along
+// with everything reachable from it.
+void FlowChecker::CheckUnreachable(const Cfg &cfg, const vector<bool> &reachable)
+{
+	vector<bool> covered(cfg.blocks.size(), false);
+	vector<int> stack;
+
+	for (size_t b = 0; b < cfg.blocks.size(); b++)
+	{
+		if (reachable[b] || covered[b])
+		{
+			continue;
+		}
+
+		auto &events = cfg.blocks[b].events;
+		auto first = std::find_if(events.begin(), events.end(), [](const CfgEvent &event)
+		{
+			return event.kind == CfgEvent::Statement;
+		});
+
+		if (first == events.end())
+		{
+			continue;
+		}
+
+		Report(first->node->range, FlowUnreachableCode, NULL);
+
+		covered[b] = true;
+		stack.push_back(b);
+
+		while (!stack.empty())
+		{
+			auto block = stack.back();
+			stack.pop_back();
+
+			for (auto succ : cfg.blocks[block].succs)
+			{
+				if (!reachable[succ] && !covered[succ])
+				{
+					covered[succ] = true;
+					stack.push_back(succ);
+				}
+			}
+		}
+	}
+}
+
+// A store is dead when no path from it reaches a read before the next store,
+// which is plain backward liveness. Locals nested functions can see and
+// locals that are never read at all (already reported as unused) are left
+// out, so are initializers folding to a constant since `var x = 0;` is the
+// usual way to declare a variable that gets its real value later.
+void FlowChecker::CheckDeadStores(const Cfg &cfg, const vector<bool> &read, const vector<bool> &reachable)
+{
+	DataflowProblem problem;
+	problem.direction = DataflowProblem::Backward;
+	problem.meet = DataflowProblem::Union;
+	problem.boundary = false;
+	problem.declare = DataflowProblem::Kill;
+	problem.read = DataflowProblem::Gen;
+	problem.write = DataflowProblem::Kill;
+	problem.tracked.assign(cfg.frame->frameSize, false);
+
+	auto any = false;
+
+	for (auto decl : m_locals[cfg.frame])
+	{
+		if (read[decl->slot] && !decl->captured && (decl->type == Decl::Variable || decl->type == Decl::Argument))
+		{
+			problem.tracked[decl->slot] = true;
+			any = true;
+		}
+	}
+
+	if (!any)
+	{
+		return;
+	}
+
+	SolveDataflow(cfg, problem, [&](int block, const CfgEvent &event, bool live)
+	{
+		if (event.kind != CfgEvent::Write || live || !reachable[block])
+		{
+			return;
+		}
+
+		// Arguments, foreach variables and functions are written without
+		// anything in the source that could be taken out.
+		if (dynamic_cast<ExprId *>(event.node))
+		{
+			Report(event.node->range, FlowDeadStore, m_names[event.decl]);
+		}
+		else if (dynamic_cast<StmtVarDecl *>(event.node) && !m_folder.Fold(event.decl->value.get()))
+		{
+			Report(event.decl->range, FlowDeadStore, m_names[event.decl]);
+		}
+	});
+}
+
+// Definite assignment: forward, with a slot counting as assigned only if it
+// is on every path. Declarations unassign, so a variable declared in a loop
+// starts over each time around, and before its declaration a slot counts as
+// assigned since nothing can read it there. Each variable is reported once,
+// at its first read that may find it unassigned. Variables without such a
+// read are marked initialized, unless a nested function could read them
+// before the first store.
+void FlowChecker::CheckAssignment(const Cfg &cfg, const vector<bool> &reachable)
+{
+	DataflowProblem problem;
+	problem.direction = DataflowProblem::Forward;
+	problem.meet = DataflowProblem::Intersection;
+	problem.boundary = true;
+	problem.declare = DataflowProblem::Kill;
+	problem.read = DataflowProblem::None;
+	problem.write = DataflowProblem::Gen;
+	problem.tracked.assign(cfg.frame->frameSize, false);
+
+	auto &locals = m_locals[cfg.frame];
+	auto any = false;
+
+	for (auto decl : locals)
+	{
+		if (decl->type == Decl::Variable)
+		{
+			problem.tracked[decl->slot] = true;
+			any = true;
+		}
+	}
+
+	if (!any)
+	{
+		return;
+	}
+
+	vector<const CfgEvent *> firstUnassigned(cfg.frame->frameSize, NULL);
+
+	SolveDataflow(cfg, problem, [&](int block, const CfgEvent &event, bool assigned)
+	{
+		if (event.kind != CfgEvent::Read || assigned || !reachable[block])
+		{
+			return;
+		}
+
+		auto &first = firstUnassigned[event.slot];
+		if (!first || ComesBefore(event.node->range.beg, first->node->range.beg))
+		{
+			first = &event;
+		}
+	});
+
+	for (auto decl : locals)
+	{
+		if (!problem.tracked[decl->slot])
+		{
+			continue;
+		}
+
+		auto first = firstUnassigned[decl->slot];
+		decl->initialized = !first && (!decl->captured || decl->value);
+
+		if (first)
+		{
+			Report(first->node->range, FlowUseBeforeAssign, m_names[decl]);
+		}
+	}
+}
+
+void FlowChecker::Report(Range range, DiagMessage message, const string *name)
+{
+	Finding finding = { range, message, name };
+	m_findings.push_back(finding);
+}
+
+void FlowChecker::Flush()
+{
+	std::stable_sort(m_findings.begin(), m_findings.end(), [](const Finding &a, const Finding &b)
+	{
+		return ComesBefore(a.range.beg, b.range.beg);
+	});
+
+	for (auto &finding : m_findings)
+	{
+		m_diag << finding.range << Warning << finding.message;
+
+		if (finding.name)
+		{
+			m_diag << *finding.name;
+		}
+
+		m_diag << DiagEnd;
+	}
+
+	m_findings.clear();
+}
@@ -0,0 +1,61 @@
+#ifndef MOND_FLOW_CHECKER_HPP
+#define MOND_FLOW_CHECKER_HPP
+
+#include "Cfg.hpp"
+
+namespace Mond
+{
+	// Warnings that can only be given once the whole file is resolved. All of
+	// them come out of a single walk over the scopes and one control-flow
+	// graph per frame, and are reported in source order.
+	class FlowChecker
+	{
+	public:
+		explicit FlowChecker(DiagBuilder &diag);
+
+		void Check(Stmt *file, Scope *root);
+
+		// For a file checked one top-level statement at a time. Functions are
+		// checked as soon as the statement holding them is, but the top level
+		// is only checked for unreachable code and unused declarations since
+		// the rest needs every statement at once.
+		void CheckTopLevel(Stmt *stmt, Scope *root);
+		void FinishTopLevel(Scope *root);
+
+		// For a file whose statements are kept apart, see CheckedFile. The
+		// functions in a statement are checked given the scopes checking it
+		// made, and the top level for the whole file on its own. Reported in
+		// source order, each with as much as Check would say.
+		void CheckStatement(const ScopePtrList &scopes);
+		void CheckRoot(Stmt *file, Scope *root);
+	private:
+		struct Finding
+		{
+			Range range;
+			DiagMessage message;
+			const string *name;
+		};
+
+		void CollectDecls(Scope *scope);
+		void CollectFrameDecls(Scope *scope);
+		void CheckFrame(const Cfg &cfg);
+		vector<bool> FindReads(const Cfg &cfg);
+		void CheckUnused(const Cfg &cfg, const vector<bool> &read);
+		void CheckUnreachable(const Cfg &cfg, const vector<bool> &reachable);
+		void CheckDeadStores(const Cfg &cfg, const vector<bool> &read, const vector<bool> &reachable);
+		void CheckAssignment(const Cfg &cfg, const vector<bool> &reachable);
+		void Report(Range range, DiagMessage message, const string *name);
+		void Flush();
+
+		DiagBuilder &m_diag;
+		ConstFolder m_folder;
+		vector<Finding> m_findings;
+		vector<bool> m_rootReads;
+		bool m_rootEnded;
+		bool m_rootDeadReported;
+		unordered_map<const Decl *, const string *> m_names;
+		unordered_map<const Scope *, vector<Decl *>> m_locals;
+	};
+}
+
+#endif
@@ -0,0 +1,64 @@
+#include <cstring>
+#include "Hash.hpp"
+
+using namespace Mond;
+
+static const uint64_t Prime1 = 0x9E3779B185EBCA87ULL;
+static const uint64_t Prime2 = 0xC2B2AE3D27D4EB4FULL;
+static const uint64_t Prime3 = 0x165667B19E3779F9ULL;
+
+static uint64_t Rotate(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t Mix(uint64_t h, uint64_t k)
+{
+	k *= Prime2;
+	k = Rotate(k, 31);
+	k *= Prime1;
+	return Rotate(h ^ k, 27) * Prime1 + Prime3;
+}
+
+static uint64_t Finalize(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= Prime2;
+	h ^= h >> 29;
+	h *= Prime3;
+	h ^= h >> 32;
+	return h;
+}
+
+uint64_t Mond::HashBytes(const void *data, size_t size, uint64_t seed)
+{
+	auto ptr = (const unsigned char *)data;
+	auto end = ptr + size;
+	uint64_t h = seed + Prime3 + (uint64_t)size;
+
+	while (end - ptr >= 8)
+	{
+		uint64_t k;
+		memcpy(&k, ptr, 8);
+		h = Mix(h, k);
+		ptr += 8;
+	}
+
+	uint64_t tail = 0;
+	for (int shift = 0; ptr < end; shift += 8)
+	{
+		tail |= (uint64_t)*ptr++ << shift;
+	}
+
+	return Finalize(Mix(h, tail));
+}
+
+uint64_t Mond::HashString(const string &s, uint64_t seed)
+{
+	return HashBytes(s.data(), s.size(), seed);
+}
+
+uint64_t Mond::HashCombine(uint64_t a, uint64_t b)
+{
+	return Finalize(Mix(a, b));
+}
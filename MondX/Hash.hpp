@@ -0,0 +1,16 @@
+#ifndef MOND_HASH_HPP
+#define MOND_HASH_HPP
+
+#include "Util.hpp"
+
+namespace Mond
+{
+	// A fast, non-cryptographic 64-bit hash. It reads its input in 8 byte
+	// words, so hashes are only stable between machines of the same byte
+	// order.
+	uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 0);
+	uint64_t HashString(const string &s, uint64_t seed = 0);
+	uint64_t HashCombine(uint64_t a, uint64_t b);
+}
+
+#endif
@@ -6,15 +6,537 @@ using namespace Mond;
 Lexer::Lexer(DiagBuilder &diag, Source &source) :
 	m_pos(1, 1),
 	m_source(source),
-	m_diag(diag)
+	m_diag(diag),
+	m_completion(-1),
+	m_completed(false),
+	m_skip(0),
+	m_log(NULL)
 {
 	m_char = m_source.Cur();
 	m_peek = m_source.Peek();
 }
 
+void Lexer::SetCancelToken(const CancelToken &token)
+{
+	m_cancel = token;
+}
+
+void Lexer::SetCompletion(SourceInt offset)
+{
+	m_completion = offset;
+}
+
+void Lexer::SetSkips(const vector<Slice> &skip)
+{
+	m_skips = skip;
+	m_skip = 0;
+}
+
+// ClassIdentifier for a name in text, without making a string of it and
+// hashing that, which would be most of what following the top level takes.
+// The keywords are bucketed by their first character instead.
+static TokenType classifyName(const string &text, Slice name)
+{
+	struct Keyword
+	{
+		string text;
+		TokenType type;
+	};
+
+	struct Keywords
+	{
+		Keywords()
+		{
+			#define MOND_KEYWORD(n, s) buckets[(unsigned char)s[0]].push_back(Keyword { s, Kw##n });
+			#include "Tokens.inc"
+			#undef MOND_KEYWORD
+		}
+
+		vector<Keyword> buckets[256];
+	};
+
+	static const Keywords keywords;
+
+	auto length = (size_t)(name.end - name.beg);
+	auto chars = text.data() + name.beg;
+
+	for (auto &keyword : keywords.buckets[(unsigned char)chars[0]])
+	{
+		if (keyword.text.size() == length && std::equal(chars, chars + length, keyword.text.begin()))
+		{
+			return keyword.type;
+		}
+	}
+
+	return TokIdentifier;
+}
+
+static bool isStatementKeyword(TokenType type)
+{
+	switch (type)
+	{
+	case KwVar:
+	case KwConst:
+	case KwIf:
+	case KwWhile:
+	case KwDo:
+	case KwFor:
+	case KwForeach:
+	case KwSwitch:
+	case KwReturn:
+	case KwBreak:
+	case KwContinue:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Keywords whose parentheses a statement follows.
+static bool takesBody(TokenType type)
+{
+	return type == KwIf || type == KwWhile || type == KwFor || type == KwForeach;
+}
+
+// Names an expression can end at.
+static bool endsExpr(TokenType type)
+{
+	return type == TokIdentifier || (type >= KwGlobal && type <= KwInfinity) || type == KwBreak || type == KwContinue;
+}
+
+// Characters an expression can start with, names aside, a number counts as
+// '0'.
+static bool startsExpr(char c)
+{
+	switch (c)
+	{
+	case '"':
+	case '\'':
+	case '0':
+	case '(':
+	case '[':
+	case '{':
+	case ';':
+	case '-':
+	case '+':
+	case '!':
+	case '~':
+		return true;
+	default:
+		return false;
+	}
+}
+
+vector<Slice> Mond::FindSkips(const string &text, SourceInt beg, SourceInt end, const function<void (Slice name, char prev, char prevPrev)> &onName, TopLevel *topLevel)
+{
+	auto size = (SourceInt)text.size();
+	vector<SourceInt> open;
+	vector<Slice> skips;
+	char prev = 0;
+	char prevPrev = 0;
+
+	// The top level is only followed while it's plain, past anything the
+	// parser would have to recover from its statements could start anywhere,
+	// so it's lost there and ends where it was.
+	//
+	// Nesting counts the parentheses and brackets at the top, braces are in
+	// open, head is the keyword before the outermost if it's a switch or
+	// takes a body, and statementBraces is whether the outermost braces are
+	// a statement's. Fun goes 1 to 4 through a function's keyword, name,
+	// arguments and what's after them, funNesting is where its arguments
+	// are. Word is the last name at the top, current the first of its
+	// statement, which declares names after its keyword, and after every
+	// comma of a var or const. Dos counts the do statements waiting for their
+	// while. The names before the statement the top level ends at are kept.
+	auto lost = !topLevel;
+	auto nesting = 0;
+	auto head = TokUnknown;
+	auto statementBraces = false;
+	auto word = TokUnknown;
+	auto current = TokUnknown;
+	auto keyword = TokUnknown;
+	auto expectName = false;
+	auto declaredWord = false;
+	auto fun = 0;
+	auto funNesting = 0;
+	auto funDecl = false;
+	auto dos = 0;
+	vector<pair<Slice, TokenType>> declared;
+	size_t kept = 0;
+	SourceInt line = 1;
+	SourceInt lineStart = 0;
+	SourceInt counted = 0;
+
+	if (topLevel)
+	{
+		topLevel->offset = 0;
+		topLevel->pos = Pos(1, 1);
+	}
+
+	auto begins = [&]()
+	{
+		return nesting == 0 && (prev == 0 || prev == ';' || (prev == '}' && statementBraces));
+	};
+
+	auto finished = [&]()
+	{
+		switch (prev)
+		{
+		case 'a':
+			return endsExpr(word);
+		case '0':
+		case '"':
+		case '\'':
+		case ']':
+			return true;
+		case '}':
+			return !statementBraces;
+		case ')':
+			return !takesBody(head);
+		default:
+			return false;
+		}
+	};
+
+	auto named = [&]()
+	{
+		return nesting == 0 && (expectName || (prev == ',' && (keyword == KwVar || keyword == KwConst)));
+	};
+
+	// Whether a token other than a name, starting with c, is one the parser
+	// could only take by recovering.
+	auto stray = [&](char c)
+	{
+		if (fun == 1 || fun == 2)
+		{
+			return c != '(';
+		}
+		else if (fun == 4)
+		{
+			return c != '{' && c != '-';
+		}
+		else if (named())
+		{
+			return true;
+		}
+		else if (prev == 'a' && declaredWord)
+		{
+			return c != '=' && c != ',' && c != ';';
+		}
+		else if (begins())
+		{
+			return dos > 0 || !startsExpr(c);
+		}
+		else if (nesting > 0)
+		{
+			return c == ';' && head != KwFor;
+		}
+		else if (prev == ')' && head == KwSwitch)
+		{
+			return c != '{';
+		}
+
+		return c == ')' || c == ']' || c == '}' || ((c == '"' || c == '\'' || c == '0' || c == '{') && finished());
+	};
+
+	// And whether a name is, type being what it is as a keyword.
+	auto strayName = [&](TokenType type)
+	{
+		if (fun == 1 || named())
+		{
+			return type != TokIdentifier;
+		}
+		else if (fun == 2 || fun == 4)
+		{
+			return true;
+		}
+		else if (begins())
+		{
+			return type == KwElse ? current != KwIf && current != KwElse : dos > 0 && type != KwWhile;
+		}
+		else if (nesting > 0)
+		{
+			return isStatementKeyword(type) && !((head == KwFor || head == KwForeach) && (type == KwVar || type == KwConst));
+		}
+
+		// Only a statement takes one of these keywords, unless it's a loop
+		// variable, and nothing goes on with a finished expression.
+		auto body = prev == ')' ? takesBody(head) : prev == 'a' && (word == KwElse || word == KwDo);
+		return finished() || (isStatementKeyword(type) && !body);
+	};
+
+	for (SourceInt i = 0; i < size;)
+	{
+		auto c = text[i];
+
+		if (!lost && i <= beg && open.empty() && (c == '"' || c == '\'' || IsDecDigit((unsigned char)c)))
+		{
+			lost = stray(c == '"' || c == '\'' ? c : '0');
+		}
+
+		if (c == '"' || c == '\'')
+		{
+			for (i++; i < size && text[i] != c; i++)
+			{
+				i += text[i] == '\\';
+			}
+
+			i++;
+			prev = c;
+			continue;
+		}
+		else if (c == '/' && i + 1 < size && text[i + 1] == '/')
+		{
+			while (i < size && text[i] != '\n' && text[i] != '\r')
+			{
+				i++;
+			}
+
+			continue;
+		}
+		else if (c == '/' && i + 1 < size && text[i + 1] == '*')
+		{
+			auto depth = 0;
+
+			do
+			{
+				if (text[i] == '/' && i + 1 < size && text[i + 1] == '*')
+				{
+					depth++;
+					i += 2;
+				}
+				else if (text[i] == '*' && i + 1 < size && text[i + 1] == '/')
+				{
+					depth--;
+					i += 2;
+				}
+				else
+				{
+					i++;
+				}
+			}
+			while (depth > 0 && i < size);
+
+			continue;
+		}
+		else if (IsDecDigit((unsigned char)c))
+		{
+			while (i < size && (IsNameChar(text[i]) || (text[i] == '.' && i + 1 < size && IsDecDigit((unsigned char)text[i + 1]))))
+			{
+				i++;
+			}
+
+			prev = '0';
+			continue;
+		}
+		else if (IsNameChar(c))
+		{
+			auto name = Slice(i, i);
+
+			while (i < size && IsNameChar(text[i]))
+			{
+				i++;
+			}
+
+			name.end = i;
+
+			if (onName)
+			{
+				onName(name, prev, prevPrev);
+			}
+
+			if (!lost && name.beg <= beg && open.empty())
+			{
+				auto type = classifyName(text, name);
+
+				if (strayName(type))
+				{
+					lost = true;
+				}
+				else if (begins())
+				{
+					if (type == KwWhile && dos > 0)
+					{
+						dos--;
+					}
+					else if (type != KwElse)
+					{
+						for (; counted < name.beg; counted++)
+						{
+							if (IsLineBreak(text, counted))
+							{
+								line++;
+								lineStart = counted + 1;
+							}
+						}
+
+						topLevel->offset = name.beg;
+						topLevel->pos = Pos(line, name.beg - lineStart + 1);
+						kept = declared.size();
+					}
+
+					current = type;
+					keyword = type == KwVar || type == KwConst || type == KwFun || type == KwSeq ? type : TokUnknown;
+					expectName = keyword != TokUnknown;
+					declaredWord = false;
+				}
+				else
+				{
+					declaredWord = named();
+
+					if (declaredWord)
+					{
+						declared.push_back(std::make_pair(name, keyword));
+					}
+
+					expectName = false;
+				}
+
+				if (type == KwFun || type == KwSeq)
+				{
+					fun = 1;
+					funDecl = begins();
+				}
+				else if (fun == 1)
+				{
+					fun = 2;
+				}
+
+				dos += type == KwDo && nesting == 0;
+				word = type;
+			}
+
+			prevPrev = prev;
+			prev = 'a';
+			continue;
+		}
+
+		if (!lost && i <= beg && open.empty() && c != ' ' && c != '\t' && c != '\r' && c != '\n')
+		{
+			lost = stray(c);
+
+			if (c == '{' && nesting == 0)
+			{
+				statementBraces = begins() || (prev == ')' && (head != TokUnknown || (fun == 4 && funDecl))) || (prev == 'a' && (word == KwElse || word == KwDo));
+			}
+			else if ((c == '(' || c == '[') && nesting == 0)
+			{
+				head = c == '(' && prev == 'a' && (takesBody(word) || word == KwSwitch) ? word : TokUnknown;
+			}
+			else if (c == ';' && nesting == 0)
+			{
+				keyword = TokUnknown;
+			}
+
+			if (fun == 1 || fun == 2)
+			{
+				fun = 3;
+				funNesting = nesting;
+			}
+			else if (fun == 4)
+			{
+				fun = 0;
+			}
+
+			if (c == '(' || c == '[')
+			{
+				nesting++;
+			}
+			else if ((c == ')' || c == ']') && nesting > 0)
+			{
+				nesting--;
+				fun = fun == 3 && nesting == funNesting ? 4 : fun;
+			}
+		}
+
+		if (c == '{')
+		{
+			open.push_back(i + 1);
+		}
+		else if (c == '}' && !open.empty())
+		{
+			auto block = Slice(open.back(), i);
+			open.pop_back();
+
+			// A block around the range stays, the ones in it that don't
+			// reach it are skipped instead.
+			if (block.end < beg || block.beg > end)
+			{
+				while (!skips.empty() && skips.back().beg > block.beg)
+				{
+					skips.pop_back();
+				}
+
+				skips.push_back(block);
+			}
+		}
+
+		if (c != ' ' && c != '\t' && c != '\r' && c != '\n')
+		{
+			prevPrev = prev;
+			prev = c;
+		}
+
+		i++;
+	}
+
+	if (topLevel)
+	{
+		topLevel->names.clear();
+		topLevel->names.reserve(kept);
+
+		for (size_t j = 0; j < kept; j++)
+		{
+			auto &name = declared[j].first;
+			topLevel->names.push_back(std::make_pair(text.substr(name.beg, name.end - name.beg), declared[j].second));
+		}
+	}
+
+	return skips;
+}
+
+void Lexer::SetTokenLog(vector<Token> *log)
+{
+	m_log = log;
+}
+
+void Lexer::SetPosition(SourceInt offset, Pos pos)
+{
+	m_source.Seek(offset);
+	m_pos = pos;
+	m_char = m_source.Cur();
+	m_peek = m_source.Peek();
+}
+
 Token &Lexer::GetToken()
 {
-	if (IsEof(m_char))
+	auto &token = Lex();
+
+	if (m_log)
+	{
+		switch (token.type)
+		{
+		case TokEndOfLine:
+		case TokWhiteSpace:
+		case TokLineComment:
+		case TokBlockComment:
+			break;
+		default:
+			m_log->push_back(token);
+			break;
+		}
+	}
+
+	return token;
+}
+
+Token &Lexer::Lex()
+{
+	if (m_completion >= 0 && m_source.Position() >= m_completion)
+	{
+		return MakeCompletion(m_source.Position() - m_completion);
+	}
+	else if (IsEof(m_char))
 	{
 		m_token.type = TokEndOfFile;
 		m_token.range = Range(m_pos, 0);
@@ -109,8 +631,47 @@ void Mond::Lexer::Advance()
 	m_pos.column++;
 }
 
+// Anything but whitespace that ran past the offset was a string, number or
+// comment, which don't get completions, so the file just ends.
+Token &Lexer::MakeCompletion(SourceInt overshoot)
+{
+	auto isCompletion = !m_completed && (overshoot == 0 || m_token.type == TokWhiteSpace);
+	m_completed = true;
+
+	m_token.type = isCompletion ? TokCompletion : TokEndOfFile;
+	m_token.range = Range(Pos(m_pos.line, m_pos.column - overshoot), 0);
+	m_token.slice = Slice(m_completion, m_completion);
+	return m_token;
+}
+
+// Only line breaks matter in what's skipped, so it's counted without going
+// through the source a character at a time.
+void Lexer::SkipTo(SourceInt position)
+{
+	auto skipped = m_source.GetSlice(Slice(m_source.Position(), position));
+
+	for (size_t i = 0; i < skipped.size(); i++)
+	{
+		if (skipped[i] == '\n' || (skipped[i] == '\r' && (i + 1 == skipped.size() || skipped[i + 1] != '\n')))
+		{
+			m_pos.line++;
+			m_pos.column = 1;
+		}
+		else
+		{
+			m_pos.column++;
+		}
+	}
+
+	m_source.Seek(position);
+	m_char = m_source.Cur();
+	m_peek = m_source.Peek();
+}
+
 Token &Lexer::MakeEndOfLine()
 {
+	m_cancel.Check();
+
 	m_token.type = TokEndOfLine;
 	m_token.range.beg = m_pos;
 	m_token.slice.beg = m_source.Position();
@@ -227,6 +788,16 @@ Token &Lexer::MakeIdentifier()
 	m_token.range.end = m_pos;
 	m_token.slice.end = m_source.Position();
 	m_token.type = ClassIdentifier(m_source.GetSlice(m_token.slice));
+
+	if (m_token.slice.beg < m_completion && m_completion <= m_token.slice.end && !m_completed)
+	{
+		auto cut = m_token.slice.end - m_completion;
+		m_token.type = TokCompletion;
+		m_token.range.end.column -= cut;
+		m_token.slice.end -= cut;
+		m_completed = true;
+	}
+
 	return m_token;
 }
 
@@ -358,6 +929,19 @@ Token &Lexer::MakePunctuation(TokenType type)
 	// Skip the punctuation character.
 	Advance();
 
+	if (type == TokLeftBrace && !m_skips.empty())
+	{
+		while (m_skip < m_skips.size() && m_skips[m_skip].beg < m_source.Position())
+		{
+			m_skip++;
+		}
+
+		if (m_skip < m_skips.size() && m_skips[m_skip].beg == m_source.Position())
+		{
+			SkipTo(m_skips[m_skip].end);
+		}
+	}
+
 	return m_token;
 }
 
@@ -3,6 +3,7 @@
 
 #include "Token.hpp"
 #include "Source.hpp"
+#include "CancelToken.hpp"
 #include "DiagBuilder.hpp"
 
 namespace Mond
@@ -13,9 +14,32 @@ namespace Mond
 		Lexer(DiagBuilder &diag, Source &source);
 
 		Token &GetToken();
+
+		// Checked at every line break.
+		void SetCancelToken(const CancelToken &token);
+
+		// Ends the file at offset with a TokCompletion. An identifier the
+		// offset is in or right after becomes the completion token, cut off
+		// at the offset.
+		void SetCompletion(SourceInt offset);
+
+		// Blocks in skip, sorted slices of what's between a pair of braces,
+		// are passed over as if they were empty.
+		void SetSkips(const vector<Slice> &skip);
+
+		// Appends every token handed out to log, except the whitespace, line
+		// breaks and comments the parser never looks at.
+		void SetTokenLog(vector<Token> *log);
+
+		// Starts at offset, which is at pos, instead of at the beginning of
+		// the source. Has to come before the parser takes its first token.
+		void SetPosition(SourceInt offset, Pos pos);
 	private:
+		Token &Lex();
 		void Advance();
+		void SkipTo(SourceInt position);
 
+		Token &MakeCompletion(SourceInt overshoot);
 		Token &MakeEndOfLine();
 		Token &MakeWhitespace();
 		Token &MakeLineComment();
@@ -34,8 +58,48 @@ namespace Mond
 		uint32_t m_peek;
 		Source &m_source;
 		DiagBuilder &m_diag;
+		CancelToken m_cancel;
+
+		SourceInt m_completion;
+		bool m_completed;
+		size_t m_skip;
+		vector<Slice> m_skips;
+		vector<Token> *m_log;
 	};
 
+	// The top level of a file up to some offset, as far as FindSkips can
+	// tell it apart. A statement is taken to start at a name outside of any
+	// brackets right after a semicolon or a statement's closing brace. Past
+	// anything the parser would have to recover from, a missing semicolon
+	// say, that can't be told, so the top level ends at the last statement
+	// before it.
+	struct TopLevel
+	{
+		// Where the last statement starting at or before the offset starts,
+		// parsing can start there instead of at the beginning of the text.
+		SourceInt offset;
+		Pos pos;
+
+		// The names the statements before it declare, in order, with the
+		// var, const, fun or seq declaring them.
+		vector<pair<string, TokenType>> names;
+	};
+
+	// Finds the outermost blocks in text that end before beg or start after
+	// end, sorted the way SetSkips wants them. Only strings and comments are
+	// stepped over on the way, this has to be far cheaper than lexing. Each
+	// name found goes to onName along with the two non-whitespace characters
+	// before it, a string counts as its quote and a number as '0'. The top
+	// level up to beg goes to topLevel if it's given.
+	vector<Slice> FindSkips(const string &text, SourceInt beg, SourceInt end, const function<void (Slice name, char prev, char prevPrev)> &onName = nullptr, TopLevel *topLevel = NULL);
+
+	// Whether text[i] ends a line the way the lexer counts them, a carriage
+	// return only does on its own.
+	inline bool IsLineBreak(const string &text, size_t i)
+	{
+		return text[i] == '\n' || (text[i] == '\r' && (i + 1 == text.size() || text[i + 1] != '\n'));
+	}
+
 	// -------------------------------------------------------------------
 	// TODO: Unicode.
 	// -------------------------------------------------------------------
@@ -77,6 +141,13 @@ namespace Mond
 		return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
 	}
 
+	// For scanning text without the lexer, no byte past ASCII is part of a
+	// name.
+	inline bool IsNameChar(char c)
+	{
+		return IsLetter((unsigned char)c) || IsDecDigit((unsigned char)c) || c == '_';
+	}
+
 	inline bool IsWhitespace(uint32_t c)
 	{
 		return (c == ' ' || c == '\t');
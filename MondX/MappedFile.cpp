@@ -0,0 +1,89 @@
+#include "MappedFile.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+using namespace Mond;
+
+MappedFile::MappedFile(const string &filename) :
+	m_valid(false),
+	m_mapped(false),
+	m_size(0),
+	m_data(NULL)
+{
+#ifndef _WIN32
+	auto fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) == 0)
+	{
+		m_size = info.st_size;
+		m_valid = true;
+
+		if (m_size > 0)
+		{
+			auto addr = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (addr != MAP_FAILED)
+			{
+				m_data = (const char *)addr;
+				m_mapped = true;
+			}
+			else
+			{
+				m_valid = false;
+			}
+		}
+	}
+
+	close(fd);
+#else
+	ifstream file(filename, std::ios::binary);
+	if (!file)
+	{
+		return;
+	}
+
+	m_contents = string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	m_size = m_contents.size();
+	m_data = m_contents.data();
+	m_valid = true;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+	if (m_mapped)
+	{
+		munmap((void *)m_data, m_size);
+	}
+#endif
+}
+
+bool MappedFile::IsValid() const
+{
+	return m_valid;
+}
+
+bool MappedFile::IsMapped() const
+{
+	return m_mapped;
+}
+
+const char *MappedFile::Data() const
+{
+	return m_data;
+}
+
+size_t MappedFile::Size() const
+{
+	return m_size;
+}
@@ -0,0 +1,33 @@
+#ifndef MOND_MAPPED_FILE_HPP
+#define MOND_MAPPED_FILE_HPP
+
+#include "Util.hpp"
+
+namespace Mond
+{
+	// Read-only view of a whole file. Memory mapped where the platform
+	// allows it, read into memory otherwise.
+	class MappedFile
+	{
+	public:
+		MappedFile(const string &filename);
+		~MappedFile();
+
+		bool IsValid() const;
+		bool IsMapped() const;
+
+		const char *Data() const;
+		size_t Size() const;
+	private:
+		MappedFile(const MappedFile &);
+		MappedFile &operator=(const MappedFile &);
+
+		bool m_valid;
+		bool m_mapped;
+		size_t m_size;
+		const char *m_data;
+		string m_contents;
+	};
+}
+
+#endif
@@ -0,0 +1,250 @@
+#include <algorithm>
+#include "NodeIndex.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// Every node under a statement, each before its children.
+class NodeCollector : public Visitor
+{
+public:
+	using Visitor::Visit;
+
+	void Visit(AstNode *node)
+	{
+		nodes.push_back(node);
+	}
+
+	vector<AstNode *> nodes;
+};
+
+static void mapScopes(Scope *scope, unordered_map<AstNode *, Scope *> &scopes)
+{
+	// Children come later, so a node with several scopes gets the innermost.
+	if (scope->node)
+	{
+		scopes[scope->node.get()] = scope;
+	}
+
+	for (auto &child : scope->children)
+	{
+		mapScopes(child.get(), scopes);
+	}
+}
+
+static Pos shifted(Pos pos, SourceInt lines)
+{
+	return Pos(pos.line + lines, pos.column);
+}
+
+// ---------------------------------------------------------------------------
+// NodeIndex
+// ---------------------------------------------------------------------------
+
+NodeIndex::NodeIndex() : m_root(NULL)
+{
+}
+
+NodeIndex::NodeIndex(StmtPtr file, Scope *rootScope) : m_root(rootScope)
+{
+	auto block = dynamic_cast<StmtBlock *>(file.get());
+	if (!block)
+	{
+		throw invalid_argument("node index expects a file block");
+	}
+
+	unordered_map<AstNode *, Scope *> scopes;
+
+	if (rootScope)
+	{
+		for (auto &child : rootScope->children)
+		{
+			mapScopes(child.get(), scopes);
+		}
+	}
+
+	auto after = Pos(1, 1);
+
+	for (auto &stmt : block->statements)
+	{
+		m_chunks.push_back(MakeChunk(stmt.get(), scopes, after));
+		after = m_chunks.back().end;
+	}
+}
+
+AstNode *NodeIndex::NodeAt(Pos pos) const
+{
+	auto segment = Find(pos);
+	return segment ? segment->node : NULL;
+}
+
+Scope *NodeIndex::ScopeAt(Pos pos) const
+{
+	auto segment = Find(pos);
+	return segment ? segment->scope : m_root;
+}
+
+size_t NodeIndex::StatementCount() const
+{
+	return m_chunks.size();
+}
+
+void NodeIndex::Replace(size_t first, size_t count, const StmtPtrList &statements, const ScopePtrList &scopes, SourceInt lineDelta)
+{
+	if (first + count > m_chunks.size())
+	{
+		throw invalid_argument("replacing statements past the end of the index");
+	}
+
+	unordered_map<AstNode *, Scope *> scopeMap;
+
+	for (auto &scope : scopes)
+	{
+		mapScopes(scope.get(), scopeMap);
+	}
+
+	auto after = first > 0 ? shifted(m_chunks[first - 1].end, m_chunks[first - 1].shift) : Pos(1, 1);
+	vector<Chunk> chunks;
+
+	for (auto &stmt : statements)
+	{
+		chunks.push_back(MakeChunk(stmt.get(), scopeMap, after));
+		after = chunks.back().end;
+	}
+
+	for (auto i = first + count; i < m_chunks.size(); i++)
+	{
+		m_chunks[i].shift += lineDelta;
+	}
+
+	// Empty statements right after sit where the new ones end now.
+	for (auto i = first + count; i < m_chunks.size() && m_chunks[i].segments.empty(); i++)
+	{
+		m_chunks[i].beg = m_chunks[i].end = shifted(after, -m_chunks[i].shift);
+	}
+
+	m_chunks.erase(m_chunks.begin() + first, m_chunks.begin() + first + count);
+	m_chunks.insert(m_chunks.begin() + first, chunks.begin(), chunks.end());
+}
+
+// Goes through the nodes keeping a stack of the ones still open, a segment
+// starts wherever a node does and wherever one ends. Nodes are clipped to
+// their parents, so a sloppy range can't make the segments overlap.
+auto NodeIndex::MakeChunk(Stmt *stmt, const unordered_map<AstNode *, Scope *> &scopes, Pos after) const -> Chunk
+{
+	struct Open
+	{
+		AstNode *node;
+		Scope *scope;
+		Pos end;
+	};
+
+	Chunk chunk;
+	chunk.shift = 0;
+
+	NodeCollector collector;
+	AcceptChild(&collector, stmt);
+
+	vector<Open> open;
+	auto &segments = chunk.segments;
+
+	auto emit = [&](Pos beg, AstNode *node, Scope *scope)
+	{
+		if (!segments.empty() && !(segments.back().beg < beg))
+		{
+			segments.back().node = node;
+			segments.back().scope = scope;
+			return;
+		}
+
+		Segment segment = { beg, node, scope };
+		segments.push_back(segment);
+	};
+
+	auto pop = [&]()
+	{
+		auto end = open.back().end;
+		open.pop_back();
+		emit(end, open.empty() ? NULL : open.back().node, open.empty() ? m_root : open.back().scope);
+	};
+
+	for (auto node : collector.nodes)
+	{
+		if (!node->range.IsValid())
+		{
+			continue;
+		}
+
+		auto beg = node->range.beg;
+		auto end = node->range.end;
+
+		if (!segments.empty() && beg < segments.back().beg)
+		{
+			beg = segments.back().beg;
+		}
+
+		while (!open.empty() && !(beg < open.back().end))
+		{
+			pop();
+		}
+
+		if (!open.empty() && open.back().end < end)
+		{
+			end = open.back().end;
+		}
+
+		if (!(beg < end))
+		{
+			continue;
+		}
+
+		auto it = scopes.find(node);
+		auto scope = it != scopes.end() ? it->second : open.empty() ? m_root : open.back().scope;
+
+		Open entry = { node, scope, end };
+		open.push_back(entry);
+		emit(beg, node, scope);
+	}
+
+	while (!open.empty())
+	{
+		pop();
+	}
+
+	// An empty statement takes no room, it sits where the last one ended.
+	chunk.beg = segments.empty() ? after : segments.front().beg;
+	chunk.end = segments.empty() ? after : segments.back().beg;
+	return chunk;
+}
+
+auto NodeIndex::Find(Pos pos) const -> const Segment *
+{
+	auto chunk = std::upper_bound(m_chunks.begin(), m_chunks.end(), pos, [](Pos p, const Chunk &c)
+	{
+		return p < shifted(c.beg, c.shift);
+	});
+
+	if (chunk == m_chunks.begin())
+	{
+		return NULL;
+	}
+
+	--chunk;
+
+	auto local = shifted(pos, -chunk->shift);
+
+	if (!(local < chunk->end))
+	{
+		return NULL;
+	}
+
+	auto segment = std::upper_bound(chunk->segments.begin(), chunk->segments.end(), local, [](Pos p, const Segment &s)
+	{
+		return p < s.beg;
+	});
+
+	return segment == chunk->segments.begin() ? NULL : &*--segment;
+}
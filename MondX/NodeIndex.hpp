@@ -0,0 +1,65 @@
+#ifndef MOND_NODE_INDEX_HPP
+#define MOND_NODE_INDEX_HPP
+
+#include "AST.hpp"
+#include "Sema.hpp"
+
+namespace Mond
+{
+	// Answers what's at a position without walking the tree. Each top-level
+	// statement is flattened into segments, each the stretch of source where
+	// one node is the innermost, so a lookup is a binary search for the
+	// statement and another in it.
+	class NodeIndex
+	{
+	public:
+		NodeIndex();
+
+		// Indexes a parsed file, and with the root scope Sema checked it in,
+		// the scopes of its nodes. The tree and scopes must outlive the index.
+		NodeIndex(StmtPtr file, Scope *rootScope = NULL);
+
+		// The innermost node whose range holds pos, or NULL between
+		// statements.
+		AstNode *NodeAt(Pos pos) const;
+
+		// The innermost scope at pos, the root scope outside of any other.
+		Scope *ScopeAt(Pos pos) const;
+
+		size_t StatementCount() const;
+
+		// Swaps count top-level statements from first on for others, parsed
+		// at their new positions, along with the scopes checking them made.
+		// Statements after them move lineDelta lines, which is all the work
+		// they take, only the new statements are walked. Only whole lines
+		// move, so a statement sharing a line with the edit has to be among
+		// those replaced, its columns may have changed.
+		void Replace(size_t first, size_t count, const StmtPtrList &statements, const ScopePtrList &scopes, SourceInt lineDelta);
+	private:
+		struct Segment
+		{
+			Pos beg;
+			AstNode *node;
+			Scope *scope;
+		};
+
+		// Positions in a chunk are where they were when it was indexed, shift
+		// is how many lines the statement has moved since.
+		struct Chunk
+		{
+			Pos beg;
+			Pos end;
+			SourceInt shift;
+			vector<Segment> segments;
+		};
+
+		// An empty statement gets an empty chunk at after.
+		Chunk MakeChunk(Stmt *stmt, const unordered_map<AstNode *, Scope *> &scopes, Pos after) const;
+		const Segment *Find(Pos pos) const;
+
+		Scope *m_root;
+		vector<Chunk> m_chunks;
+	};
+}
+
+#endif
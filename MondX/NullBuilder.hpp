@@ -0,0 +1,92 @@
+#ifndef MOND_NULL_BUILDER_HPP
+#define MOND_NULL_BUILDER_HPP
+
+#include "Token.hpp"
+#include "Source.hpp"
+
+namespace Mond
+{
+	// Tree policy for BasicParser that builds nothing. Every production is a
+	// bool and every list drops what's pushed onto it, so parsing allocates
+	// no nodes and never copies a string out of the source. Ranges aren't
+	// tracked either, the fallbacks are only used to build nodes anyway.
+	class NullBuilder
+	{
+	public:
+		struct List
+		{
+			void push_back(bool) {}
+		};
+
+		typedef bool ExprRef;
+		typedef bool StmtRef;
+		typedef bool NameRef;
+		typedef bool EntryRef;
+		typedef bool CaseRef;
+
+		typedef List ExprList;
+		typedef List StmtList;
+		typedef List NameList;
+		typedef List EntryList;
+		typedef List CaseList;
+
+		explicit NullBuilder(Source &) {}
+
+		// -------------------------------------------------------------------
+		// Ranges
+		// -------------------------------------------------------------------
+
+		Pos Beg(bool, Pos fallback) const { return fallback; }
+		Pos End(bool, Pos fallback) const { return fallback; }
+
+		// -------------------------------------------------------------------
+		// Expressions
+		// -------------------------------------------------------------------
+
+		bool Id(const Token &) { return true; }
+		bool StringLiteral(const Token &) { return true; }
+		bool NumberLiteral(const Token &) { return true; }
+		bool SimpleLiteral(const Token &) { return true; }
+
+		bool Parens(bool expr, Range) { return expr; }
+		bool ObjectLiteral(Pos, Range, List &) { return true; }
+		bool ArrayLiteral(Pos, Range, List &) { return true; }
+
+		bool Yield(Pos, Range, bool) { return true; }
+
+		bool Call(Pos, Range, bool, List &) { return true; }
+		bool IndexAccess(Pos, Range, bool, bool) { return true; }
+		bool FieldAccess(Pos, Range, bool, const Token &) { return true; }
+
+		bool UnaryOp(Pos, Range, TokenType, bool, bool) { return true; }
+		bool BinaryOp(Pos, Range, TokenType, bool, bool) { return true; }
+		bool TernaryOp(Pos, Range, bool, bool, bool) { return true; }
+
+		bool Lambda(Pos, Range, bool, bool, List &, bool) { return true; }
+		bool ArraySlice(Pos, Range, bool, bool, bool, bool) { return true; }
+
+		bool Name(const Token &) { return true; }
+		bool Entry(const Token &, bool) { return true; }
+
+		// -------------------------------------------------------------------
+		// Statements
+		// -------------------------------------------------------------------
+
+		bool Block(Pos, Range, List &) { return true; }
+		bool Control(Pos, Range, TokenType) { return true; }
+		bool DoWhile(Pos, Range, bool, bool) { return true; }
+		bool For(Pos, Range, bool, bool, List &, bool) { return true; }
+		bool Foreach(Pos, Range, bool, bool, bool) { return true; }
+		bool FunDecl(Pos, Range, bool, bool, bool, List &, bool) { return true; }
+		bool IfElse(Pos, Range, bool, bool, bool) { return true; }
+		bool Return(Pos, Range, bool) { return true; }
+		bool VarDecl(Pos, Range, TokenType, List &, List &) { return true; }
+		bool Switch(Pos, Range, bool, List &) { return true; }
+		bool While(Pos, Range, bool, bool) { return true; }
+
+		bool NakedExpr(Pos, Range, bool) { return true; }
+		bool Case(bool, Range, bool, List &) { return true; }
+	};
+}
+
+#endif
@@ -6,45 +6,123 @@ using namespace Mond;
 // Parser interface
 // ---------------------------------------------------------------------------
 
-Parser::Parser(DiagBuilder &diag, Source &source, Lexer &lexer, Sema &sema) :
-	m_sema(sema),
+template<class Tree>
+BasicParser<Tree>::BasicParser(DiagBuilder &diag, Source &source, Lexer &lexer) :
+	m_tree(source),
 	m_lexer(lexer),
-	m_source(source),
-	m_diag(diag)
+	m_diag(diag),
+	m_completion()
 {
 	Advance();
 }
 
-StmtPtr Parser::ParseFile()
+template<class Tree>
+auto BasicParser<Tree>::ParseFile() -> StmtRef
 {
-	auto stmt = new StmtBlock;
-	stmt->pos = m_token.range.beg;
-	stmt->range.beg = m_token.range.beg;
+	auto pos = m_token.range.beg;
+	StmtList statements;
+
+	while (m_token.type != TokEndOfFile)
+	{
+		statements.push_back(ParseStmt());
+	}
 
+	return m_tree.Block(pos, Range(pos, m_token.range.beg), statements);
+}
+
+template<class Tree>
+void BasicParser<Tree>::ParseFile(const function<void (StmtRef)> &callback)
+{
 	while (m_token.type != TokEndOfFile)
 	{
-		stmt->statements.push_back(ParseStmt());
+		auto stmt = ParseStmt();
+
+		if (stmt)
+		{
+			callback(stmt);
+		}
 	}
+}
+
+template<class Tree>
+auto BasicParser<Tree>::ParseExpr() -> ExprRef
+{
+	return ParseExprCore(Precedence::Invalid);
+}
+
+template<class Tree>
+auto BasicParser<Tree>::ParseStmt() -> StmtRef
+{
+	m_cancel.Check();
+	return ParseStmtCore();
+}
+
+template<class Tree>
+void BasicParser<Tree>::SetCancelToken(const CancelToken &token)
+{
+	m_cancel = token;
+}
+
+template<class Tree>
+auto BasicParser<Tree>::CompletionExpr() const -> ExprRef
+{
+	return m_completion;
+}
+
+template<class Tree>
+const Token &BasicParser<Tree>::CurrentToken() const
+{
+	return m_token;
+}
 
-	stmt->range.end = m_token.range.beg;
-	return StmtPtr(stmt);
+Parser::Parser(DiagBuilder &diag, Source &source, Lexer &lexer) :
+	BasicParser<AstBuilder>(diag, source, lexer),
+	m_sema(NULL)
+{
 }
 
-ExprPtr Parser::ParseExpr()
+Parser::Parser(DiagBuilder &diag, Source &source, Lexer &lexer, Sema &sema) :
+	BasicParser<AstBuilder>(diag, source, lexer),
+	m_sema(&sema)
 {
-	return ExprPtr(ParseExprCore(Precedence::Invalid));
 }
 
-StmtPtr Parser::ParseStmt()
+StmtPtr Parser::ParseFile()
 {
-	return StmtPtr(ParseStmtCore());
+	auto file = BasicParser<AstBuilder>::ParseFile();
+
+	if (m_sema)
+	{
+		m_sema->Check(file);
+	}
+
+	return file;
+}
+
+void Parser::ParseFile(const function<void (StmtPtr)> &callback)
+{
+	BasicParser<AstBuilder>::ParseFile([&](StmtPtr stmt)
+	{
+		if (m_sema)
+		{
+			m_sema->CheckTopLevel(stmt);
+		}
+
+		callback(stmt);
+	});
+
+	if (m_sema)
+	{
+		m_sema->FinishTopLevel();
+	}
 }
 
 // ---------------------------------------------------------------------------
 // Core parser methods
 // ---------------------------------------------------------------------------
 
-void Parser::More()
+template<class Tree>
+void BasicParser<Tree>::More()
 {
 	while (true)
 	{
@@ -54,7 +132,6 @@ void Parser::More()
 		{
 		case TokEndOfLine:
 		case TokUnknown:
-		case TokCompletion:
 		case TokWhiteSpace:
 		case TokLineComment:
 		case TokBlockComment:
@@ -66,7 +143,8 @@ void Parser::More()
 	}
 }
 
-void Parser::Advance()
+template<class Tree>
+void BasicParser<Tree>::Advance()
 {
 	if (m_lookahead.empty())
 	{
@@ -77,14 +155,16 @@ void Parser::Advance()
 	m_lookahead.pop_front();
 }
 
-Token Parser::EatToken()
+template<class Tree>
+Token BasicParser<Tree>::EatToken()
 {
 	auto current = m_token;
 	Advance();
 	return current;
 }
 
-Token Parser::EatToken(TokenType type)
+template<class Tree>
+Token BasicParser<Tree>::EatToken(TokenType type)
 {
 	auto current = m_token;
 	if (current.type == type)
@@ -93,10 +173,19 @@ Token Parser::EatToken(TokenType type)
 		return current;
 	}
 
+	// A completion where a new name goes gets nothing, and mustn't be taken
+	// for an expression after it.
+	if (current.type == TokCompletion && type == TokIdentifier)
+	{
+		Advance();
+		return CreateMissing(type, false);
+	}
+
 	return CreateMissing(type, true);
 }
 
-Token Parser::Lookahead(int n)
+template<class Tree>
+Token BasicParser<Tree>::Lookahead(int n)
 {
 	while (n + 1 > (int)m_lookahead.size())
 	{
@@ -106,7 +195,8 @@ Token Parser::Lookahead(int n)
 	return m_lookahead[n];
 }
 
-Token Parser::CreateMissing(TokenType type, bool error)
+template<class Tree>
+Token BasicParser<Tree>::CreateMissing(TokenType type, bool error)
 {
 	if (error)
 	{
@@ -125,32 +215,17 @@ Token Parser::CreateMissing(TokenType type, bool error)
 	return newToken;
 }
 
-string Parser::IdString(Slice s)
-{
-	return m_source.GetSlice(s);
-}
-
-string Parser::LiteralString(Slice s)
-{
-	// TODO: Implement.
-	return m_source.GetSlice(s);
-}
-
-double Parser::LiteralNumber(Slice s)
-{
-	// TODO: Yeah uh, this ain't gonna work. Handle 0x 0b and underscores.
-	return strtod(m_source.GetSlice(s).c_str(), NULL);
-}
-
 // ---------------------------------------------------------------------------
 // Expressions
 // ---------------------------------------------------------------------------
 
-bool Parser::CanBeExpr()
+template<class Tree>
+bool BasicParser<Tree>::CanBeExpr()
 {
 	switch (m_token.type)
 	{
 	case TokIdentifier:
+	case TokCompletion:
 	case TokStringLiteral:
 	case TokNumberLiteral:
 	case KwGlobal:
@@ -173,15 +248,19 @@ bool Parser::CanBeExpr()
 }
 
 // TODO: Associativity.
-ExprPtr Parser::ParseExprCore(Precedence p)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprCore(Precedence p) -> ExprRef
 {
-	ExprPtr left;
+	ExprRef left;
 
 	switch (m_token.type)
 	{
 	case TokIdentifier:
 		left = ParseExprId();
 		break;
+	case TokCompletion:
+		left = m_completion = m_tree.Id(EatToken());
+		break;
 	case TokStringLiteral:
 		left = ParseExprStringLiteral();
 		break;
@@ -221,7 +300,7 @@ ExprPtr Parser::ParseExprCore(Precedence p)
 				<< Error
 				<< ParseExpectedExpr
 				<< DiagEnd;
-			return NULL;
+			return ExprRef();
 		}
 		left = ParseExprPrefixOp();
 		break;
@@ -268,60 +347,37 @@ ExprPtr Parser::ParseExprCore(Precedence p)
 	throw logic_error("unreachable in ParseExprCore");
 }
 
-ExprPtr Parser::ParseExprId()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprId() -> ExprRef
 {
 	if (Lookahead().type == OpPointy)
 	{
 		return ParseExprLambda();
 	}
 
-	auto expr = new ExprId;
-	expr->pos = m_token.range.beg;
-	expr->name = IdString(m_token.slice);
-	expr->range = m_token.range;
-	EatToken();
-
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	return m_tree.Id(EatToken());
 }
 
-ExprPtr Parser::ParseExprStringLiteral()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprStringLiteral() -> ExprRef
 {
-	auto expr = new ExprStringLiteral;
-	expr->pos = m_token.range.beg;
-	expr->range = m_token.range;
-	expr->contents = LiteralString(m_token.slice);
-	EatToken();
-
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	return m_tree.StringLiteral(EatToken());
 }
 
-ExprPtr Parser::ParseExprNumberLiteral()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprNumberLiteral() -> ExprRef
 {
-	auto expr = new ExprNumberLiteral;
-	expr->pos = m_token.range.beg;
-	expr->range = m_token.range;
-	expr->value = LiteralNumber(m_token.slice);
-	EatToken();
-
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	return m_tree.NumberLiteral(EatToken());
 }
 
-ExprPtr Parser::ParseExprSimpleLiteral()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprSimpleLiteral() -> ExprRef
 {
-	auto expr = new ExprSimpleLiteral;
-	expr->pos = m_token.range.beg;
-	expr->type = m_token.type;
-	expr->range = m_token.range;
-	EatToken();
-
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	return m_tree.SimpleLiteral(EatToken());
 }
 
-ExprPtr Parser::ParseExprParens()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprParens() -> ExprRef
 {
 	if (Lookahead().type == TokIdentifier)
 	{
@@ -339,37 +395,31 @@ ExprPtr Parser::ParseExprParens()
 	auto expr = ParseExprCore(Precedence::Invalid);
 	auto end = EatToken(TokRightParen);
 
-	if (expr)
-	{
-		expr->range.beg = beg.range.beg;
-		expr->range.end = end.range.end;
-		expr->Accept(&m_sema);
-	}
-
-	return ExprPtr(expr);
+	return m_tree.Parens(expr, Range(beg.range.beg, end.range.end));
 }
 
-ExprPtr Parser::ParseExprObjectLiteral()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprObjectLiteral() -> ExprRef
 {
-	auto expr = new ExprObjectLiteral;
-	expr->pos = m_token.range.beg;
-	expr->range = m_token.range;
+	auto pos = m_token.range.beg;
+	EntryList entries;
 
 	EatToken();
 
 	while (m_token.type != TokRightBrace)
 	{
-		auto entry = ExprObjectLiteral::KeyValue();
+		Token key;
+		ExprRef value;
 		bool wantsExpr = false;
 
 		if (m_token.type == TokIdentifier)
 		{
-			entry.key = IdString(EatToken().slice);
+			key = EatToken();
 			wantsExpr = m_token.type == TokColon;
 		}
 		else if (m_token.type == TokStringLiteral)
 		{
-			entry.key = LiteralString(EatToken().slice);
+			key = EatToken();
 			wantsExpr = true;
 		}
 		else
@@ -401,11 +451,11 @@ ExprPtr Parser::ParseExprObjectLiteral()
 			}
 			else
 			{
-				entry.value = ParseExpr();
+				value = ParseExpr();
 			}
 		}
 
-		expr->entries.push_back(entry);
+		entries.push_back(m_tree.Entry(key, value));
 
 		if (m_token.type == TokComma)
 		{
@@ -422,22 +472,21 @@ ExprPtr Parser::ParseExprObjectLiteral()
 		}
 	}
 
-	expr->range.end = ParseTerminator(TokRightBrace, expr->pos, ParseUnterminatedObjectLiteral);
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	auto end = ParseTerminator(TokRightBrace, pos, ParseUnterminatedObjectLiteral);
+	return m_tree.ObjectLiteral(pos, Range(pos, end), entries);
 }
 
-ExprPtr Parser::ParseExprArrayLiteral()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprArrayLiteral() -> ExprRef
 {
-	auto expr = new ExprArrayLiteral;
-	expr->pos = m_token.range.beg;
-	expr->range = m_token.range;
+	auto pos = m_token.range.beg;
+	ExprList elems;
 
 	EatToken();
 
 	while (m_token.type != TokRightBracket)
 	{
-		expr->elems.push_back(ParseExpr());
+		elems.push_back(ParseExpr());
 
 		if (m_token.type != TokComma)
 		{
@@ -447,42 +496,30 @@ ExprPtr Parser::ParseExprArrayLiteral()
 		EatToken();
 	}
 
-	expr->range.end = ParseTerminator(TokRightBracket, expr->pos, ParseUnterminatedArrayLiteral);
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	auto end = ParseTerminator(TokRightBracket, pos, ParseUnterminatedArrayLiteral);
+	return m_tree.ArrayLiteral(pos, Range(pos, end), elems);
 }
 
-ExprPtr Parser::ParseExprYield()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprYield() -> ExprRef
 {
-	auto expr = new ExprYield;
-	expr->pos = m_token.range.beg;
-	expr->range = m_token.range;
-	EatToken();
+	auto range = EatToken().range;
+	ExprRef value;
 
 	if (CanBeExpr())
 	{
-		expr->value = ParseExpr();
-
-		if (expr->value)
-		{
-			expr->range.end = expr->value->range.end;
-		}
-		else
-		{
-			expr->range.end = m_token.range.beg;
-		}
+		value = ParseExpr();
+		range.end = m_tree.End(value, m_token.range.beg);
 	}
 
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	return m_tree.Yield(range.beg, range, value);
 }
 
-ExprPtr Parser::ParseExprCall(ExprPtr left)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprCall(ExprRef left) -> ExprRef
 {
-	auto expr = new ExprCall;
-	expr->pos = m_token.range.beg;
-	expr->left = left;
-	expr->range = left->range;
+	auto pos = m_token.range.beg;
+	ExprList args;
 
 	EatToken();
 
@@ -490,7 +527,7 @@ ExprPtr Parser::ParseExprCall(ExprPtr left)
 	{
 		while (true)
 		{
-			expr->args.push_back(ParseExpr());
+			args.push_back(ParseExpr());
 
 			if (m_token.type == TokComma)
 			{
@@ -503,283 +540,181 @@ ExprPtr Parser::ParseExprCall(ExprPtr left)
 		}
 	}
 
-	expr->range.end = ParseTerminator(TokRightParen, expr->pos, ParseUnterminatedFunctionCall);
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	auto end = ParseTerminator(TokRightParen, pos, ParseUnterminatedFunctionCall);
+	return m_tree.Call(pos, Range(m_tree.Beg(left, pos), end), left, args);
 }
 
-ExprPtr Parser::ParseExprIndexAccess(ExprPtr left)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprIndexAccess(ExprRef left) -> ExprRef
 {
-	auto expr = new ExprIndexAccess;
-	expr->pos = m_token.range.beg;
-	expr->left = left;
-	expr->range = m_token.range;
+	auto pos = m_token.range.beg;
 
 	EatToken();
 
 	if (m_token.type == TokColon)
 	{
-		auto pos = expr->pos;
-		auto left = expr->left;
-		delete expr;
-		return ParseExprArraySlice(pos, left, NULL);
+		return ParseExprArraySlice(pos, left, ExprRef());
 	}
 
-	expr->index = ParseExpr();
+	auto index = ParseExpr();
 
 	if (m_token.type == TokColon)
 	{
-		auto pos = expr->pos;
-		auto left = expr->left;
-		auto index = expr->index;
-		delete expr;
 		return ParseExprArraySlice(pos, left, index);
 	}
 
-	if (expr->left)
-	{
-		expr->range.beg = expr->left->range.beg;
-	}
-
-	expr->range.end = EatToken(TokRightBracket).range.end;
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	auto end = EatToken(TokRightBracket).range.end;
+	return m_tree.IndexAccess(pos, Range(m_tree.Beg(left, pos), end), left, index);
 }
 
-ExprPtr Parser::ParseExprFieldAccess(ExprPtr left)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprFieldAccess(ExprRef left) -> ExprRef
 {
-	auto expr = new ExprFieldAccess;
-	expr->pos = m_token.range.beg;
-	expr->left = left;
-	expr->range = left->range;
+	auto pos = m_token.range.beg;
 
 	EatToken();
 
-	auto member = EatToken(TokIdentifier);
-	expr->name = IdString(member.slice);
-	expr->range.end = member.range.end;
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
-}
-
-ExprPtr Parser::ParseExprPrefixOp()
-{
-	auto expr = new ExprUnaryOp();
-	expr->pos = m_token.range.beg;
-	expr->type = m_token.type;
-	expr->post = false;
-	expr->range = m_token.range;
-
-	EatToken();
-
-	expr->value = ParseExpr();
-	if (expr->value)
+	if (m_token.type == TokCompletion)
 	{
-		expr->range.end = expr->value->range.end;
-	}
-	else
-	{
-		expr->range.end = m_token.range.beg;
+		auto member = EatToken();
+		return m_completion = m_tree.FieldAccess(pos, Range(m_tree.Beg(left, pos), member.range.end), left, member);
 	}
 
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	auto member = EatToken(TokIdentifier);
+	return m_tree.FieldAccess(pos, Range(m_tree.Beg(left, pos), member.range.end), left, member);
 }
 
-ExprPtr Parser::ParseExprPostfixOp(ExprPtr left)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprPrefixOp() -> ExprRef
 {
-	auto expr = new ExprUnaryOp;
-	expr->type = m_token.type;
-	expr->pos = m_token.range.beg;
-	expr->post = true;
-	expr->value = left;
-	expr->range = m_token.range;
+	auto op = EatToken();
+	auto value = ParseExpr();
+	auto end = m_tree.End(value, m_token.range.beg);
 
-	EatToken();
-
-	if (expr->value)
-	{
-		expr->range.beg = expr->value->range.beg;
-	}
-
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	return m_tree.UnaryOp(op.range.beg, Range(op.range.beg, end), op.type, false, value);
 }
 
-ExprPtr Parser::ParseExprBinaryOp(ExprPtr left, Precedence p)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprPostfixOp(ExprRef left) -> ExprRef
 {
-	auto expr = new ExprBinaryOp;
-	expr->pos = m_token.range.beg;
-	expr->type = m_token.type;
-	expr->left = left;
-
-	EatToken();
+	auto op = EatToken();
+	auto range = Range(m_tree.Beg(left, op.range.beg), op.range.end);
 
-	expr->right = ParseExprCore(p);
+	return m_tree.UnaryOp(op.range.beg, range, op.type, true, left);
+}
 
-	if (expr->right)
-	{
-		expr->range = Range(left->range.beg, expr->right->range.end);
-	}
-	else
-	{
-		expr->range = Range(left->range.beg, expr->pos);
-	}
+template<class Tree>
+auto BasicParser<Tree>::ParseExprBinaryOp(ExprRef left, Precedence p) -> ExprRef
+{
+	auto op = EatToken();
+	auto right = ParseExprCore(p);
+	auto pos = op.range.beg;
+	auto range = Range(m_tree.Beg(left, pos), m_tree.End(right, pos));
 
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	return m_tree.BinaryOp(pos, range, op.type, left, right);
 }
 
-ExprPtr Parser::ParseExprTernaryOp(ExprPtr left)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprTernaryOp(ExprRef left) -> ExprRef
 {
-	auto expr = new ExprTernaryOp;
-	expr->pos = m_token.range.beg;
-	expr->cond = left;
-	expr->range = m_token.range;
+	auto pos = m_token.range.beg;
 
 	EatToken();
-	expr->thenExpr = ParseExpr();
+	auto thenExpr = ParseExpr();
 	EatToken(TokColon);
-	expr->elseExpr = ParseExpr();
-
-	if (expr->cond)
-	{
-		expr->range.beg = expr->cond->range.beg;
-	}
-
-	if (expr->elseExpr)
-	{
-		expr->range.end = expr->elseExpr->range.end;
-	}
-	else
-	{
-		expr->range.end = m_token.range.beg;
-	}
+	auto elseExpr = ParseExpr();
 
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	auto range = Range(m_tree.Beg(left, pos), m_tree.End(elseExpr, m_token.range.beg));
+	return m_tree.TernaryOp(pos, range, left, thenExpr, elseExpr);
 }
 
-ExprPtr Parser::ParseExprLambda()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprLambda() -> ExprRef
 {
 	auto shortHand = m_token.type != KwFun && m_token.type != KwSeq;
-	auto scopeType = m_token.type == KwSeq ? Scope::Sequence : Scope::Function;
-
-	auto expr = new ExprLambda;
-	auto eptr = ExprPtr(expr);
-	expr->pos = m_token.range.beg;
-	expr->range = m_token.range;
-	expr->sequence = m_token.type == KwSeq;
-
-	SemaScope scope(m_sema, scopeType, eptr);
+	auto sequence = m_token.type == KwSeq;
+	auto pos = m_token.range.beg;
+	auto varargs = false;
+	NameList arguments;
+	StmtRef body;
 
 	if (m_token.type == KwFun || m_token.type == KwSeq)
 	{
-		expr->sequence = m_token.type == KwSeq;
-
 		EatToken();
-		ParseArgumentList(expr->varargs);
+		ParseArgumentList(arguments, varargs);
 
 		if (m_token.type != OpPointy)
 		{
-			expr->body = ParseStmtBlock();
-			if (expr->body)
-			{
-				expr->range.end = expr->body->range.end;
-			}
-			else
-			{
-				expr->range.end = m_token.range.beg;
-			}
+			body = ParseStmtBlock();
 
-			m_sema.Visit(expr);
-			return ExprPtr(expr);
+			auto range = Range(pos, m_tree.End(body, m_token.range.beg));
+			return m_tree.Lambda(pos, range, sequence, varargs, arguments, body);
 		}
 	}
 	else if (m_token.type == TokIdentifier)
 	{
-		auto arg = EatToken();
-		m_sema.Declare(Decl::Argument, arg.range, IdString(arg.slice), eptr);
+		arguments.push_back(m_tree.Name(EatToken()));
 	}
 	else
 	{
-		ParseArgumentList(expr->varargs);
+		ParseArgumentList(arguments, varargs);
 	}
 
-	expr->body = ParseStmtLambdaBody(shortHand);
-	if (expr->body)
-	{
-		expr->range.end = expr->body->range.end;
-	}
-	else
-	{
-		expr->range.end = m_token.range.beg;
-	}
+	body = ParseStmtLambdaBody(shortHand);
 
-	m_sema.Visit(expr);
-	return eptr;
+	auto range = Range(pos, m_tree.End(body, m_token.range.beg));
+	return m_tree.Lambda(pos, range, sequence, varargs, arguments, body);
 }
 
-ExprPtr Parser::ParseExprCondition()
+template<class Tree>
+auto BasicParser<Tree>::ParseExprCondition() -> ExprRef
 {
 	EatToken(TokLeftParen);
 	auto expr = ParseExprCore(Precedence::Invalid);
 	EatToken(TokRightParen);
 
-	if (expr)
-	{
-		expr->Accept(&m_sema);
-	}
-
-	return ExprPtr(expr);
+	return expr;
 }
 
-ExprPtr Parser::ParseExprArraySlice(Pos pos, ExprPtr left, ExprPtr first)
+template<class Tree>
+auto BasicParser<Tree>::ParseExprArraySlice(Pos pos, ExprRef left, ExprRef first) -> ExprRef
 {
-	auto expr = new ExprArraySlice;
-	expr->pos = pos;
-	expr->left = left;
-	expr->start = first;
-
-	if (expr->left)
-	{
-		expr->range.beg = expr->left->range.beg;
-	}
+	auto range = Range(m_tree.Beg(left, Pos()), Pos());
+	ExprRef end = ExprRef();
+	ExprRef step = ExprRef();
 
 	EatToken();
 
 	if (m_token.type == TokRightBracket)
 	{
-		expr->range.end = EatToken().range.end;
-		m_sema.Visit(expr);
-		return ExprPtr(expr);
+		range.end = EatToken().range.end;
+		return m_tree.ArraySlice(pos, range, left, first, end, step);
 	}
 
 	if (CanBeExpr())
 	{
-		expr->end = ParseExprCore(Precedence::Invalid);
+		end = ParseExprCore(Precedence::Invalid);
 
 		if (m_token.type == TokRightBracket)
 		{
-			expr->range.end = EatToken().range.end;
-			m_sema.Visit(expr);
-			return ExprPtr(expr);
+			range.end = EatToken().range.end;
+			return m_tree.ArraySlice(pos, range, left, first, end, step);
 		}
 	}
 
 	EatToken(TokColon);
 
-	expr->step = ParseExprCore(Precedence::Invalid);
-	expr->range.end = ParseTerminator(TokRightBracket, expr->pos, ParseUnterminatedArraySlice);
-	m_sema.Visit(expr);
-	return ExprPtr(expr);
+	step = ParseExprCore(Precedence::Invalid);
+	range.end = ParseTerminator(TokRightBracket, pos, ParseUnterminatedArraySlice);
+	return m_tree.ArraySlice(pos, range, left, first, end, step);
 }
 
 // ---------------------------------------------------------------------------
 // Statements
 // ---------------------------------------------------------------------------
 
-StmtPtr Parser::ParseStmtCore()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtCore() -> StmtRef
 {
 	switch (m_token.type)
 	{
@@ -793,7 +728,7 @@ StmtPtr Parser::ParseStmtCore()
 			<< m_token.type
 			<< DiagEnd;
 		EatToken();
-		return NULL;
+		return StmtRef();
 	default:
 		break;
 	}
@@ -802,7 +737,7 @@ StmtPtr Parser::ParseStmtCore()
 	{
 	case TokSemicolon:
 		EatToken();
-		return NULL;
+		return StmtRef();
 	case TokLeftBrace:
 		return ParseStmtBlock();
 	case KwBreak:
@@ -843,91 +778,72 @@ StmtPtr Parser::ParseStmtCore()
 		<< ParseExpectedStmt
 		<< DiagEnd;
 	EatToken();
-	return NULL;
+	return StmtRef();
 }
 
-StmtPtr Parser::ParseStmtBlock()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtBlock() -> StmtRef
 {
-	auto stmt = new StmtBlock;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	StmtList statements;
 
-	SemaScope scope(m_sema, Scope::Block, sptr);
 	EatToken(TokLeftBrace);
 
 	while (m_token.type != TokRightBrace && m_token.type != TokEndOfFile)
 	{
-		stmt->statements.push_back(ParseStmt());
+		statements.push_back(ParseStmt());
 	}
 
-	stmt->range.end = EatToken(TokRightBrace).range.end;
-	m_sema.Visit(stmt);
-	return sptr;
+	auto end = EatToken(TokRightBrace).range.end;
+	return m_tree.Block(pos, Range(pos, end), statements);
 }
 
-StmtPtr Parser::ParseStmtControl()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtControl() -> StmtRef
 {
-	auto stmt = new StmtControl;
-	stmt->pos = m_token.range.beg;
-	stmt->type = m_token.type;
-	stmt->range = m_token.range;
-
-	EatToken();
+	auto keyword = EatToken();
+	auto end = EatToken(TokSemicolon).range.end;
 
-	stmt->range.end = EatToken(TokSemicolon).range.end;
-	m_sema.Visit(stmt);
-	return StmtPtr(stmt);
+	return m_tree.Control(keyword.range.beg, Range(keyword.range.beg, end), keyword.type);
 }
 
-StmtPtr Parser::ParseStmtDoWhile()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtDoWhile() -> StmtRef
 {
-	auto stmt = new StmtDoWhile;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
 
-	SemaScope scope(m_sema, Scope::Loop, sptr);
 	EatToken();
-	stmt->body = ParseStmtCore();
+	auto body = ParseStmtCore();
 	EatToken(KwWhile);
-	stmt->cond = ParseExprCondition();
+	auto cond = ParseExprCondition();
 
-	stmt->range.end = EatToken(TokSemicolon).range.end;
-	m_sema.Visit(stmt);
-	return sptr;
+	auto end = EatToken(TokSemicolon).range.end;
+	return m_tree.DoWhile(pos, Range(pos, end), body, cond);
 }
 
-StmtPtr Parser::ParseStmtFor()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtFor() -> StmtRef
 {
-	auto stmt = new StmtFor;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	StmtRef init;
+	ExprRef cond;
+	ExprList steps;
 
-	SemaScope scope(m_sema, Scope::Loop, sptr);
 	EatToken();
 
 	EatToken(TokLeftParen);
 	{
 		if (m_token.type == KwVar || m_token.type == KwConst)
 		{
-			stmt->init = ParseStmtVarDecl();
+			init = ParseStmtVarDecl();
 		}
 		else
 		{
 			if (CanBeExpr())
 			{
-				auto init = new StmtNakedExpr;
-
-				init->value = ParseExpr();
-				if (init->value)
-				{
-					init->pos = init->value->pos;
-					init->range = init->value->range;
-				}
-
-				stmt->init.reset(init);
+				auto value = ParseExpr();
+				auto range = Range(m_tree.Beg(value, Pos()), m_tree.End(value, Pos()));
+				init = m_tree.NakedExpr(range.beg, range, value);
 			}
 
 			EatToken(TokSemicolon);
@@ -935,7 +851,7 @@ StmtPtr Parser::ParseStmtFor()
 
 		if (CanBeExpr())
 		{
-			stmt->cond = ParseExpr();
+			cond = ParseExpr();
 		}
 
 		EatToken(TokSemicolon);
@@ -944,7 +860,7 @@ StmtPtr Parser::ParseStmtFor()
 		{
 			while (true)
 			{
-				stmt->steps.push_back(ParseExpr());
+				steps.push_back(ParseExpr());
 
 				if (m_token.type == TokComma)
 				{
@@ -958,168 +874,123 @@ StmtPtr Parser::ParseStmtFor()
 	}
 	EatToken(TokRightParen);
 
-	stmt->body = ParseStmtCore();
-	if (stmt->body)
-	{
-		stmt->range.end = stmt->body->range.end;
-	}
-	else
-	{
-		stmt->range.end = m_token.range.beg;
-	}
+	auto body = ParseStmtCore();
 
-	m_sema.Visit(stmt);
-	return sptr;
+	auto range = Range(pos, m_tree.End(body, m_token.range.beg));
+	return m_tree.For(pos, range, init, cond, steps, body);
 }
 
-StmtPtr Parser::ParseStmtForeach()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtForeach() -> StmtRef
 {
-	auto stmt = new StmtForeach;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	NameRef name;
+	ExprRef from;
 
-	SemaScope scope(m_sema, Scope::Loop, sptr);
 	EatToken();
 
 	EatToken(TokLeftParen);
 	{
 		EatToken(KwVar);
-		auto id = EatToken(TokIdentifier);
-		m_sema.Declare(Decl::Variable, id.range, IdString(id.slice), sptr);
+		name = m_tree.Name(EatToken(TokIdentifier));
 		EatToken(KwIn);
-		stmt->from = ParseExpr();
+		from = ParseExpr();
 	}
 	EatToken(TokRightParen);
 
-	stmt->body = ParseStmtCore();
-	if (stmt->body)
-	{
-		stmt->range.end = stmt->body->range.end;
-	}
-	else
-	{
-		stmt->range.end = m_token.range.beg;
-	}
+	auto body = ParseStmtCore();
 
-	m_sema.Visit(stmt);
-	return sptr;
+	auto range = Range(pos, m_tree.End(body, m_token.range.beg));
+	return m_tree.Foreach(pos, range, name, from, body);
 }
 
-StmtPtr Parser::ParseStmtFunDecl()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtFunDecl() -> StmtRef
 {
-	auto declType = m_token.type == KwFun ? Decl::Function : Decl::Sequence;
-	auto scopeType = m_token.type == KwFun ? Scope::Function : Scope::Sequence;
-
-	auto stmt = new StmtFunDecl;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	auto sequence = m_token.type == KwSeq;
+	auto varargs = false;
+	NameList arguments;
+	StmtRef body;
+	Pos end;
 
 	EatToken();
 
-	auto id = EatToken(TokIdentifier);
-	m_sema.Declare(declType, id.range, IdString(id.slice), sptr);
-
-	SemaScope scope(m_sema, scopeType, sptr);
-	ParseArgumentList(stmt->varargs);
+	auto name = m_tree.Name(EatToken(TokIdentifier));
+	ParseArgumentList(arguments, varargs);
 
 	if (m_token.type == OpPointy)
 	{
-		stmt->body = ParseStmtLambdaBody(false);
-		stmt->range.end = EatToken(TokSemicolon).range.end;
+		body = ParseStmtLambdaBody(false);
+		end = EatToken(TokSemicolon).range.end;
 	}
 	else
 	{
-		stmt->body = ParseStmtBlock();
-		if (stmt->body)
-		{
-			stmt->range.end = stmt->body->range.end;
-		}
-		else
-		{
-			stmt->range.end = m_token.range.beg;
-		}
+		body = ParseStmtBlock();
+		end = m_tree.End(body, m_token.range.beg);
 	}
 
-	m_sema.Visit(stmt);
-	return sptr;
+	return m_tree.FunDecl(pos, Range(pos, end), sequence, name, varargs, arguments, body);
 }
 
-StmtPtr Parser::ParseStmtIfElse()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtIfElse() -> StmtRef
 {
-	auto stmt = new StmtIfElse;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	StmtRef elseBody;
 
-	SemaScope scope(m_sema, Scope::Block, sptr);
 	EatToken();
 
-	stmt->cond = ParseExprCondition();
-	stmt->thenBody = ParseStmtCore();
+	auto cond = ParseExprCondition();
+	auto thenBody = ParseStmtCore();
 
 	if (m_token.type == KwElse)
 	{
 		EatToken();
-		stmt->elseBody = ParseStmtCore();
+		elseBody = ParseStmtCore();
 	}
 
-	if (stmt->elseBody)
-	{
-		stmt->range.end = stmt->elseBody->range.end;
-	}
-	else if (stmt->thenBody)
-	{
-		stmt->range.end = stmt->thenBody->range.end;
-	}
-	else
-	{
-		stmt->range.end = m_token.range.beg;
-	}
-
-	m_sema.Visit(stmt);
-	return sptr;
+	auto end = m_tree.End(elseBody, m_tree.End(thenBody, m_token.range.beg));
+	return m_tree.IfElse(pos, Range(pos, end), cond, thenBody, elseBody);
 }
 
-StmtPtr Parser::ParseStmtReturn()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtReturn() -> StmtRef
 {
-	auto stmt = new StmtReturn;
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	ExprRef value;
 
 	EatToken();
 
 	if (CanBeExpr())
 	{
-		stmt->value = ParseExpr();
+		value = ParseExpr();
 	}
 
-	stmt->range.end = EatToken(TokSemicolon).range.end;
-	m_sema.Visit(stmt);
-	return StmtPtr(stmt);
+	auto end = EatToken(TokSemicolon).range.end;
+	return m_tree.Return(pos, Range(pos, end), value);
 }
 
-StmtPtr Parser::ParseStmtVarDecl()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtVarDecl() -> StmtRef
 {
-	auto type = m_token.type == KwVar ? Decl::Variable : Decl::Constant;
-	auto stmt = new StmtVarDecl;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	auto type = m_token.type;
+	NameList names;
+	ExprList values;
 
 	EatToken();
 
 	while (true)
 	{
 		auto id = EatToken(TokIdentifier);
-		m_sema.Declare(type, id.range, IdString(id.slice), sptr);
+		names.push_back(m_tree.Name(id));
 
 		if (m_token.type == TokComma || m_token.type == TokSemicolon)
 		{
-			stmt->values.push_back(NULL);
+			values.push_back(ExprRef());
 
-			if (type == Decl::Constant)
+			if (type == KwConst)
 			{
 				m_diag
 					<< id.range
@@ -1138,7 +1009,7 @@ StmtPtr Parser::ParseStmtVarDecl()
 		}
 
 		EatToken(OpAssign);
-		stmt->values.push_back(ParseExpr());
+		values.push_back(ParseExpr());
 
 		if (m_token.type == TokComma)
 		{
@@ -1149,41 +1020,40 @@ StmtPtr Parser::ParseStmtVarDecl()
 		break;
 	}
 
-	stmt->range.end = EatToken(TokSemicolon).range.end;
-	m_sema.Visit(stmt);
-	return sptr;
+	auto end = EatToken(TokSemicolon).range.end;
+	return m_tree.VarDecl(pos, Range(pos, end), type, names, values);
 }
 
-StmtPtr Parser::ParseStmtSwitch()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtSwitch() -> StmtRef
 {
-	auto stmt = new StmtSwitch;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	CaseList cases;
 
-	SemaScope scope(m_sema, Scope::Block, sptr);
 	EatToken();
-	stmt->value = ParseExprCondition();
+	auto value = ParseExprCondition();
 	EatToken(TokLeftBrace);
 
 	while (m_token.type != TokRightBrace && m_token.type != TokEndOfFile)
 	{
-		auto current = StmtSwitch::Case();
+		auto def = false;
+		Range headRange;
+		ExprRef caseValue;
+		StmtList body;
 
-		current.headRange.beg = m_token.range.beg;
+		headRange.beg = m_token.range.beg;
 
 		if (m_token.type == KwCase)
 		{
 			EatToken();
-			current.def = false;
-			current.value = ParseExpr();
-			current.headRange.end = EatToken(TokColon).range.end;
+			caseValue = ParseExpr();
+			headRange.end = EatToken(TokColon).range.end;
 		}
 		else if (m_token.type == KwDefault)
 		{
 			EatToken();
-			current.def = true;
-			current.headRange.end = EatToken(TokColon).range.end;
+			def = true;
+			headRange.end = EatToken(TokColon).range.end;
 		}
 		else
 		{
@@ -1204,59 +1074,46 @@ StmtPtr Parser::ParseStmtSwitch()
 			case KwDefault:
 				break;
 			default:
-				current.body.push_back(ParseStmt());
+				body.push_back(ParseStmt());
 				continue;
 			}
 
 			break;
 		}
 
-		stmt->cases.push_back(current);
+		cases.push_back(m_tree.Case(def, headRange, caseValue, body));
 	}
 
-	stmt->range.end = EatToken(TokRightBrace).range.end;
-	m_sema.Visit(stmt);
-	return sptr;
+	auto end = EatToken(TokRightBrace).range.end;
+	return m_tree.Switch(pos, Range(pos, end), value, cases);
 }
 
-StmtPtr Parser::ParseStmtWhile()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtWhile() -> StmtRef
 {
-	auto stmt = new StmtWhile;
-	auto sptr = StmtPtr(stmt);
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
 
-	SemaScope scope(m_sema, Scope::Loop, sptr);
 	EatToken();
 
-	stmt->cond = ParseExprCondition();
-	stmt->body = ParseStmtCore();
-
-	if (stmt->body)
-	{
-		stmt->range.end = stmt->body->range.end;
-	}
-	else
-	{
-		stmt->range.end = m_token.range.beg;
-	}
+	auto cond = ParseExprCondition();
+	auto body = ParseStmtCore();
 
-	m_sema.Visit(stmt);
-	return sptr;
+	auto range = Range(pos, m_tree.End(body, m_token.range.beg));
+	return m_tree.While(pos, range, cond, body);
 }
 
-StmtPtr Parser::ParseStmtNakedExpr()
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtNakedExpr() -> StmtRef
 {
-	auto stmt = new StmtNakedExpr;
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
-	stmt->value = ParseExprCore(Precedence::Invalid);
-	stmt->range.end = EatToken(TokSemicolon).range.end;
-	m_sema.Visit(stmt);
-	return StmtPtr(stmt);
+	auto pos = m_token.range.beg;
+	auto value = ParseExprCore(Precedence::Invalid);
+	auto end = EatToken(TokSemicolon).range.end;
+
+	return m_tree.NakedExpr(pos, Range(pos, end), value);
 }
 
-StmtPtr  Mond::Parser::ParseStmtLambdaBody(bool isShorthand)
+template<class Tree>
+auto BasicParser<Tree>::ParseStmtLambdaBody(bool isShorthand) -> StmtRef
 {
 	auto pointy = EatToken(OpPointy);
 
@@ -1274,29 +1131,19 @@ StmtPtr  Mond::Parser::ParseStmtLambdaBody(bool isShorthand)
 		return ParseStmtBlock();
 	}
 
-	auto stmt = new StmtReturn;
-	stmt->pos = m_token.range.beg;
-	stmt->range = m_token.range;
+	auto pos = m_token.range.beg;
+	auto value = ParseExprCore(Precedence::Invalid);
 
-	stmt->value = ParseExprCore(Precedence::Invalid);
-	if (stmt->value)
-	{
-		stmt->range.end = stmt->value->range.end;
-	}
-	else
-	{
-		stmt->range.end = m_token.range.beg;
-	}
-
-	m_sema.Visit(stmt);
-	return StmtPtr(stmt);
+	auto range = Range(pos, m_tree.End(value, m_token.range.beg));
+	return m_tree.Return(pos, range, value);
 }
 
 // ---------------------------------------------------------------------------
 // Reused parsers
 // ---------------------------------------------------------------------------
 
-Pos Parser::ParseTerminator(TokenType type, Pos beg, DiagMessage msg)
+template<class Tree>
+Pos BasicParser<Tree>::ParseTerminator(TokenType type, Pos beg, DiagMessage msg)
 {
 	Token token;
 
@@ -1317,7 +1164,8 @@ Pos Parser::ParseTerminator(TokenType type, Pos beg, DiagMessage msg)
 	return token.range.end;
 }
 
-void Parser::ParseArgumentList(bool &varargs)
+template<class Tree>
+void BasicParser<Tree>::ParseArgumentList(NameList &arguments, bool &varargs)
 {
 	varargs = false;
 
@@ -1333,9 +1181,7 @@ void Parser::ParseArgumentList(bool &varargs)
 					varargs = true;
 				}
 
-				// TODO: AstNode
-				auto id = EatToken(TokIdentifier);
-				m_sema.Declare(Decl::Argument, id.range, IdString(id.slice), NULL);
+				arguments.push_back(m_tree.Name(EatToken(TokIdentifier)));
 
 				if (!varargs && m_token.type == TokComma)
 				{
@@ -1350,3 +1196,10 @@ void Parser::ParseArgumentList(bool &varargs)
 	}
 	EatToken(TokRightParen);
 }
+
+// ---------------------------------------------------------------------------
+// Instantiations
+// ---------------------------------------------------------------------------
+
+template class Mond::BasicParser<AstBuilder>;
+template class Mond::BasicParser<NullBuilder>;
@@ -3,19 +3,53 @@
 
 #include "Sema.hpp"
 #include "Lexer.hpp"
+#include "AstBuilder.hpp"
+#include "NullBuilder.hpp"
 #include "OperatorUtil.hpp"
 
 namespace Mond
 {
-	class Parser
+	// The grammar, shared by every tree policy. The policy gets each finished
+	// production and decides what, if anything, to build from it. Parser.cpp
+	// instantiates it for AstBuilder and NullBuilder.
+	template<class Tree>
+	class BasicParser
 	{
 	public:
-		Parser(DiagBuilder &diag, Source &source, Lexer &lexer, Sema &sema);
+		typedef typename Tree::ExprRef ExprRef;
+		typedef typename Tree::StmtRef StmtRef;
+		typedef typename Tree::NameRef NameRef;
+		typedef typename Tree::EntryRef EntryRef;
+		typedef typename Tree::CaseRef CaseRef;
 
-		StmtPtr ParseFile();
+		typedef typename Tree::ExprList ExprList;
+		typedef typename Tree::StmtList StmtList;
+		typedef typename Tree::NameList NameList;
+		typedef typename Tree::EntryList EntryList;
+		typedef typename Tree::CaseList CaseList;
+
+		BasicParser(DiagBuilder &diag, Source &source, Lexer &lexer);
+
+		StmtRef ParseFile();
+
+		// Hands each top-level statement to the callback as soon as it's
+		// parsed instead of collecting them, so nothing is kept once the
+		// callback is done with it. Empty statements are skipped.
+		void ParseFile(const function<void (StmtRef)> &callback);
 
-		ExprPtr ParseExpr();
-		StmtPtr ParseStmt();
+		ExprRef ParseExpr();
+		StmtRef ParseStmt();
+
+		// Checked before every statement, nested ones included.
+		void SetCancelToken(const CancelToken &token);
+
+		// The identifier or field access holding the lexer's TokCompletion,
+		// if the parser got it somewhere a name could go.
+		ExprRef CompletionExpr() const;
+
+		// The token the next statement starts at, TokEndOfFile once there
+		// are none left.
+		const Token &CurrentToken() const;
 	private:
 		void More();
 		void Advance();
@@ -25,78 +59,94 @@ namespace Mond
 		Token Lookahead(int n = 0);
 		Token CreateMissing(TokenType type, bool error);
 
-		string IdString(Slice s);
-		string LiteralString(Slice s);
-		double LiteralNumber(Slice s);
-
 		// -------------------------------------------------------------------
 		// Expressions
 		// -------------------------------------------------------------------
 
 		bool CanBeExpr();
 
-		ExprPtr ParseExprCore(Precedence p);
+		ExprRef ParseExprCore(Precedence p);
 
-		ExprPtr ParseExprId();
-		ExprPtr ParseExprStringLiteral();
-		ExprPtr ParseExprNumberLiteral();
-		ExprPtr ParseExprSimpleLiteral();
+		ExprRef ParseExprId();
+		ExprRef ParseExprStringLiteral();
+		ExprRef ParseExprNumberLiteral();
+		ExprRef ParseExprSimpleLiteral();
 
-		ExprPtr ParseExprParens();
-		ExprPtr ParseExprObjectLiteral();
-		ExprPtr ParseExprArrayLiteral();
+		ExprRef ParseExprParens();
+		ExprRef ParseExprObjectLiteral();
+		ExprRef ParseExprArrayLiteral();
 
-		ExprPtr ParseExprYield();
+		ExprRef ParseExprYield();
 
-		ExprPtr ParseExprCall(ExprPtr left);
-		ExprPtr ParseExprIndexAccess(ExprPtr left);
-		ExprPtr ParseExprFieldAccess(ExprPtr left);
+		ExprRef ParseExprCall(ExprRef left);
+		ExprRef ParseExprIndexAccess(ExprRef left);
+		ExprRef ParseExprFieldAccess(ExprRef left);
 
-		ExprPtr ParseExprPrefixOp();
-		ExprPtr ParseExprPostfixOp(ExprPtr left);
-		ExprPtr ParseExprBinaryOp(ExprPtr left, Precedence p);
-		ExprPtr ParseExprTernaryOp(ExprPtr left);
+		ExprRef ParseExprPrefixOp();
+		ExprRef ParseExprPostfixOp(ExprRef left);
+		ExprRef ParseExprBinaryOp(ExprRef left, Precedence p);
+		ExprRef ParseExprTernaryOp(ExprRef left);
 
-		ExprPtr ParseExprLambda();
-		ExprPtr ParseExprCondition();
-		ExprPtr ParseExprArraySlice(Pos pos, ExprPtr left, ExprPtr first);
+		ExprRef ParseExprLambda();
+		ExprRef ParseExprCondition();
+		ExprRef ParseExprArraySlice(Pos pos, ExprRef left, ExprRef first);
 
 		// -------------------------------------------------------------------
 		// Statements
 		// -------------------------------------------------------------------
 
-		StmtPtr ParseStmtCore();
+		StmtRef ParseStmtCore();
 
-		StmtPtr ParseStmtBlock();
-		StmtPtr ParseStmtControl();
-		StmtPtr ParseStmtDoWhile();
-		StmtPtr ParseStmtFor();
-		StmtPtr ParseStmtForeach();
-		StmtPtr ParseStmtFunDecl();
-		StmtPtr ParseStmtIfElse();
-		StmtPtr ParseStmtReturn();
-		StmtPtr ParseStmtVarDecl();
-		StmtPtr ParseStmtSwitch();
-		StmtPtr ParseStmtWhile();
+		StmtRef ParseStmtBlock();
+		StmtRef ParseStmtControl();
+		StmtRef ParseStmtDoWhile();
+		StmtRef ParseStmtFor();
+		StmtRef ParseStmtForeach();
+		StmtRef ParseStmtFunDecl();
+		StmtRef ParseStmtIfElse();
+		StmtRef ParseStmtReturn();
+		StmtRef ParseStmtVarDecl();
+		StmtRef ParseStmtSwitch();
+		StmtRef ParseStmtWhile();
 
-		StmtPtr ParseStmtNakedExpr();
-		StmtPtr ParseStmtLambdaBody(bool isShorthand);
+		StmtRef ParseStmtNakedExpr();
+		StmtRef ParseStmtLambdaBody(bool isShorthand);
 
 		// -------------------------------------------------------------------
 		// Reused parsers
 		// -------------------------------------------------------------------
 
 		Pos ParseTerminator(TokenType type, Pos beg, DiagMessage msg);
-		void ParseArgumentList(bool &varargs);
+		void ParseArgumentList(NameList &arguments, bool &varargs);
 	private:
-		Sema &m_sema;
+		Tree m_tree;
 		Lexer &m_lexer;
-		Source &m_source;
 		DiagBuilder &m_diag;
 
 		Token m_token;
 		deque<Token> m_lookahead;
+		CancelToken m_cancel;
+		ExprRef m_completion;
 	};
+
+	class Parser : public BasicParser<AstBuilder>
+	{
+	public:
+		// Without a Sema the parser only builds the syntax tree, which can be
+		// checked later with Sema::Check. With one, ParseFile checks the tree
+		// before returning it, or each statement before handing it over.
+		Parser(DiagBuilder &diag, Source &source, Lexer &lexer);
+		Parser(DiagBuilder &diag, Source &source, Lexer &lexer, Sema &sema);
+
+		StmtPtr ParseFile();
+		void ParseFile(const function<void (StmtPtr)> &callback);
+	private:
+		Sema *m_sema;
+	};
+
+	// Only checks that a file parses. Reports the same parse errors as Parser
+	// without building anything.
+	typedef BasicParser<NullBuilder> SyntaxParser;
 }
 
 #endif
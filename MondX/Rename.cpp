@@ -0,0 +1,395 @@
+#include <atomic>
+#include <cstdio>
+#include <algorithm>
+#include "Parser.hpp"
+#include "Rename.hpp"
+#include "NodeIndex.hpp"
+#include "MappedFile.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// A checked file, with where each of its lines starts so edits can be
+// checked against the text.
+struct RenameFile
+{
+	string path;
+	string text;
+	vector<size_t> lines;
+	StmtPtr tree;
+	ScopePtr root;
+	NodeIndex index;
+	vector<ExprId *> ids;
+};
+
+static void checkFile(RenameFile &file, BuiltinScopePtr builtinScope)
+{
+	DiagBuilder diag;
+	StringSource source(file.text.c_str());
+	Lexer lexer(diag, source);
+	Parser parser(diag, source, lexer);
+	Sema sema(diag, builtinScope);
+
+	file.tree = parser.ParseFile();
+	sema.Check(file.tree);
+	file.root = sema.RootScope();
+	file.index = NodeIndex(file.tree, file.root.get());
+
+	file.ids = CollectIds(file.tree.get());
+
+	file.lines.push_back(0);
+
+	for (size_t i = 0; i < file.text.size(); i++)
+	{
+		auto c = file.text[i];
+
+		if (c == '\n' || (c == '\r' && (i + 1 >= file.text.size() || file.text[i + 1] != '\n')))
+		{
+			file.lines.push_back(i + 1);
+		}
+	}
+}
+
+static bool isName(const string &name)
+{
+	if (name.empty() || IsDecDigit(name[0]) || ClassIdentifier(name) != TokIdentifier)
+	{
+		return false;
+	}
+
+	for (auto c : name)
+	{
+		if (!IsNameChar(c))
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Whether name appears as a whole word anywhere, comments and strings
+// included. A file that fails this can't use the name.
+static bool mentions(const char *data, size_t size, const string &name)
+{
+	auto end = data + size;
+
+	for (auto p = data; (p = std::search(p, end, name.begin(), name.end())) != end; p++)
+	{
+		if ((p == data || !IsNameChar(p[-1])) && (p + name.size() == end || !IsNameChar(p[name.size()])))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static bool contains(const Range &range, Pos pos)
+{
+	return !(pos < range.beg) && pos < range.end;
+}
+
+// Whether range holds exactly name in the file's text.
+static bool spells(const RenameFile &file, const Range &range, const string &name)
+{
+	if (range.beg.line != range.end.line || range.beg.line < 1 || (size_t)range.beg.line > file.lines.size())
+	{
+		return false;
+	}
+
+	auto offset = file.lines[range.beg.line - 1] + range.beg.column - 1;
+
+	return range.end.column - range.beg.column == (SourceInt)name.size() &&
+		offset + name.size() <= file.text.size() &&
+		file.text.compare(offset, name.size(), name) == 0;
+}
+
+static string describe(const RenameFile &file, Pos pos, const string &message)
+{
+	char prefix[32];
+	snprintf(prefix, sizeof(prefix), ":%d:%d: ", (int)pos.line, (int)pos.column);
+	return file.path + prefix + message;
+}
+
+static void finishEdits(RenameEdits &edits)
+{
+	// Statements like x++ can hand the same name to Sema more than once.
+	std::sort(edits.ranges.begin(), edits.ranges.end(), [](const Range &a, const Range &b)
+	{
+		return a.beg < b.beg;
+	});
+
+	edits.ranges.erase(std::unique(edits.ranges.begin(), edits.ranges.end(), [](const Range &a, const Range &b)
+	{
+		return a.beg == b.beg;
+	}), edits.ranges.end());
+}
+
+// Renames the undeclared uses of oldName in a file. The new name mustn't be
+// declared anywhere they can see, or be used undeclared already, since both
+// would change what they refer to.
+static bool renameUndeclared(RenameFile &file, const string &oldName, const string &newName, BuiltinScopePtr builtinScope, RenameEdits &edits, string &error)
+{
+	edits.path = file.path;
+
+	for (auto id : file.ids)
+	{
+		if (id->decl || !id->range.IsValid())
+		{
+			continue;
+		}
+
+		if (id->name == newName)
+		{
+			error = describe(file, id->range.beg, "'" + newName + "' is already used here");
+			return false;
+		}
+		else if (id->name != oldName)
+		{
+			continue;
+		}
+
+		for (auto scope = file.index.ScopeAt(id->range.beg); scope; scope = scope->parent)
+		{
+			auto it = scope->decls.find(newName);
+
+			if (it != scope->decls.end())
+			{
+				error = describe(file, id->range.beg, "'" + oldName + "' would refer to the '" + newName + "' declared on line " + std::to_string(it->second.range.beg.line));
+				return false;
+			}
+		}
+
+		if (builtinScope && builtinScope->Find(newName))
+		{
+			error = describe(file, id->range.beg, "'" + oldName + "' would refer to builtin '" + newName + "'");
+			return false;
+		}
+
+		edits.ranges.push_back(id->range);
+	}
+
+	finishEdits(edits);
+	return true;
+}
+
+// Whether looking name up from scope gets as far as target.
+static bool reaches(Scope *scope, Scope *target, const string &name)
+{
+	for (; scope; scope = scope->parent)
+	{
+		if (scope == target)
+		{
+			return true;
+		}
+		else if (scope->decls.count(name))
+		{
+			return false;
+		}
+	}
+
+	return false;
+}
+
+// Renames a declaration and its uses in its own file.
+static bool renameDeclared(RenameFile &file, const Decl *decl, const string &oldName, const string &newName, RenameEdits &edits, string &error)
+{
+	auto declScope = decl->scope;
+	edits.path = file.path;
+
+	auto clash = declScope->decls.find(newName);
+
+	if (clash != declScope->decls.end())
+	{
+		error = describe(file, decl->range.beg, "'" + newName + "' is already declared on line " + std::to_string(clash->second.range.beg.line));
+		return false;
+	}
+
+	if (!spells(file, decl->range, oldName))
+	{
+		error = describe(file, decl->range.beg, "can't find the declaration of '" + oldName + "'");
+		return false;
+	}
+
+	edits.ranges.push_back(decl->range);
+
+	for (auto id : file.ids)
+	{
+		if (!id->range.IsValid() || (id->decl != decl && id->name != newName))
+		{
+			continue;
+		}
+
+		// A use of the declaration mustn't pass a declaration of the new
+		// name on its way out to it, and a use of the new name mustn't get
+		// to the declaration before one of its own.
+		auto scope = file.index.ScopeAt(id->range.beg);
+
+		if (id->decl != decl)
+		{
+			if (reaches(scope, declScope, newName))
+			{
+				error = describe(file, id->range.beg, "'" + newName + "' would refer to the renamed declaration");
+				return false;
+			}
+
+			continue;
+		}
+
+		for (; scope && scope != declScope; scope = scope->parent)
+		{
+			auto it = scope->decls.find(newName);
+
+			if (it != scope->decls.end())
+			{
+				error = describe(file, id->range.beg, "'" + oldName + "' would refer to the '" + newName + "' declared on line " + std::to_string(it->second.range.beg.line));
+				return false;
+			}
+		}
+
+		edits.ranges.push_back(id->range);
+	}
+
+	finishEdits(edits);
+	return true;
+}
+
+// ---------------------------------------------------------------------------
+// Rename
+// ---------------------------------------------------------------------------
+
+RenameResult Mond::Rename(const string &path, const string &text, Pos pos, const string &newName, BuiltinScopePtr builtinScope)
+{
+	WorkPool pool(1);
+	return Rename(path, text, pos, newName, builtinScope, vector<string>(), pool);
+}
+
+RenameResult Mond::Rename(const string &path, const string &text, Pos pos, const string &newName, BuiltinScopePtr builtinScope, const vector<string> &otherFiles, WorkPool &pool)
+{
+	RenameResult result;
+	result.skipped = 0;
+
+	RenameFile file;
+	file.path = path;
+	file.text = text;
+	checkFile(file, builtinScope);
+
+	// Either a use of the name, or the declaration itself.
+	const Decl *decl = NULL;
+	string oldName;
+	auto id = dynamic_cast<ExprId *>(file.index.NodeAt(pos));
+
+	if (id)
+	{
+		decl = id->decl;
+		oldName = id->name;
+	}
+	else
+	{
+		for (auto scope = file.index.ScopeAt(pos); scope && !decl; scope = scope->parent)
+		{
+			for (auto &entry : scope->decls)
+			{
+				if (contains(entry.second.range, pos))
+				{
+					decl = &entry.second;
+					oldName = entry.first;
+					break;
+				}
+			}
+		}
+	}
+
+	if (oldName == "")
+	{
+		result.error = describe(file, pos, "there's no name here to rename");
+		return result;
+	}
+	else if (decl && !decl->scope)
+	{
+		result.error = describe(file, pos, "'" + oldName + "' is a builtin and can't be renamed");
+		return result;
+	}
+	else if (!isName(newName))
+	{
+		result.error = "'" + newName + "' isn't a valid name";
+		return result;
+	}
+	else if (newName == oldName)
+	{
+		return result;
+	}
+
+	RenameEdits edits;
+
+	if (decl)
+	{
+		if (renameDeclared(file, decl, oldName, newName, edits, result.error))
+		{
+			result.files.push_back(edits);
+		}
+
+		return result;
+	}
+
+	if (!renameUndeclared(file, oldName, newName, builtinScope, edits, result.error))
+	{
+		return result;
+	}
+
+	result.files.push_back(edits);
+
+	// Most files never use the name, the search is far cheaper than a check.
+	vector<string> paths;
+
+	for (auto &other : otherFiles)
+	{
+		if (other != path)
+		{
+			paths.push_back(other);
+		}
+	}
+
+	vector<RenameEdits> others(paths.size());
+	vector<string> errors(paths.size());
+	std::atomic<size_t> skipped(0);
+
+	pool.Run(paths.size(), [&](size_t job, int)
+	{
+		MappedFile contents(paths[job]);
+
+		if (!contents.IsValid() || !mentions(contents.Data(), contents.Size(), oldName))
+		{
+			skipped++;
+			return;
+		}
+
+		RenameFile other;
+		other.path = paths[job];
+		other.text.assign(contents.Data(), contents.Size());
+		checkFile(other, builtinScope);
+		renameUndeclared(other, oldName, newName, builtinScope, others[job], errors[job]);
+	});
+
+	result.skipped = skipped;
+
+	for (size_t i = 0; i < paths.size(); i++)
+	{
+		if (errors[i] != "")
+		{
+			result.error = errors[i];
+			result.files.clear();
+			return result;
+		}
+		else if (!others[i].ranges.empty())
+		{
+			result.files.push_back(others[i]);
+		}
+	}
+
+	return result;
+}
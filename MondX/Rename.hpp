@@ -0,0 +1,42 @@
+#ifndef MOND_RENAME_HPP
+#define MOND_RENAME_HPP
+
+#include "WorkPool.hpp"
+#include "BuiltinScope.hpp"
+
+namespace Mond
+{
+	// The ranges of one file that get the new name, sorted, each only once.
+	struct RenameEdits
+	{
+		string path;
+		vector<Range> ranges;
+	};
+
+	struct RenameResult
+	{
+		// Why nothing can be renamed, empty if the edits are good.
+		string error;
+		vector<RenameEdits> files;
+		// Other files that couldn't use the name and weren't parsed.
+		size_t skipped;
+	};
+
+	// Renames what the name at pos in text refers to, going by what Sema
+	// resolved rather than by spelling. A name declared in the file is only
+	// renamed there, scripts don't see each other's declarations. An
+	// undeclared name is renamed in text and in every other file that uses it
+	// undeclared. Builtins can't be renamed.
+	//
+	// Fails rather than change what any name refers to: the new name can't
+	// already be declared alongside the old one, hide it from a use, or be
+	// hidden by the renamed declaration from one of its own uses.
+	RenameResult Rename(const string &path, const string &text, Pos pos, const string &newName, BuiltinScopePtr builtinScope);
+
+	// The same, looking at otherFiles for uses of an undeclared name. Files
+	// that don't mention the name anywhere are skipped without parsing, the
+	// rest are checked on the pool.
+	RenameResult Rename(const string &path, const string &text, Pos pos, const string &newName, BuiltinScopePtr builtinScope, const vector<string> &otherFiles, WorkPool &pool);
+}
+
+#endif
@@ -0,0 +1,142 @@
+#include <chrono>
+#include "Scheduler.hpp"
+
+using namespace Mond;
+
+Scheduler::Scheduler(int threads) :
+	m_threads(threads < 1 ? 1 : threads),
+	m_running(m_threads),
+	m_runningBackground(0),
+	m_quit(false),
+	m_completed(0),
+	m_skipped(0),
+	m_interrupted(0),
+	m_wasted(0),
+	m_failed(0)
+{
+	for (int i = 0; i < m_threads; i++)
+	{
+		m_workers.emplace_back(&Scheduler::WorkerMain, this, i);
+	}
+}
+
+Scheduler::~Scheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+
+		for (auto &token : m_running)
+		{
+			token.Cancel();
+		}
+	}
+
+	m_wake.notify_all();
+
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+CancelToken Scheduler::Submit(Priority priority, const Task &task)
+{
+	Entry entry;
+	entry.token = CancelToken::Create();
+	entry.task = task;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queues[priority].push_back(entry);
+	}
+
+	// Only some workers may take background tasks, waking one that can't
+	// would lose the wakeup.
+	m_wake.notify_all();
+	return entry.token;
+}
+
+auto Scheduler::GetStats() const -> Stats
+{
+	Stats stats;
+	stats.completed = m_completed;
+	stats.skipped = m_skipped;
+	stats.interrupted = m_interrupted;
+	stats.wastedMicroseconds = m_wasted;
+	stats.failed = m_failed;
+	return stats;
+}
+
+void Scheduler::WorkerMain(int worker)
+{
+	// With a single thread there's no thread to keep free.
+	auto backgroundLimit = m_threads > 1 ? m_threads - 1 : 1;
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		auto &interactive = m_queues[Interactive];
+		auto &background = m_queues[Background];
+		auto canTakeBackground = !background.empty() && m_runningBackground < backgroundLimit;
+
+		if (m_quit)
+		{
+			break;
+		}
+		else if (interactive.empty() && !canTakeBackground)
+		{
+			m_wake.wait(lock);
+			continue;
+		}
+
+		auto isBackground = interactive.empty();
+		auto &queue = isBackground ? background : interactive;
+		auto entry = queue.front();
+		queue.pop_front();
+
+		if (entry.token.IsCancelled())
+		{
+			m_skipped++;
+			continue;
+		}
+
+		m_running[worker] = entry.token;
+		m_runningBackground += isBackground;
+
+		lock.unlock();
+		Execute(entry);
+		lock.lock();
+
+		m_running[worker] = CancelToken();
+		m_runningBackground -= isBackground;
+
+		// A finished background task frees a slot another worker may be
+		// waiting on.
+		if (isBackground && !background.empty())
+		{
+			m_wake.notify_one();
+		}
+	}
+}
+
+void Scheduler::Execute(Entry &entry)
+{
+	auto start = std::chrono::steady_clock::now();
+
+	try
+	{
+		entry.task(entry.token);
+		m_completed++;
+	}
+	catch (const Cancelled &)
+	{
+		auto spent = std::chrono::steady_clock::now() - start;
+		m_interrupted++;
+		m_wasted += std::chrono::duration_cast<std::chrono::microseconds>(spent).count();
+	}
+	catch (...)
+	{
+		m_failed++;
+	}
+}
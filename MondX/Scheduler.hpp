@@ -0,0 +1,81 @@
+#ifndef MOND_SCHEDULER_HPP
+#define MOND_SCHEDULER_HPP
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include "CancelToken.hpp"
+
+namespace Mond
+{
+	// Runs cancellable tasks for interactive tools. Interactive tasks always
+	// go before background ones, and background tasks never take the last
+	// free thread, so a keystroke doesn't wait behind a whole-workspace job.
+	class Scheduler
+	{
+	public:
+		enum Priority
+		{
+			Interactive,
+			Background
+		};
+
+		typedef function<void (const CancelToken &token)> Task;
+
+		struct Stats
+		{
+			// Ran to the end.
+			uint64_t completed;
+			// Cancelled before they started, so they never ran.
+			uint64_t skipped;
+			// Cancelled while running, and how long they ran for nothing.
+			uint64_t interrupted;
+			uint64_t wastedMicroseconds;
+			// Threw something other than Cancelled.
+			uint64_t failed;
+		};
+
+		explicit Scheduler(int threads);
+
+		// Cancels whatever hasn't finished and waits for the threads.
+		~Scheduler();
+
+		// Queues a task and returns its token for cancelling it. Tasks should
+		// check the token and handle their own errors, anything they throw
+		// besides Cancelled is counted as failed and dropped.
+		CancelToken Submit(Priority priority, const Task &task);
+
+		Stats GetStats() const;
+	private:
+		Scheduler(const Scheduler &);
+		Scheduler &operator=(const Scheduler &);
+
+		struct Entry
+		{
+			CancelToken token;
+			Task task;
+		};
+
+		void WorkerMain(int worker);
+		void Execute(Entry &entry);
+
+		int m_threads;
+		vector<std::thread> m_workers;
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		deque<Entry> m_queues[2];
+		vector<CancelToken> m_running;
+		int m_runningBackground;
+		bool m_quit;
+
+		std::atomic<uint64_t> m_completed;
+		std::atomic<uint64_t> m_skipped;
+		std::atomic<uint64_t> m_interrupted;
+		std::atomic<uint64_t> m_wasted;
+		std::atomic<uint64_t> m_failed;
+	};
+}
+
+#endif
@@ -1,17 +1,44 @@
 #include "Sema.hpp"
+#include "FlowChecker.hpp"
+#include "BuiltinScope.hpp"
 #include "OperatorUtil.hpp"
 
 using namespace Mond;
 
-Sema::Sema(DiagBuilder &diag, ScopePtr builtinScope) :
+// ---------------------------------------------------------------------------
+// Sema interface
+// ---------------------------------------------------------------------------
+
+Sema::Sema(DiagBuilder &diag, BuiltinScopePtr builtinScope) :
 	m_root(new Scope()),
 	m_builtin(builtinScope),
-	m_diag(diag)
+	m_diag(diag),
+	m_completionTarget(NULL),
+	m_completionScope(NULL),
+	m_rechecking(false),
+	m_recheckFailed(false),
+	m_rootFrameSize(0)
 {
 	m_curr = m_root.get();
 	m_curr->type = Scope::Block;
+	m_curr->frame = m_curr;
 	m_curr->node = NULL;
-	m_curr->parent = builtinScope.get();
+	m_curr->parent = NULL;
+	m_curr->frameSize = 0;
+	m_curr->frameDepth = 0;
+}
+
+Sema::Sema(DiagBuilder &diag, BuiltinScopePtr builtinScope, ScopePtr root) :
+	m_curr(root.get()),
+	m_root(root),
+	m_builtin(builtinScope),
+	m_diag(diag),
+	m_completionTarget(NULL),
+	m_completionScope(NULL),
+	m_rechecking(false),
+	m_recheckFailed(false),
+	m_rootFrameSize(0)
+{
 }
 
 Sema::~Sema()
@@ -29,6 +56,20 @@ void Sema::PushScope(Scope::Type type, AstNodePtr node)
 	newScope->type = type;
 	newScope->node = node;
 	newScope->parent = m_curr;
+	newScope->frameSize = 0;
+
+	// Functions and sequences get their own frame of local slots, other
+	// scopes allocate their locals in the frame of whatever encloses them.
+	if (type == Scope::Function || type == Scope::Sequence)
+	{
+		newScope->frame = newScope.get();
+		newScope->frameDepth = m_curr->frame->frameDepth + 1;
+	}
+	else
+	{
+		newScope->frame = m_curr->frame;
+		newScope->frameDepth = m_curr->frameDepth;
+	}
 
 	m_curr->children.push_back(newScope);
 	m_curr = newScope.get();
@@ -39,86 +80,282 @@ void Sema::PopScope()
 	m_curr = m_curr->parent;
 }
 
-void Sema::Declare(Decl::Type type, Range range, const string &name, AstNodePtr node)
+Decl *Sema::Declare(Decl::Type type, Range range, const string &name, AstNodePtr node)
 {
-	bool builtin = false;
 	Scope *scope = m_curr;
 	do
 	{
 		auto it = scope->decls.find(name);
-		if (it != scope->decls.end())
+		if (it != scope->decls.end() && IsVisible(it->second))
 		{
-			if (!builtin)
-			{
-				m_diag
-					<< range
-					<< Error
-					<< SemaAlreadyDeclaredAt
-					<< name
-					<< it->second.range.beg.line
-					<< it->second.range.beg.column
-					<< DiagEnd;
-			}
-			else
-			{
-				m_diag
-					<< range
-					<< Error
-					<< SemaAlreadyDeclared
-					<< name
-					<< DiagEnd;
-			}
-
+			m_diag
+				<< range
+				<< Error
+				<< SemaAlreadyDeclaredAt
+				<< name
+				<< it->second.range.beg.line
+				<< it->second.range.beg.column
+				<< DiagEnd;
 			break;
 		}
 
 		scope = scope->parent;
-		if (scope == m_builtin.get())
-		{
-			builtin = true;
-		}
 	} while (scope != NULL);
 
+	if (scope == NULL && FindBuiltin(name))
+	{
+		m_diag
+			<< range
+			<< Error
+			<< SemaAlreadyDeclared
+			<< name
+			<< DiagEnd;
+	}
+
 	Decl decl;
+	decl.slot = m_curr->frame->frameSize++;
+	decl.arity = -1;
+	decl.varargs = false;
+	decl.captured = false;
+	decl.initialized = false;
 	decl.type = type;
 	decl.range = range;
 	decl.node = node;
-	m_curr->decls[name] = decl;
+	decl.scope = m_curr;
+
+	// The rest of the file points at the Decl a name at the top had, a
+	// recheck has to land on that one.
+	if (m_rechecking && m_curr == m_root.get())
+	{
+		auto it = m_root->decls.find(name);
+		m_recheckFailed |= it == m_root->decls.end() || it->second.slot != decl.slot;
+	}
+
+	auto &slot = m_curr->decls[name];
+	slot = decl;
+
+	if (m_flow && m_curr == m_root.get())
+	{
+		m_topLevelDecls.push_back(&slot);
+	}
+
+	return &slot;
+}
+
+void Sema::Check(StmtPtr file)
+{
+	auto block = dynamic_cast<StmtBlock *>(file.get());
+	if (!block)
+	{
+		throw invalid_argument("sema check expects a file block");
+	}
+
+	// The file block is the root scope itself, so only its statements are
+	// visited.
+	for (auto &stmt : block->statements)
+	{
+		m_cancel.Check();
+		AcceptChild(this, stmt.get());
+	}
+
+	m_cancel.Check();
+	Finish(block);
 }
 
+void Sema::CheckTopLevel(StmtPtr stmt)
+{
+	ReleaseTopLevel();
+
+	if (!m_flow)
+	{
+		m_flow.reset(new FlowChecker(m_diag));
+	}
+
+	m_cancel.Check();
+
+	if (stmt)
+	{
+		AcceptChild(this, stmt.get());
+		m_flow->CheckTopLevel(stmt.get(), m_root.get());
+	}
+}
+
+void Sema::FinishTopLevel()
+{
+	m_cancel.Check();
+	ReleaseTopLevel();
+
+	if (!m_flow)
+	{
+		m_flow.reset(new FlowChecker(m_diag));
+	}
+
+	m_flow->FinishTopLevel(m_root.get());
+}
+
+void Sema::CheckStatement(StmtPtr stmt)
+{
+	m_cancel.Check();
+	AcceptChild(this, stmt.get());
+}
+
+void Sema::BeginRecheck(int firstSlot)
+{
+	m_rechecking = true;
+	m_recheckFailed = false;
+	m_rootFrameSize = m_root->frameSize;
+	m_root->frameSize = firstSlot;
+}
+
+bool Sema::EndRecheck(int endSlot)
+{
+	auto ok = !m_recheckFailed && m_root->frameSize == endSlot;
+	m_root->frameSize = m_rootFrameSize;
+	m_rechecking = false;
+	return ok;
+}
+
+void Sema::SetCancelToken(const CancelToken &token)
+{
+	m_cancel = token;
+}
+
+Scope *Sema::Complete(StmtPtr file, const Expr *target)
+{
+	auto block = dynamic_cast<StmtBlock *>(file.get());
+	if (!block)
+	{
+		throw invalid_argument("sema complete expects a file block");
+	}
+
+	m_completionTarget = target;
+	m_completionScope = NULL;
+
+	for (auto &stmt : block->statements)
+	{
+		m_cancel.Check();
+		AcceptChild(this, stmt.get());
+	}
+
+	return m_completionScope;
+}
+
+void Sema::Finish(Stmt *file)
+{
+	FlowChecker checker(m_diag);
+	checker.Check(file, m_root.get());
+}
+
+// Declarations point back at their nodes, so the last statement's nodes are
+// let go here. Constants keep their value for folding.
+void Sema::ReleaseTopLevel()
+{
+	m_root->children.clear();
+
+	for (auto decl : m_topLevelDecls)
+	{
+		decl->node.reset();
+
+		if (decl->type != Decl::Constant)
+		{
+			decl->value.reset();
+		}
+	}
+
+	m_topLevelDecls.clear();
+}
+
+void Sema::DeclareArguments(const DeclNameList &arguments, AstNodePtr node)
+{
+	for (auto &argument : arguments)
+	{
+		Declare(Decl::Argument, argument.range, argument.name, node);
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Expressions
+// ---------------------------------------------------------------------------
+
 void Sema::Visit(Expr *)
 {
 	throw logic_error("unreachable in sema visit expr");
 }
 
-void Sema::Visit(ExprArrayLiteral *)
+void Sema::Visit(ExprArrayLiteral *expr)
 {
+	for (auto &elem : expr->elems)
+	{
+		AcceptChild(this, elem.get());
+	}
 }
 
-void Sema::Visit(ExprArraySlice *)
+void Sema::Visit(ExprArraySlice *expr)
 {
+	AcceptChild(this, expr->left.get());
+	AcceptChild(this, expr->start.get());
+	AcceptChild(this, expr->end.get());
+	AcceptChild(this, expr->step.get());
 }
 
 void Sema::Visit(ExprBinaryOp *expr)
 {
+	AcceptChild(this, expr->left.get());
+	AcceptChild(this, expr->right.get());
+
 	if (IsMutatingOperator(expr->type) && expr->left)
 	{
 		CheckMutable(expr->left.get());
 	}
 }
 
-void Sema::Visit(ExprCall *)
+void Sema::Visit(ExprCall *expr)
 {
+	AcceptChild(this, expr->left.get());
+
+	for (auto &arg : expr->args)
+	{
+		AcceptChild(this, arg.get());
+	}
 }
 
-void Sema::Visit(ExprFieldAccess *)
+void Sema::Visit(ExprFieldAccess *expr)
 {
+	if (expr == m_completionTarget)
+	{
+		m_completionScope = m_curr;
+	}
+
+	AcceptChild(this, expr->left.get());
 }
 
 void Sema::Visit(ExprId *expr)
 {
+	// What's being typed isn't a name yet.
+	if (expr == m_completionTarget)
+	{
+		m_completionScope = m_curr;
+		return;
+	}
+
 	Decl *decl = FindDecl(expr->name);
-	if (!decl)
+	if (decl)
+	{
+		expr->decl = decl;
+		expr->binding = Resolve(decl);
+
+		if (expr->binding.kind == Binding::Upvalue)
+		{
+			Capture(expr->name, decl, expr->binding.depth);
+		}
+
+		return;
+	}
+
+	expr->decl = FindBuiltin(expr->name);
+	expr->binding = Resolve(expr->decl);
+
+	if (!expr->decl)
 	{
 		m_diag
 			<< expr->range
@@ -129,20 +366,31 @@ void Sema::Visit(ExprId *expr)
 	}
 }
 
-void Sema::Visit(ExprIndexAccess *)
+void Sema::Visit(ExprIndexAccess *expr)
 {
+	AcceptChild(this, expr->left.get());
+	AcceptChild(this, expr->index.get());
 }
 
-void Sema::Visit(ExprLambda *)
+void Sema::Visit(ExprLambda *expr)
 {
+	auto node = expr->shared_from_this();
+	SemaScope scope(*this, expr->sequence ? Scope::Sequence : Scope::Function, node);
+
+	DeclareArguments(expr->arguments, node);
+	AcceptChild(this, expr->body.get());
 }
 
 void Sema::Visit(ExprNumberLiteral *)
 {
 }
 
-void Sema::Visit(ExprObjectLiteral *)
+void Sema::Visit(ExprObjectLiteral *expr)
 {
+	for (auto &entry : expr->entries)
+	{
+		AcceptChild(this, entry.value.get());
+	}
 }
 
 void Sema::Visit(ExprSimpleLiteral *)
@@ -153,12 +401,17 @@ void Sema::Visit(ExprStringLiteral *)
 {
 }
 
-void Sema::Visit(ExprTernaryOp *)
+void Sema::Visit(ExprTernaryOp *expr)
 {
+	AcceptChild(this, expr->cond.get());
+	AcceptChild(this, expr->thenExpr.get());
+	AcceptChild(this, expr->elseExpr.get());
 }
 
 void Sema::Visit(ExprUnaryOp *expr)
 {
+	AcceptChild(this, expr->value.get());
+
 	if (IsMutatingOperator(expr->type) && expr->value)
 	{
 		CheckMutable(expr->value.get());
@@ -167,6 +420,8 @@ void Sema::Visit(ExprUnaryOp *expr)
 
 void Sema::Visit(ExprYield *expr)
 {
+	AcceptChild(this, expr->value.get());
+
 	if (!IsInSeq())
 	{
 		m_diag
@@ -177,13 +432,24 @@ void Sema::Visit(ExprYield *expr)
 	}
 }
 
+// ---------------------------------------------------------------------------
+// Statements
+// ---------------------------------------------------------------------------
+
 void Sema::Visit(Stmt *)
 {
 	throw logic_error("unreachable in sema visit stmt");
 }
 
-void Sema::Visit(StmtBlock *)
+void Sema::Visit(StmtBlock *stmt)
 {
+	SemaScope scope(*this, Scope::Block, stmt->shared_from_this());
+
+	for (auto &child : stmt->statements)
+	{
+		m_cancel.Check();
+		AcceptChild(this, child.get());
+	}
 }
 
 void Sema::Visit(StmtControl *stmt)
@@ -199,42 +465,92 @@ void Sema::Visit(StmtControl *stmt)
 	}
 }
 
-void Sema::Visit(StmtDoWhile *)
+void Sema::Visit(StmtDoWhile *stmt)
 {
+	SemaScope scope(*this, Scope::Loop, stmt->shared_from_this());
+	AcceptChild(this, stmt->body.get());
+	AcceptChild(this, stmt->cond.get());
 }
 
-void Sema::Visit(StmtFor *)
+void Sema::Visit(StmtFor *stmt)
 {
+	SemaScope scope(*this, Scope::Loop, stmt->shared_from_this());
+	AcceptChild(this, stmt->init.get());
+	AcceptChild(this, stmt->cond.get());
+
+	for (auto &step : stmt->steps)
+	{
+		AcceptChild(this, step.get());
+	}
+
+	AcceptChild(this, stmt->body.get());
 }
 
-void Sema::Visit(StmtForeach *)
+// The loop variable is declared before the collection is resolved, same as
+// for var declarations.
+void Sema::Visit(StmtForeach *stmt)
 {
+	auto node = stmt->shared_from_this();
+	SemaScope scope(*this, Scope::Loop, node);
+
+	stmt->decl = Declare(Decl::Variable, stmt->name.range, stmt->name.name, node);
+	AcceptChild(this, stmt->from.get());
+	AcceptChild(this, stmt->body.get());
 }
 
-void Sema::Visit(StmtFunDecl *)
+// The function is declared in the enclosing scope before its body is
+// resolved so it can call itself.
+void Sema::Visit(StmtFunDecl *stmt)
 {
+	auto node = stmt->shared_from_this();
+	auto decl = Declare(stmt->sequence ? Decl::Sequence : Decl::Function, stmt->name.range, stmt->name.name, node);
+	decl->arity = stmt->arguments.size();
+	decl->varargs = stmt->varargs;
+	stmt->decl = decl;
+
+	SemaScope scope(*this, stmt->sequence ? Scope::Sequence : Scope::Function, node);
+	DeclareArguments(stmt->arguments, node);
+	AcceptChild(this, stmt->body.get());
 }
 
-void Sema::Visit(StmtIfElse *)
+void Sema::Visit(StmtIfElse *stmt)
 {
+	SemaScope scope(*this, Scope::Block, stmt->shared_from_this());
+	AcceptChild(this, stmt->cond.get());
+	AcceptChild(this, stmt->thenBody.get());
+	AcceptChild(this, stmt->elseBody.get());
 }
 
-void Sema::Visit(StmtNakedExpr *)
+void Sema::Visit(StmtNakedExpr *stmt)
 {
+	AcceptChild(this, stmt->value.get());
 }
 
-void Sema::Visit(StmtReturn *)
+void Sema::Visit(StmtReturn *stmt)
 {
+	AcceptChild(this, stmt->value.get());
 }
 
 void Sema::Visit(StmtSwitch *stmt)
 {
+	SemaScope scope(*this, Scope::Block, stmt->shared_from_this());
+	AcceptChild(this, stmt->value.get());
+
+	for (auto &switchCase : stmt->cases)
+	{
+		AcceptChild(this, switchCase.value.get());
+
+		for (auto &child : switchCase.body)
+		{
+			AcceptChild(this, child.get());
+		}
+	}
+
 	Pos defaultPos;
 
 	for (auto &switchCase : stmt->cases)
 	{
 		// TODO: Check case uniqueness.
-		// TODO: Fold values before checking that they're constant.
 
 		if (switchCase.def && defaultPos.IsValid())
 		{
@@ -246,7 +562,7 @@ void Sema::Visit(StmtSwitch *stmt)
 				<< defaultPos.column
 				<< DiagEnd;
 		}
-		else if (switchCase.value && !switchCase.value->IsConstant())
+		else if (switchCase.value && !m_folder.Fold(switchCase.value.get()))
 		{
 			m_diag
 				<< switchCase.value->range
@@ -262,14 +578,39 @@ void Sema::Visit(StmtSwitch *stmt)
 	}
 }
 
-void Sema::Visit(StmtVarDecl *)
+// Each name is declared before its initializer is resolved, so an
+// initializer sees the variable it initializes and every one before it.
+void Sema::Visit(StmtVarDecl *stmt)
 {
+	auto node = stmt->shared_from_this();
+	auto type = stmt->type == KwConst ? Decl::Constant : Decl::Variable;
+
+	stmt->decls.clear();
+
+	for (size_t i = 0; i < stmt->names.size(); i++)
+	{
+		auto decl = Declare(type, stmt->names[i].range, stmt->names[i].name, node);
+		stmt->decls.push_back(decl);
+
+		if (i < stmt->values.size() && stmt->values[i])
+		{
+			AcceptChild(this, stmt->values[i].get());
+			decl->value = stmt->values[i];
+		}
+	}
 }
 
-void Sema::Visit(StmtWhile *)
+void Sema::Visit(StmtWhile *stmt)
 {
+	SemaScope scope(*this, Scope::Loop, stmt->shared_from_this());
+	AcceptChild(this, stmt->cond.get());
+	AcceptChild(this, stmt->body.get());
 }
 
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
 bool Sema::IsInSeq() const
 {
 	Scope *scope = m_curr;
@@ -331,7 +672,7 @@ void Sema::CheckMutable(Expr *expr) const
 		return;
 	}
 
-	auto decl = FindDecl(id->name);
+	auto decl = id->decl;
 	if (decl && decl->type == Decl::Constant)
 	{
 		m_diag
@@ -345,13 +686,21 @@ void Sema::CheckMutable(Expr *expr) const
 	}
 }
 
+// The root frame's slots go in declaration order, so outside of a recheck
+// everything in the root scope is below its frame size. During one, the
+// statements from there on haven't been checked again yet.
+bool Sema::IsVisible(const Decl &decl) const
+{
+	return decl.scope != m_root.get() || decl.slot < m_root->frameSize;
+}
+
 Decl *Sema::FindDecl(const string &name) const
 {
 	Scope *scope = m_curr;
 	do
 	{
 		auto it = scope->decls.find(name);
-		if (it != scope->decls.end())
+		if (it != scope->decls.end() && IsVisible(it->second))
 		{
 			return &it->second;
 		}
@@ -361,3 +710,113 @@ Decl *Sema::FindDecl(const string &name) const
 
 	return NULL;
 }
+
+const Decl *Sema::FindBuiltin(const string &name) const
+{
+	return m_builtin ? m_builtin->Find(name) : NULL;
+}
+
+Binding Sema::Resolve(const Decl *decl) const
+{
+	Binding binding;
+
+	if (!decl)
+	{
+		return binding;
+	}
+
+	binding.index = decl->slot;
+
+	if (!decl->scope)
+	{
+		binding.kind = Binding::Builtin;
+	}
+	else if (decl->scope->frame == m_curr->frame)
+	{
+		binding.kind = Binding::Local;
+	}
+	else
+	{
+		binding.kind = Binding::Upvalue;
+		binding.depth = m_curr->frame->frameDepth - decl->scope->frame->frameDepth;
+	}
+
+	return binding;
+}
+
+void Sema::Capture(const string &name, Decl *decl, int depth)
+{
+	auto &captures = m_curr->frame->captures;
+	for (auto &capture : captures)
+	{
+		if (capture.decl == decl)
+		{
+			return;
+		}
+	}
+
+	Mond::Capture capture;
+	capture.depth = depth;
+	capture.decl = decl;
+	capture.name = name;
+	captures.push_back(capture);
+
+	decl->captured = true;
+}
+
+bool Mond::CanUseStackSlot(const Decl &decl)
+{
+	// Sequence locals have to outlive each yield, so they never go on the stack.
+	return !decl.captured && decl.scope->frame->type != Scope::Sequence;
+}
+
+const char *Mond::GetDeclTypeName(Decl::Type type)
+{
+	switch (type)
+	{
+	case Decl::Variable:
+		return "var";
+	case Decl::Constant:
+		return "const";
+	case Decl::Function:
+		return "fun";
+	case Decl::Sequence:
+		return "seq";
+	case Decl::Argument:
+		return "argument";
+	}
+
+	throw invalid_argument("unknown declaration type");
+}
+
+Decl::Type Mond::GetDeclType(TokenType keyword)
+{
+	switch (keyword)
+	{
+	case KwVar:
+		return Decl::Variable;
+	case KwConst:
+		return Decl::Constant;
+	case KwFun:
+		return Decl::Function;
+	case KwSeq:
+		return Decl::Sequence;
+	default:
+		throw invalid_argument("not a declaring keyword");
+	}
+}
+
+void Mond::CollectTopLevelNames(Stmt *stmt, vector<pair<string, TokenType>> &names)
+{
+	if (auto var = dynamic_cast<StmtVarDecl *>(stmt))
+	{
+		for (auto &name : var->names)
+		{
+			names.push_back(std::make_pair(name.name, var->type));
+		}
+	}
+	else if (auto fun = dynamic_cast<StmtFunDecl *>(stmt))
+	{
+		names.push_back(std::make_pair(fun->name.name, fun->sequence ? KwSeq : KwFun));
+	}
+}
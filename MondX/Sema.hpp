@@ -2,6 +2,8 @@
 #define MOND_SEMA_HPP
 
 #include "AST.hpp"
+#include "CancelToken.hpp"
+#include "ConstFolder.hpp"
 #include "DiagBuilder.hpp"
 
 namespace Mond
@@ -17,14 +19,32 @@ namespace Mond
 			Argument
 		};
 
+		int slot;
+		int arity;
+		bool varargs;
+		bool captured;
+		// Every read is known to follow a store, so the slot never needs to be
+		// checked for a missing value. Set by the flow checker.
+		bool initialized;
 		Type type;
 		Range range;
+		ExprPtr value;
 		AstNodePtr node;
+		struct Scope *scope;
+	};
+
+	struct Capture
+	{
+		int depth;
+		Decl *decl;
+		string name;
 	};
 
 	typedef shared_ptr<struct Scope> ScopePtr;
 	typedef vector<ScopePtr> ScopePtrList;
 
+	typedef shared_ptr<const class BuiltinScope> BuiltinScopePtr;
+
 	struct Scope
 	{
 		enum Type
@@ -36,16 +56,37 @@ namespace Mond
 		};
 
 		Type type;
+		Scope *frame;
 		Scope *parent;
 		AstNodePtr node;
+		int frameSize;
+		int frameDepth;
 		ScopePtrList children;
+		vector<Capture> captures;
 		unordered_map<string, Decl> decls;
 	};
 
+	bool CanUseStackSlot(const Decl &decl);
+
+	// The keyword that declares the type, "argument" for arguments.
+	const char *GetDeclTypeName(Decl::Type type);
+
+	// The type a var, const, fun or seq keyword declares.
+	Decl::Type GetDeclType(TokenType keyword);
+
+	// Adds the names a top-level statement declares, with the keyword
+	// declaring each, the way FindSkips lists them before a TopLevel.
+	void CollectTopLevelNames(Stmt *stmt, vector<pair<string, TokenType>> &names);
+
+	class FlowChecker;
+
 	class Sema : public Visitor
 	{
 	public:
-		Sema(DiagBuilder &diag, ScopePtr builtinScope);
+		Sema(DiagBuilder &diag, BuiltinScopePtr builtinScope);
+
+		// Goes on in a root scope another Sema left, see BeginRecheck.
+		Sema(DiagBuilder &diag, BuiltinScopePtr builtinScope, ScopePtr root);
 		~Sema();
 
 		ScopePtr RootScope() const;
@@ -53,7 +94,41 @@ namespace Mond
 		void PushScope(Scope::Type type, AstNodePtr node);
 		void PopScope();
 
-		void Declare(Decl::Type type, Range range, const string &name, AstNodePtr node);
+		Decl *Declare(Decl::Type type, Range range, const string &name, AstNodePtr node);
+
+		// Declares and resolves everything in a parsed file and checks it. The
+		// tree only has to come from the parser, so parsing the next file can
+		// overlap with checking this one.
+		void Check(StmtPtr file);
+
+		// Checks a file one top-level statement at a time, so the tree never
+		// has to be kept whole. What a statement declares at the top stays in
+		// the root scope, the scopes inside it only until the next statement
+		// is checked, and the tree itself isn't held on to at all.
+		void CheckTopLevel(StmtPtr stmt);
+		void FinishTopLevel();
+
+		// Checks one top-level statement after the ones checked before it
+		// and leaves the flow checks to the caller, for CheckedFile which
+		// keeps what each statement made apart.
+		void CheckStatement(StmtPtr stmt);
+
+		// Statements checked between these replace others in a root scope
+		// that already holds the whole file. They take the root slots from
+		// firstSlot on again and only see what's declared in the slots before
+		// theirs. EndRecheck is false unless they declared the same names at
+		// the top in the same slots up to endSlot, then the Decls the rest of
+		// the file points at were reused and are still good.
+		void BeginRecheck(int firstSlot);
+		bool EndRecheck(int endSlot);
+
+		// Checked before every statement and before the flow checks.
+		void SetCancelToken(const CancelToken &token);
+
+		// Declares and resolves a file the parser cut off at a completion
+		// point, without the flow checks. Returns the scope the completion
+		// expression is in, or NULL if it isn't in the file.
+		Scope *Complete(StmtPtr file, const Expr *target);
 
 		virtual void Visit(Expr *);
 		virtual void Visit(ExprArrayLiteral *);
@@ -86,16 +161,34 @@ namespace Mond
 		virtual void Visit(StmtVarDecl *);
 		virtual void Visit(StmtWhile *);
 	private:
+		// Runs the checks that need the whole file to be parsed and resolved.
+		void Finish(Stmt *file);
+		void DeclareArguments(const DeclNameList &arguments, AstNodePtr node);
+		void ReleaseTopLevel();
+
 		bool IsInSeq() const;
 		bool IsInLoop() const;
 		void CheckMutable(Expr *expr) const;
 
+		bool IsVisible(const Decl &decl) const;
 		Decl *FindDecl(const string &name) const;
+		const Decl *FindBuiltin(const string &name) const;
+		Binding Resolve(const Decl *decl) const;
+		void Capture(const string &name, Decl *decl, int depth);
 
 		Scope *m_curr;
 		ScopePtr m_root;
-		ScopePtr m_builtin;
+		BuiltinScopePtr m_builtin;
 		DiagBuilder &m_diag;
+		ConstFolder m_folder;
+		unique_ptr<FlowChecker> m_flow;
+		vector<Decl *> m_topLevelDecls;
+		CancelToken m_cancel;
+		const Expr *m_completionTarget;
+		Scope *m_completionScope;
+		bool m_rechecking;
+		bool m_recheckFailed;
+		int m_rootFrameSize;
 	};
 
 	class SemaScope
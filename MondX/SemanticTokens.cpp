@@ -0,0 +1,252 @@
+#include <algorithm>
+#include "Parser.hpp"
+#include "SemanticTokens.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static void collectDecls(const Scope *scope, vector<const Decl *> &decls)
+{
+	for (auto &entry : scope->decls)
+	{
+		if (entry.second.range.IsValid())
+		{
+			decls.push_back(&entry.second);
+		}
+	}
+
+	for (auto &child : scope->children)
+	{
+		collectDecls(child.get(), decls);
+	}
+}
+
+// Where line starts, the end of text if there's no such line.
+static SourceInt lineOffset(const string &text, SourceInt line)
+{
+	if (line <= 1)
+	{
+		return 0;
+	}
+
+	SourceInt current = 1;
+
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (IsLineBreak(text, i) && ++current == line)
+		{
+			return i + 1;
+		}
+	}
+
+	return text.size();
+}
+
+static bool isKeyword(TokenType type)
+{
+	return type >= KwGlobal && type <= KwDefault;
+}
+
+// A name after a dot, or an object literal key.
+static bool isField(const vector<Token> &tokens, size_t i)
+{
+	if (i == 0)
+	{
+		return false;
+	}
+
+	auto prev = tokens[i - 1].type;
+	auto next = i + 1 < tokens.size() ? tokens[i + 1].type : TokEndOfFile;
+
+	return prev == OpDot || ((prev == TokLeftBrace || prev == TokComma) && next == TokColon);
+}
+
+static void classifyDecl(const Decl *decl, uint32_t &type, uint32_t &modifiers)
+{
+	switch (decl->type)
+	{
+	case Decl::Variable: type = SemanticToken::Variable; break;
+	case Decl::Constant: type = SemanticToken::Constant; modifiers |= SemanticToken::Readonly; break;
+	case Decl::Function: type = SemanticToken::Function; break;
+	case Decl::Sequence: type = SemanticToken::Function; break;
+	case Decl::Argument: type = SemanticToken::Argument; break;
+	}
+
+	if (!decl->scope)
+	{
+		modifiers |= SemanticToken::Builtin;
+	}
+}
+
+// Parses the statements from where topLevel starts to the last one starting
+// by lastLine, with skips passed over, and resolves those reaching firstLine
+// with the names declared before declared first, keeping the tokens the
+// parser saw. Then walks them alongside the names and declarations Sema
+// found, which all come in position order once sorted.
+static vector<uint32_t> classify(const string &text, const vector<Slice> &skips, TopLevel &topLevel, SourceInt firstLine, SourceInt lastLine, BuiltinScopePtr builtinScope, const CancelToken &token)
+{
+	vector<Token> tokens;
+
+	DiagBuilder diag;
+	StringSource source(text.c_str());
+	Lexer lexer(diag, source);
+	lexer.SetSkips(skips);
+	lexer.SetTokenLog(&tokens);
+	lexer.SetCancelToken(token);
+	lexer.SetPosition(topLevel.offset, topLevel.pos);
+
+	Parser parser(diag, source, lexer);
+	parser.SetCancelToken(token);
+
+	shared_ptr<StmtBlock> file(new StmtBlock());
+
+	// The statements ending before the lines only count for what they
+	// declare.
+	while (parser.CurrentToken().type != TokEndOfFile && parser.CurrentToken().range.beg.line <= lastLine)
+	{
+		auto stmt = parser.ParseStmt();
+
+		if (!stmt)
+		{
+			continue;
+		}
+		else if (stmt->range.IsValid() && stmt->range.end.line < firstLine)
+		{
+			CollectTopLevelNames(stmt.get(), topLevel.names);
+		}
+		else
+		{
+			file->statements.push_back(stmt);
+		}
+	}
+
+	// Only what names resolve to matters, so the flow checks are left out.
+	Sema sema(diag, builtinScope);
+	sema.SetCancelToken(token);
+
+	for (auto &name : topLevel.names)
+	{
+		sema.Declare(GetDeclType(name.second), Range(), name.first, nullptr);
+	}
+
+	sema.Complete(file, NULL);
+
+	auto ids = CollectIds(file.get());
+	vector<const Decl *> decls;
+	collectDecls(sema.RootScope().get(), decls);
+
+	std::sort(ids.begin(), ids.end(), [](const ExprId *a, const ExprId *b)
+	{
+		return a->range.beg < b->range.beg;
+	});
+
+	std::sort(decls.begin(), decls.end(), [](const Decl *a, const Decl *b)
+	{
+		return a->range.beg < b->range.beg;
+	});
+
+	vector<uint32_t> data;
+	size_t nextId = 0;
+	size_t nextDecl = 0;
+	Pos prev(1, 1);
+
+	for (size_t i = 0; i < tokens.size(); i++)
+	{
+		auto &range = tokens[i].range;
+		auto tokenType = tokens[i].type;
+
+		while (nextId < ids.size() && ids[nextId]->range.beg < range.beg)
+		{
+			nextId++;
+		}
+
+		while (nextDecl < decls.size() && decls[nextDecl]->range.beg < range.beg)
+		{
+			nextDecl++;
+		}
+
+		if (range.beg.line != range.end.line || range.beg.line < firstLine || range.beg.line > lastLine)
+		{
+			continue;
+		}
+
+		uint32_t type = 0;
+		uint32_t modifiers = 0;
+
+		if (isKeyword(tokenType))
+		{
+			type = SemanticToken::Keyword;
+		}
+		else if (tokenType == TokNumberLiteral)
+		{
+			type = SemanticToken::Number;
+		}
+		else if (tokenType == TokStringLiteral)
+		{
+			type = SemanticToken::String;
+		}
+		else if (tokenType != TokIdentifier)
+		{
+			continue;
+		}
+		else if (nextDecl < decls.size() && decls[nextDecl]->range.beg == range.beg)
+		{
+			classifyDecl(decls[nextDecl], type, modifiers);
+			modifiers |= SemanticToken::Declaration;
+		}
+		else if (nextId < ids.size() && ids[nextId]->range.beg == range.beg)
+		{
+			if (!ids[nextId]->decl)
+			{
+				continue;
+			}
+
+			classifyDecl(ids[nextId]->decl, type, modifiers);
+		}
+		else if (isField(tokens, i))
+		{
+			type = SemanticToken::Field;
+		}
+		else
+		{
+			continue;
+		}
+
+		data.push_back(range.beg.line - prev.line);
+		data.push_back(range.beg.column - (range.beg.line == prev.line ? prev.column : 1));
+		data.push_back(range.end.column - range.beg.column);
+		data.push_back(type);
+		data.push_back(modifiers);
+		prev = range.beg;
+	}
+
+	return data;
+}
+
+// ---------------------------------------------------------------------------
+// Semantic tokens
+// ---------------------------------------------------------------------------
+
+vector<uint32_t> Mond::ClassifyTokens(const string &text, BuiltinScopePtr builtinScope, const CancelToken &token)
+{
+	TopLevel topLevel;
+	topLevel.offset = 0;
+	topLevel.pos = Pos(1, 1);
+
+	return classify(text, vector<Slice>(), topLevel, 1, std::numeric_limits<SourceInt>::max(), builtinScope, token);
+}
+
+vector<uint32_t> Mond::ClassifyTokens(const string &text, SourceInt firstLine, SourceInt lastLine, BuiltinScopePtr builtinScope, const CancelToken &token)
+{
+	if (firstLine > lastLine)
+	{
+		return vector<uint32_t>();
+	}
+
+	TopLevel topLevel;
+	auto skips = FindSkips(text, lineOffset(text, firstLine), lineOffset(text, lastLine + 1), nullptr, &topLevel);
+	return classify(text, skips, topLevel, firstLine, lastLine, builtinScope, token);
+}
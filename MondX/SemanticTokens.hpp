@@ -0,0 +1,53 @@
+#ifndef MOND_SEMANTIC_TOKENS_HPP
+#define MOND_SEMANTIC_TOKENS_HPP
+
+#include "BuiltinScope.hpp"
+#include "CancelToken.hpp"
+
+namespace Mond
+{
+	struct SemanticToken
+	{
+		// Sequences are functions as far as highlighting goes.
+		enum Type
+		{
+			Keyword,
+			Variable,
+			Constant,
+			Function,
+			Argument,
+			Field,
+			Number,
+			String
+		};
+
+		// Bits, constants are always readonly.
+		enum Modifier
+		{
+			Declaration = 1,
+			Builtin = 2,
+			Readonly = 4
+		};
+	};
+
+	// Classifies every keyword, literal and name in text in one parse, names
+	// by what Sema resolved them to. Undeclared names, operators and anything
+	// spanning lines are left out.
+	//
+	// Five numbers a token, in file order: the line it's on, relative to the
+	// previous token's line, its column, relative to the previous token's if
+	// they're on the same line, then its length, type and modifiers. The
+	// first token is relative to line 1, column 1. Columns and lengths are in
+	// bytes.
+	vector<uint32_t> ClassifyTokens(const string &text, BuiltinScopePtr builtinScope, const CancelToken &token = CancelToken());
+
+	// The same for the tokens on lines firstLine to lastLine. Only the
+	// top-level statements reaching into them are resolved, those before
+	// count for the names they declare, which scanning the file finds up to
+	// the first syntax error, the statements from there on are parsed for
+	// them. So on a file that parses, the cost is the scan plus what's on
+	// the lines.
+	vector<uint32_t> ClassifyTokens(const string &text, SourceInt firstLine, SourceInt lastLine, BuiltinScopePtr builtinScope, const CancelToken &token = CancelToken());
+}
+
+#endif
@@ -7,10 +7,10 @@ StringSource::StringSource(const char *str) : m_beg(str), m_ptr(str)
 }
 
 // TODO: I probably suck, fix me.
-string StringSource::GetLine(int line) const
+string StringSource::GetLine(SourceInt line) const
 {
-	auto rpos = 0;
-	auto cline = 1;
+	SourceInt rpos = 0;
+	SourceInt cline = 1;
 	stringstream buffer;
 
 	while (true)
@@ -53,7 +53,7 @@ string StringSource::GetSlice(Slice s) const
 // TODO: I probably suck, fix me.
 string StringSource::GetRange(Range r) const
 {
-	auto rpos = 0;
+	SourceInt rpos = 0;
 
 	Pos pos(1, 1);
 	Slice slice;
@@ -110,11 +110,16 @@ void StringSource::Advance()
 	m_ptr++;
 }
 
-int StringSource::Position() const
+SourceInt StringSource::Position() const
 {
 	return m_ptr - m_beg;
 }
 
+void StringSource::Seek(SourceInt position)
+{
+	m_ptr = m_beg + position;
+}
+
 uint32_t StringSource::Cur() const
 {
 	return m_ptr[0];
@@ -130,11 +135,28 @@ FileSource::FileSource(const string &filename)
 	ifstream file;
 	file.exceptions(std::ios::badbit | std::ios::failbit);
 	file.open(filename);
-	m_contents = string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	file.seekg(0, std::ios::end);
+	auto size = (size_t)file.tellg();
+	file.seekg(0, std::ios::beg);
+
+	// Offsets past the end of SourceInt would wrap around, refuse up front.
+	if (size >= (size_t)std::numeric_limits<SourceInt>::max())
+	{
+		throw invalid_argument("source too large, build with MONDX_LARGE_SOURCES");
+	}
+
+	m_contents.reserve(size);
+	m_contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 	m_source.reset(new StringSource(m_contents.c_str()));
 }
 
-string FileSource::GetLine(int line) const
+const string &FileSource::Contents() const
+{
+	return m_contents;
+}
+
+string FileSource::GetLine(SourceInt line) const
 {
 	return m_source->GetLine(line);
 }
@@ -154,11 +176,16 @@ void FileSource::Advance()
 	m_source->Advance();
 }
 
-int FileSource::Position() const
+SourceInt FileSource::Position() const
 {
 	return m_source->Position();
 }
 
+void FileSource::Seek(SourceInt position)
+{
+	m_source->Seek(position);
+}
+
 uint32_t FileSource::Cur() const
 {
 	return m_source->Cur();
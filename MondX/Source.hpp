@@ -8,12 +8,15 @@ namespace Mond
 	class Source
 	{
 	public:
-		virtual string GetLine(int line) const = 0;
+		virtual string GetLine(SourceInt line) const = 0;
 		virtual string GetSlice(Slice s) const = 0;
 		virtual string GetRange(Range r) const = 0;
 
 		virtual void Advance() = 0;
-		virtual int Position() const = 0;
+		virtual SourceInt Position() const = 0;
+
+		// Moves straight to a position no further than the end.
+		virtual void Seek(SourceInt position) = 0;
 
 		virtual uint32_t Cur() const = 0;
 		virtual uint32_t Peek() const = 0;
@@ -24,12 +27,13 @@ namespace Mond
 	public:
 		StringSource(const char *str);
 
-		string GetLine(int line) const;
+		string GetLine(SourceInt line) const;
 		string GetSlice(Slice s) const;
 		string GetRange(Range r) const;
 
 		void Advance();
-		int Position() const;
+		SourceInt Position() const;
+		void Seek(SourceInt position);
 
 		uint32_t Cur() const;
 		uint32_t Peek() const;
@@ -43,12 +47,15 @@ namespace Mond
 	public:
 		FileSource(const string &filename);
 
-		string GetLine(int line) const;
+		const string &Contents() const;
+
+		string GetLine(SourceInt line) const;
 		string GetSlice(Slice s) const;
 		string GetRange(Range r) const;
 
 		void Advance();
-		int Position() const;
+		SourceInt Position() const;
+		void Seek(SourceInt position);
 
 		uint32_t Cur() const;
 		uint32_t Peek() const;
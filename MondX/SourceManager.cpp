@@ -0,0 +1,376 @@
+#include <cstring>
+#include <algorithm>
+#include "Hash.hpp"
+#include "MappedFile.hpp"
+#include "SourceManager.hpp"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// SourceBuffer
+// ---------------------------------------------------------------------------
+
+class Mond::SourceBuffer
+{
+public:
+	explicit SourceBuffer(const string &contents) :
+		m_contents(contents),
+		m_data(m_contents.c_str()),
+		m_size(m_contents.size())
+	{
+		m_hash = HashBytes(m_data, m_size);
+	}
+
+	explicit SourceBuffer(unique_ptr<MappedFile> file) :
+		m_file(std::move(file)),
+		m_data(m_file->Data()),
+		m_size(m_file->Size())
+	{
+		m_hash = HashBytes(m_data, m_size);
+	}
+
+	const char *Data() const
+	{
+		return m_data;
+	}
+
+	size_t Size() const
+	{
+		return m_size;
+	}
+
+	uint64_t Hash() const
+	{
+		return m_hash;
+	}
+
+	bool SameContents(const SourceBuffer &other) const
+	{
+		return m_size == other.m_size && memcmp(m_data, other.m_data, m_size) == 0;
+	}
+
+	// Offsets where lines start, built the first time a position is asked
+	// for since most files never need one.
+	const vector<SourceInt> &LineStarts() const
+	{
+		std::call_once(m_linesOnce, [this]()
+		{
+			m_lines.push_back(0);
+
+			for (size_t i = 0; i < m_size; i++)
+			{
+				auto ch = m_data[i];
+
+				if (ch == '\n' || (ch == '\r' && m_data[i + 1] != '\n'))
+				{
+					m_lines.push_back((SourceInt)(i + 1));
+				}
+			}
+		});
+
+		return m_lines;
+	}
+private:
+	unique_ptr<MappedFile> m_file;
+	string m_contents;
+	const char *m_data;
+	size_t m_size;
+	uint64_t m_hash;
+
+	mutable std::once_flag m_linesOnce;
+	mutable vector<SourceInt> m_lines;
+};
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+static bool HasTerminator(const MappedFile &file)
+{
+	// A mapping is zero filled from the end of the file to the end of its
+	// last page, which leaves no room when the file fills that page.
+#ifndef _WIN32
+	return !file.IsMapped() || file.Size() % sysconf(_SC_PAGESIZE) != 0;
+#else
+	return true;
+#endif
+}
+
+static void CheckSize(size_t size)
+{
+	if (size >= (size_t)std::numeric_limits<SourceInt>::max())
+	{
+		throw invalid_argument("source too large, build with MONDX_LARGE_SOURCES");
+	}
+}
+
+// ---------------------------------------------------------------------------
+// SourceManager
+// ---------------------------------------------------------------------------
+
+SourceManager::SourceManager() : m_next(1)
+{
+}
+
+SourceManager::~SourceManager()
+{
+}
+
+FileId SourceManager::Load(const string &filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_byName.find(filename);
+
+		if (it != m_byName.end())
+		{
+			m_files[it->second - 1].loads++;
+			return it->second;
+		}
+	}
+
+	// Reading and hashing happen outside the lock, so other threads can load
+	// files at the same time.
+	unique_ptr<MappedFile> file(new MappedFile(filename));
+	shared_ptr<SourceBuffer> buffer;
+
+	if (!file->IsValid())
+	{
+		throw invalid_argument("can't read source file '" + filename + "'");
+	}
+
+	CheckSize(file->Size());
+
+	if (file->Size() > 0 && HasTerminator(*file))
+	{
+		buffer = std::make_shared<SourceBuffer>(std::move(file));
+	}
+	else
+	{
+		buffer = std::make_shared<SourceBuffer>(string(file->Data(), file->Size()));
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto it = m_byName.find(filename);
+
+	if (it != m_byName.end())
+	{
+		m_files[it->second - 1].loads++;
+		return it->second;
+	}
+
+	auto id = Insert(filename, buffer);
+	m_byName[filename] = id;
+	return id;
+}
+
+FileId SourceManager::Add(const string &name, const string &contents)
+{
+	CheckSize(contents.size());
+	auto buffer = std::make_shared<SourceBuffer>(contents);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return Insert(name, buffer);
+}
+
+void SourceManager::Release(FileId file)
+{
+	shared_ptr<SourceBuffer> buffer;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (file == 0 || file > m_files.size() || !m_files[file - 1].buffer)
+		{
+			throw invalid_argument("invalid file id");
+		}
+
+		auto &entry = m_files[file - 1];
+
+		if (--entry.loads > 0)
+		{
+			return;
+		}
+
+		auto it = m_byName.find(entry.name);
+
+		if (it != m_byName.end() && it->second == file)
+		{
+			m_byName.erase(it);
+		}
+
+		buffer.swap(entry.buffer);
+
+		// A buffer other files still share stays findable.
+		if (buffer.use_count() == 1)
+		{
+			auto hash = buffer->Hash();
+			auto &same = m_byHash[hash];
+			same.erase(std::remove_if(same.begin(), same.end(), [&](const std::weak_ptr<SourceBuffer> &other)
+			{
+				return other.expired() || other.lock() == buffer;
+			}), same.end());
+
+			if (same.empty())
+			{
+				m_byHash.erase(hash);
+			}
+		}
+	}
+
+	// Unmapping happens outside the lock.
+	buffer.reset();
+}
+
+size_t SourceManager::FileCount() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_files.size();
+}
+
+const string &SourceManager::GetName(FileId file) const
+{
+	return GetEntry(file).name;
+}
+
+uint64_t SourceManager::GetHash(FileId file) const
+{
+	return GetBuffer(file).Hash();
+}
+
+const char *SourceManager::GetData(FileId file) const
+{
+	return GetBuffer(file).Data();
+}
+
+SourceInt SourceManager::GetSize(FileId file) const
+{
+	return (SourceInt)GetBuffer(file).Size();
+}
+
+StringSource SourceManager::GetSource(FileId file) const
+{
+	return StringSource(GetData(file));
+}
+
+SourceLocation SourceManager::GetLocation(FileId file, SourceInt offset) const
+{
+	auto &entry = GetEntry(file);
+
+	if (offset < 0 || (size_t)offset > GetBuffer(file).Size())
+	{
+		throw invalid_argument("offset outside of file");
+	}
+
+	return entry.base + (SourceLocation)offset;
+}
+
+FileId SourceManager::GetFile(SourceLocation loc) const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (loc == 0 || loc >= m_next)
+	{
+		throw invalid_argument("invalid source location");
+	}
+
+	// Files are laid out in id order, the last base not past loc is the one.
+	auto it = std::upper_bound(m_bases.begin(), m_bases.end(), loc);
+	return (FileId)(it - m_bases.begin());
+}
+
+SourceInt SourceManager::GetOffset(SourceLocation loc) const
+{
+	return (SourceInt)(loc - GetEntry(GetFile(loc)).base);
+}
+
+Pos SourceManager::GetPos(SourceLocation loc) const
+{
+	auto file = GetFile(loc);
+	return GetPos(file, (SourceInt)(loc - GetEntry(file).base));
+}
+
+Pos SourceManager::GetPos(FileId file, SourceInt offset) const
+{
+	auto &buffer = GetBuffer(file);
+
+	if (offset < 0 || (size_t)offset > buffer.Size())
+	{
+		throw invalid_argument("offset outside of file");
+	}
+
+	auto &lines = buffer.LineStarts();
+	auto line = std::upper_bound(lines.begin(), lines.end(), offset) - lines.begin();
+	return Pos((SourceInt)line, offset - lines[line - 1] + 1);
+}
+
+FileId SourceManager::Insert(const string &name, shared_ptr<SourceBuffer> buffer)
+{
+	// Every file gets one location past its end for the end of file token.
+	auto size = buffer->Size();
+	if (size >= (size_t)(std::numeric_limits<SourceLocation>::max() - m_next))
+	{
+		throw invalid_argument("source locations exhausted");
+	}
+
+	auto &same = m_byHash[buffer->Hash()];
+	auto shared = false;
+
+	for (auto &weak : same)
+	{
+		auto other = weak.lock();
+
+		if (other && other->SameContents(*buffer))
+		{
+			buffer = other;
+			shared = true;
+			break;
+		}
+	}
+
+	if (!shared)
+	{
+		same.push_back(buffer);
+	}
+
+	File entry;
+	entry.name = name;
+	entry.base = m_next;
+	entry.loads = 1;
+	entry.buffer = buffer;
+
+	m_files.push_back(entry);
+	m_bases.push_back(m_next);
+	m_next += (SourceLocation)size + 1;
+
+	return (FileId)m_files.size();
+}
+
+auto SourceManager::GetEntry(FileId file) const -> const File &
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (file == 0 || file > m_files.size())
+	{
+		throw invalid_argument("invalid file id");
+	}
+
+	// Entries never move once added, so the reference outlives the lock.
+	return m_files[file - 1];
+}
+
+const SourceBuffer &SourceManager::GetBuffer(FileId file) const
+{
+	auto &entry = GetEntry(file);
+
+	if (!entry.buffer)
+	{
+		throw invalid_argument("source file was released");
+	}
+
+	return *entry.buffer;
+}
@@ -0,0 +1,87 @@
+#ifndef MOND_SOURCE_MANAGER_HPP
+#define MOND_SOURCE_MANAGER_HPP
+
+#include <mutex>
+#include "Source.hpp"
+
+namespace Mond
+{
+	// A byte in any file of a SourceManager: the file's base location plus the
+	// offset into it. Zero is never a valid location.
+#ifdef MONDX_LARGE_SOURCES
+	typedef uint64_t SourceLocation;
+#else
+	typedef uint32_t SourceLocation;
+#endif
+
+	class SourceBuffer;
+
+	// Owns the files of a batch of work. Every file gets an id and its own run
+	// of global locations, so a single SourceLocation says which file it's in.
+	// Files with the same contents share one buffer. Everything can be called
+	// from any number of threads at once.
+	class SourceManager
+	{
+	public:
+		SourceManager();
+		~SourceManager();
+
+		// Returns the id of the file, loading it the first time it's asked
+		// for. Throws invalid_argument if the file can't be read.
+		FileId Load(const string &filename);
+
+		// Adds contents that don't come from disk, like an unsaved document.
+		// Every call gets a new id, names don't have to be unique.
+		FileId Add(const string &name, const string &contents);
+
+		// Drops the contents of a file once nothing needs them any more, a
+		// file that was loaded n times is dropped at its nth release. Its name
+		// stays, nothing else about it can be asked for, and loading it again
+		// gives a new id. Keeps a batch of many files from holding on to a
+		// buffer and a mapping for each of them.
+		void Release(FileId file);
+
+		size_t FileCount() const;
+
+		const string &GetName(FileId file) const;
+		uint64_t GetHash(FileId file) const;
+		const char *GetData(FileId file) const;
+		SourceInt GetSize(FileId file) const;
+
+		// The buffers are NUL terminated and stay alive until the file is
+		// released, so the source can be handed to a Lexer as is.
+		StringSource GetSource(FileId file) const;
+
+		SourceLocation GetLocation(FileId file, SourceInt offset) const;
+		FileId GetFile(SourceLocation loc) const;
+		SourceInt GetOffset(SourceLocation loc) const;
+
+		// Lines and columns are counted the way the Lexer counts them.
+		Pos GetPos(SourceLocation loc) const;
+		Pos GetPos(FileId file, SourceInt offset) const;
+	private:
+		SourceManager(const SourceManager &);
+		SourceManager &operator=(const SourceManager &);
+
+		struct File
+		{
+			string name;
+			SourceLocation base;
+			int loads;
+			shared_ptr<SourceBuffer> buffer;
+		};
+
+		FileId Insert(const string &name, shared_ptr<SourceBuffer> buffer);
+		const File &GetEntry(FileId file) const;
+		const SourceBuffer &GetBuffer(FileId file) const;
+
+		mutable std::mutex m_mutex;
+		deque<File> m_files;
+		vector<SourceLocation> m_bases;
+		SourceLocation m_next;
+		unordered_map<string, FileId> m_byName;
+		unordered_map<uint64_t, vector<std::weak_ptr<SourceBuffer>>> m_byHash;
+	};
+}
+
+#endif
@@ -0,0 +1,965 @@
+#include <cstring>
+#include <algorithm>
+#include "Hash.hpp"
+#include "Parser.hpp"
+#include "DiagCache.hpp"
+#include "FileSystem.hpp"
+#include "SymbolIndex.hpp"
+
+using namespace Mond;
+
+// ---------------------------------------------------------------------------
+// Index format
+// ---------------------------------------------------------------------------
+
+// An index is a header, the records of the files, then a table of the files
+// sorted by path, with where their records are, and a pool holding the paths.
+// The header says where the table is. Updating writes the records of changed
+// files and a new table after everything, then the header, so the records of
+// the other files stay where they are. Once the records nothing points at
+// would be more than half the index, it's written out again without them.
+//
+// A file's record is its names sorted with how many declarations and unbound
+// references each has, then its declarations and references in source order
+// as varints, each line relative to the one before, then a pool holding the
+// names. Records and the table start at a multiple of eight bytes, so they
+// can be read in place. Like the other caches it's stored in the byte order
+// of the machine that wrote it.
+
+static const char IndexMagic[4] = { 'M', 'X', 'S', 'I' };
+static const uint32_t IndexVersion = 2;
+
+// A reference that isn't bound to a declaration in its file.
+static const uint32_t NoDecl = 0xFFFFFFFF;
+
+struct SymbolIndex::IndexHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint64_t configHash;
+	uint64_t table;
+	uint64_t tableSize;
+};
+
+struct SymbolIndex::IndexTable
+{
+	uint32_t fileCount;
+	uint32_t poolSize;
+};
+
+// Size and modified are what the file had when it was checked, it isn't read
+// again while they stay the same.
+struct SymbolIndex::IndexFile
+{
+	uint32_t path;
+	uint32_t pathLength;
+	uint64_t hash;
+	uint64_t size;
+	int64_t modified;
+	uint64_t symbols;
+	uint64_t symbolsSize;
+};
+
+// Starts a file's record, followed by its names, the varints of its
+// declarations and references, and its pool.
+struct SymbolIndex::IndexSymbols
+{
+	uint32_t nameCount;
+	uint32_t declCount;
+	uint32_t refCount;
+	uint32_t declSize;
+	uint32_t refSize;
+	uint32_t poolSize;
+};
+
+struct SymbolIndex::IndexName
+{
+	uint32_t name;
+	uint32_t nameLength;
+	uint32_t declCount;
+	uint32_t unboundCount;
+};
+
+// A declaration is its name, type, and range, a reference its name, where it
+// starts, and one more than the index of its declaration among its file's, or
+// zero. A name is a single token, so where it ends follows from its length.
+struct SymbolIndex::IndexDecl
+{
+	uint32_t name;
+	Decl::Type type;
+	Range range;
+};
+
+struct SymbolIndex::IndexRef
+{
+	uint32_t name;
+	Pos pos;
+	uint32_t decl;
+};
+
+// A record in the mapped file, checked as far as its sections go.
+struct SymbolIndex::FileRecord
+{
+	const IndexName *names;
+	uint32_t nameCount;
+	uint32_t declCount;
+	uint32_t refCount;
+	const char *decls;
+	const char *refs;
+	const char *refsEnd;
+	const char *pool;
+};
+
+// What checking one file gives. A file that hasn't changed has its old record
+// instead.
+struct SymbolIndex::FileSymbols
+{
+	string path;
+	uint64_t hash;
+	FileInfo info;
+	bool valid;
+	const IndexFile *reused;
+	string record;
+};
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+typedef pair<const string *, const Decl *> NamedDecl;
+
+static void collectDecls(const Scope *scope, vector<NamedDecl> &decls)
+{
+	for (auto &entry : scope->decls)
+	{
+		decls.push_back(NamedDecl(&entry.first, &entry.second));
+	}
+
+	for (auto &child : scope->children)
+	{
+		collectDecls(child.get(), decls);
+	}
+}
+
+static bool isBefore(Pos a, Pos b)
+{
+	return !(b < a);
+}
+
+static uint64_t align(uint64_t size)
+{
+	return (size + 7) & ~(uint64_t)7;
+}
+
+template <class T>
+static void appendRecords(string &contents, const vector<T> &records)
+{
+	contents.append((const char *)records.data(), records.size() * sizeof(T));
+}
+
+// Seven bits a byte, low ones first, the top bit set on all but the last.
+// Differences are taken modulo 2^32 so they come back out the same.
+static void putVarint(string &contents, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		contents += (char)(value | 0x80);
+		value >>= 7;
+	}
+
+	contents += (char)value;
+}
+
+static bool getVarint(const char *&data, const char *end, uint32_t &value)
+{
+	value = 0;
+
+	for (auto shift = 0; shift < 35; shift += 7)
+	{
+		if (data == end)
+		{
+			return false;
+		}
+
+		auto byte = (unsigned char)*data++;
+		value |= (uint32_t)(byte & 0x7F) << shift;
+
+		if (!(byte & 0x80))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// ---------------------------------------------------------------------------
+// SymbolIndex
+// ---------------------------------------------------------------------------
+
+SymbolIndex::SymbolIndex(const string &filename, BuiltinScopePtr builtinScope) :
+	m_filename(filename),
+	m_builtinScope(builtinScope)
+{
+	auto builtins = builtinScope ? builtinScope->Hash() : 0;
+	m_configHash = HashCombine(builtins, HashBytes(MONDX_VERSION, strlen(MONDX_VERSION), sizeof(SourceInt)));
+	Open();
+}
+
+SymbolIndex::~SymbolIndex()
+{
+}
+
+auto SymbolIndex::Update(const vector<string> &files, WorkPool &pool) -> UpdateStats
+{
+	vector<string> paths(files);
+	std::sort(paths.begin(), paths.end());
+	paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+	vector<FileSymbols> symbols(paths.size());
+
+	pool.Run(paths.size(), [&](size_t job, int)
+	{
+		auto &file = symbols[job];
+		file.path = paths[job];
+		file.reused = NULL;
+		file.valid = GetFileInfo(file.path, file.info);
+
+		if (!file.valid)
+		{
+			return;
+		}
+
+		auto old = FindFile(file.path);
+
+		if (old && old->size == file.info.size && old->modified == file.info.modified)
+		{
+			file.hash = old->hash;
+			file.reused = old;
+			return;
+		}
+
+		MappedFile contents(file.path);
+		file.valid = contents.IsValid();
+
+		if (!file.valid)
+		{
+			return;
+		}
+
+		file.hash = HashBytes(contents.Data(), contents.Size());
+
+		if (old && old->hash == file.hash)
+		{
+			file.reused = old;
+			return;
+		}
+
+		string text(contents.Data(), contents.Size());
+
+		DiagBuilder diag;
+		StringSource source(text.c_str());
+		Lexer lexer(diag, source);
+		Parser parser(diag, source, lexer);
+		Sema sema(diag, m_builtinScope);
+
+		auto tree = parser.ParseFile();
+		sema.Check(tree);
+
+		vector<NamedDecl> decls;
+		collectDecls(sema.RootScope().get(), decls);
+
+		// In source order, so the records don't depend on how the scopes
+		// happened to hash their names.
+		std::sort(decls.begin(), decls.end(), [](const NamedDecl &a, const NamedDecl &b)
+		{
+			auto &x = a.second->range.beg;
+			auto &y = b.second->range.beg;
+			return x < y || (x == y && *a.first < *b.first);
+		});
+
+		vector<string> names;
+		unordered_map<string, uint32_t> nameIds;
+		unordered_map<const Decl *, uint32_t> indices;
+		vector<IndexDecl> fileDecls;
+		vector<IndexRef> fileRefs;
+
+		auto intern = [&](const string &name) -> uint32_t
+		{
+			auto it = nameIds.insert(std::make_pair(name, (uint32_t)names.size()));
+
+			if (it.second)
+			{
+				names.push_back(name);
+			}
+
+			return it.first->second;
+		};
+
+		for (auto &entry : decls)
+		{
+			IndexDecl decl;
+			decl.name = intern(*entry.first);
+			decl.type = entry.second->type;
+			decl.range = entry.second->range;
+
+			indices[entry.second] = fileDecls.size();
+			fileDecls.push_back(decl);
+		}
+
+		for (auto id : CollectIds(tree.get()))
+		{
+			if (!id->range.IsValid())
+			{
+				continue;
+			}
+
+			// Builtins have no scope, they're found by name like undeclared
+			// names are.
+			auto it = id->decl ? indices.find(id->decl) : indices.end();
+
+			IndexRef ref;
+			ref.name = intern(id->name);
+			ref.pos = id->range.beg;
+			ref.decl = it != indices.end() ? it->second : NoDecl;
+			fileRefs.push_back(ref);
+		}
+
+		std::sort(fileRefs.begin(), fileRefs.end(), [](const IndexRef &a, const IndexRef &b)
+		{
+			return a.pos < b.pos;
+		});
+
+		file.record = EncodeRecord(names, fileDecls, fileRefs);
+	});
+
+	UpdateStats stats;
+	stats.reused = 0;
+	stats.indexed = 0;
+	stats.removed = FileCount();
+	stats.failed = 0;
+
+	// A file that was read only to find it unchanged still needs its new
+	// size and time written.
+	auto touched = false;
+	vector<FileSymbols> valid;
+
+	for (auto &file : symbols)
+	{
+		if (!file.valid)
+		{
+			stats.failed++;
+			continue;
+		}
+
+		(file.reused ? stats.reused : stats.indexed)++;
+
+		if (file.reused || FindFile(file.path))
+		{
+			stats.removed--;
+		}
+
+		if (file.reused && (file.reused->size != file.info.size || file.reused->modified != file.info.modified))
+		{
+			touched = true;
+		}
+
+		valid.push_back(std::move(file));
+	}
+
+	if (stats.indexed > 0 || stats.removed > 0 || touched)
+	{
+		Write(valid);
+	}
+
+	return stats;
+}
+
+size_t SymbolIndex::FileCount() const
+{
+	return m_fileCount;
+}
+
+bool SymbolIndex::FindDefinition(const string &path, Pos pos, SymbolLocation &location) const
+{
+	auto file = FindFile(path);
+	FileRecord record;
+	vector<IndexDecl> decls;
+	vector<IndexRef> refs;
+
+	if (!file || !GetRecord(file, record) || !ReadRefs(record, refs))
+	{
+		return false;
+	}
+
+	auto ref = FindRef(record, refs, pos);
+
+	if (!ref || ref->decl == NoDecl || !ReadDecls(record, decls))
+	{
+		return false;
+	}
+
+	location = MakeLocation(file, decls[ref->decl].range);
+	return true;
+}
+
+vector<SymbolLocation> SymbolIndex::FindReferences(const string &path, Pos pos) const
+{
+	vector<SymbolLocation> locations;
+	auto file = FindFile(path);
+	FileRecord record;
+	vector<IndexDecl> decls;
+	vector<IndexRef> refs;
+
+	if (!file || !GetRecord(file, record) || !ReadDecls(record, decls) || !ReadRefs(record, refs))
+	{
+		return locations;
+	}
+
+	auto ref = FindRef(record, refs, pos);
+	auto target = ref ? ref->decl : NoDecl;
+	auto unbound = ref && ref->decl == NoDecl ? ref : NULL;
+
+	if (!unbound && target == NoDecl)
+	{
+		for (uint32_t i = 0; i < decls.size(); i++)
+		{
+			auto &range = decls[i].range;
+
+			if (isBefore(range.beg, pos) && !isBefore(range.end, pos))
+			{
+				target = i;
+				break;
+			}
+		}
+	}
+
+	if (target != NoDecl)
+	{
+		locations.push_back(MakeLocation(file, decls[target].range));
+
+		for (auto &other : refs)
+		{
+			if (other.decl == target)
+			{
+				locations.push_back(MakeLocation(file, Range(other.pos, record.names[other.name].nameLength)));
+			}
+		}
+	}
+	else if (unbound)
+	{
+		// Only the files whose records have the name unbound are read.
+		auto &entry = record.names[unbound->name];
+		string name(record.pool + entry.name, entry.nameLength);
+		vector<IndexRef> otherRefs;
+
+		for (uint32_t i = 0; i < m_fileCount; i++)
+		{
+			FileRecord other;
+
+			if (!GetRecord(&m_files[i], other))
+			{
+				continue;
+			}
+
+			auto found = FindName(other, name);
+
+			if (found == other.names + other.nameCount || found->unboundCount == 0 ||
+				name.compare(0, name.size(), other.pool + found->name, found->nameLength) != 0 ||
+				!ReadRefs(other, otherRefs))
+			{
+				continue;
+			}
+
+			auto index = (uint32_t)(found - other.names);
+
+			for (auto &otherRef : otherRefs)
+			{
+				if (otherRef.decl == NoDecl && otherRef.name == index)
+				{
+					locations.push_back(MakeLocation(&m_files[i], Range(otherRef.pos, (SourceInt)name.size())));
+				}
+			}
+		}
+	}
+
+	return locations;
+}
+
+vector<SymbolDecl> SymbolIndex::FindDeclarations(const string &prefix, size_t limit) const
+{
+	// Every file's matches go in path order, so sorting by name alone keeps
+	// that order within a name. Once there are limit of them, a name past
+	// the last one kept can't make it in.
+	vector<SymbolDecl> decls;
+	vector<IndexDecl> fileDecls;
+	auto bounded = false;
+	string bound;
+
+	auto trim = [&]()
+	{
+		std::stable_sort(decls.begin(), decls.end(), [](const SymbolDecl &a, const SymbolDecl &b)
+		{
+			return a.name < b.name;
+		});
+
+		if (decls.size() >= limit)
+		{
+			decls.resize(limit);
+			bounded = limit > 0;
+			bound = bounded ? decls.back().name : "";
+		}
+	};
+
+	for (uint32_t i = 0; i < m_fileCount && limit > 0; i++)
+	{
+		FileRecord record;
+
+		if (!GetRecord(&m_files[i], record))
+		{
+			continue;
+		}
+
+		auto first = FindName(record, prefix);
+		auto last = first;
+		size_t count = 0;
+
+		for (; last != record.names + record.nameCount && count < limit; ++last)
+		{
+			auto chars = record.pool + last->name;
+
+			if (last->nameLength < prefix.size() || prefix.compare(0, prefix.size(), chars, prefix.size()) != 0 ||
+				(bounded && bound.compare(0, bound.size(), chars, last->nameLength) <= 0))
+			{
+				break;
+			}
+
+			count += last->declCount;
+		}
+
+		if (count == 0 || !ReadDecls(record, fileDecls))
+		{
+			continue;
+		}
+
+		vector<pair<uint32_t, uint32_t>> found;
+
+		for (uint32_t j = 0; j < fileDecls.size(); j++)
+		{
+			auto name = fileDecls[j].name;
+
+			if (name >= (uint32_t)(first - record.names) && name < (uint32_t)(last - record.names))
+			{
+				found.push_back(std::make_pair(name, j));
+			}
+		}
+
+		std::sort(found.begin(), found.end());
+		found.resize(std::min(found.size(), limit));
+
+		for (auto &entry : found)
+		{
+			auto &name = record.names[entry.first];
+			auto &fileDecl = fileDecls[entry.second];
+
+			SymbolDecl decl;
+			decl.name.assign(record.pool + name.name, name.nameLength);
+			decl.type = fileDecl.type;
+			decl.location = MakeLocation(&m_files[i], fileDecl.range);
+			decls.push_back(decl);
+		}
+
+		if (decls.size() >= 2 * limit)
+		{
+			trim();
+		}
+	}
+
+	trim();
+	return decls;
+}
+
+void SymbolIndex::Open()
+{
+	m_files = NULL;
+	m_fileCount = 0;
+	m_paths = NULL;
+	m_file.reset(new MappedFile(m_filename));
+
+	if (!m_file->IsValid() || m_file->Size() < sizeof(IndexHeader))
+	{
+		return;
+	}
+
+	// Copied out, another update may be rewriting it.
+	IndexHeader header;
+	memcpy(&header, m_file->Data(), sizeof(header));
+
+	auto size = m_file->Size();
+
+	if (memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 ||
+		header.version != IndexVersion ||
+		header.configHash != m_configHash ||
+		header.table % 8 != 0 ||
+		header.table > size ||
+		header.tableSize > size - header.table ||
+		header.tableSize < sizeof(IndexTable))
+	{
+		return;
+	}
+
+	auto table = (const IndexTable *)(m_file->Data() + header.table);
+	auto files = (const IndexFile *)(table + 1);
+	auto paths = (const char *)(files + table->fileCount);
+
+	if (header.tableSize != sizeof(IndexTable) + (uint64_t)table->fileCount * sizeof(IndexFile) + table->poolSize)
+	{
+		return;
+	}
+
+	// The table is checked here, a record when it's read.
+	for (uint32_t i = 0; i < table->fileCount; i++)
+	{
+		auto &file = files[i];
+
+		if ((uint64_t)file.path + file.pathLength > table->poolSize ||
+			file.symbols % 8 != 0 ||
+			file.symbols > size ||
+			file.symbolsSize > size - file.symbols)
+		{
+			return;
+		}
+	}
+
+	m_files = files;
+	m_fileCount = table->fileCount;
+	m_paths = paths;
+}
+
+void SymbolIndex::Write(vector<FileSymbols> &files)
+{
+	// The new records go after the old ones while what the index would
+	// waste stays under what it uses, otherwise it's written out again.
+	uint64_t used = 0;
+	uint64_t added = 0;
+
+	for (auto &file : files)
+	{
+		auto size = align(file.reused ? file.reused->symbolsSize : file.record.size());
+		used += size;
+		added += file.reused ? 0 : size;
+	}
+
+	auto oldSize = m_files ? (uint64_t)m_file->Size() : 0;
+	auto appending = m_files && align(oldSize) + added <= 2 * used;
+	auto base = appending ? align(oldSize) : sizeof(IndexHeader);
+
+	string contents;
+	string pool;
+	vector<IndexFile> fileRecords;
+
+	for (auto &file : files)
+	{
+		IndexFile record;
+		record.path = pool.size();
+		record.pathLength = file.path.size();
+		record.hash = file.hash;
+		record.size = file.info.size;
+		record.modified = file.info.modified;
+		pool += file.path;
+
+		if (file.reused && appending)
+		{
+			record.symbols = file.reused->symbols;
+			record.symbolsSize = file.reused->symbolsSize;
+		}
+		else
+		{
+			record.symbols = base + contents.size();
+
+			if (file.reused)
+			{
+				record.symbolsSize = file.reused->symbolsSize;
+				contents.append(m_file->Data() + file.reused->symbols, file.reused->symbolsSize);
+			}
+			else
+			{
+				record.symbolsSize = file.record.size();
+				contents += file.record;
+			}
+
+			contents.resize(align(contents.size()), '\0');
+		}
+
+		fileRecords.push_back(record);
+	}
+
+	IndexTable table;
+	table.fileCount = fileRecords.size();
+	table.poolSize = pool.size();
+
+	IndexHeader header;
+	memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+	header.version = IndexVersion;
+	header.configHash = m_configHash;
+	header.table = base + contents.size();
+	header.tableSize = sizeof(table) + fileRecords.size() * sizeof(IndexFile) + pool.size();
+
+	contents.append((const char *)&table, sizeof(table));
+	appendRecords(contents, fileRecords);
+	contents += pool;
+
+	string prefix((const char *)&header, sizeof(header));
+
+	// Reused records point into the old mapping, so it stays until here.
+	files.clear();
+	m_file.reset();
+
+	// The header goes last, until then a reader finds the old table and
+	// everything it points at where it was.
+	auto written = appending ?
+		WriteFileAt(m_filename, oldSize, string(base - oldSize, '\0') + contents) && WriteFileAt(m_filename, 0, prefix) :
+		WriteFileAtomic(m_filename, prefix + contents);
+
+	Open();
+
+	if (!written)
+	{
+		throw invalid_argument("unable to write symbol index '" + m_filename + "'");
+	}
+}
+
+string SymbolIndex::EncodeRecord(const vector<string> &names, const vector<IndexDecl> &decls, const vector<IndexRef> &refs)
+{
+	// The names are numbered in sorted order so they can be looked up.
+	vector<uint32_t> order(names.size());
+	vector<uint32_t> ranks(names.size());
+
+	for (uint32_t i = 0; i < order.size(); i++)
+	{
+		order[i] = i;
+	}
+
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+	{
+		return names[a] < names[b];
+	});
+
+	vector<IndexName> nameRecords(names.size());
+	string pool;
+
+	for (uint32_t i = 0; i < order.size(); i++)
+	{
+		auto &name = names[order[i]];
+		ranks[order[i]] = i;
+
+		nameRecords[i].name = pool.size();
+		nameRecords[i].nameLength = name.size();
+		nameRecords[i].declCount = 0;
+		nameRecords[i].unboundCount = 0;
+		pool += name;
+	}
+
+	string declBytes;
+	string refBytes;
+	SourceInt line = 0;
+
+	for (auto &decl : decls)
+	{
+		auto &range = decl.range;
+		nameRecords[ranks[decl.name]].declCount++;
+
+		putVarint(declBytes, ranks[decl.name]);
+		putVarint(declBytes, decl.type);
+		putVarint(declBytes, (uint32_t)(range.beg.line - line));
+		putVarint(declBytes, (uint32_t)range.beg.column);
+		putVarint(declBytes, (uint32_t)(range.end.line - range.beg.line));
+		putVarint(declBytes, (uint32_t)range.end.column);
+		line = range.beg.line;
+	}
+
+	line = 0;
+
+	for (auto &ref : refs)
+	{
+		if (ref.decl == NoDecl)
+		{
+			nameRecords[ranks[ref.name]].unboundCount++;
+		}
+
+		putVarint(refBytes, ranks[ref.name]);
+		putVarint(refBytes, (uint32_t)(ref.pos.line - line));
+		putVarint(refBytes, (uint32_t)ref.pos.column);
+		putVarint(refBytes, ref.decl == NoDecl ? 0 : ref.decl + 1);
+		line = ref.pos.line;
+	}
+
+	IndexSymbols symbols;
+	symbols.nameCount = nameRecords.size();
+	symbols.declCount = decls.size();
+	symbols.refCount = refs.size();
+	symbols.declSize = declBytes.size();
+	symbols.refSize = refBytes.size();
+	symbols.poolSize = pool.size();
+
+	string record;
+	record.append((const char *)&symbols, sizeof(symbols));
+	appendRecords(record, nameRecords);
+	record += declBytes;
+	record += refBytes;
+	record += pool;
+	return record;
+}
+
+bool SymbolIndex::GetRecord(const IndexFile *file, FileRecord &record) const
+{
+	if (file->symbolsSize < sizeof(IndexSymbols))
+	{
+		return false;
+	}
+
+	auto symbols = (const IndexSymbols *)(m_file->Data() + file->symbols);
+
+	// Every varint takes at least a byte, so the counts can't claim more
+	// than the sections hold.
+	if (file->symbolsSize < sizeof(IndexSymbols) + (uint64_t)symbols->nameCount * sizeof(IndexName) +
+		symbols->declSize + symbols->refSize + symbols->poolSize ||
+		(uint64_t)symbols->declCount * 6 > symbols->declSize ||
+		(uint64_t)symbols->refCount * 4 > symbols->refSize)
+	{
+		return false;
+	}
+
+	record.names = (const IndexName *)(symbols + 1);
+	record.nameCount = symbols->nameCount;
+	record.declCount = symbols->declCount;
+	record.refCount = symbols->refCount;
+	record.decls = (const char *)(record.names + record.nameCount);
+	record.refs = record.decls + symbols->declSize;
+	record.refsEnd = record.refs + symbols->refSize;
+	record.pool = record.refsEnd;
+
+	for (uint32_t i = 0; i < record.nameCount; i++)
+	{
+		if ((uint64_t)record.names[i].name + record.names[i].nameLength > symbols->poolSize)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Both fail on a record that doesn't decode to what it says it holds.
+bool SymbolIndex::ReadDecls(const FileRecord &record, vector<IndexDecl> &decls)
+{
+	auto data = record.decls;
+	uint32_t line = 0;
+	decls.resize(record.declCount);
+
+	for (auto &decl : decls)
+	{
+		uint32_t type, begLine, begColumn, endLine, endColumn;
+
+		if (!getVarint(data, record.refs, decl.name) ||
+			!getVarint(data, record.refs, type) ||
+			!getVarint(data, record.refs, begLine) ||
+			!getVarint(data, record.refs, begColumn) ||
+			!getVarint(data, record.refs, endLine) ||
+			!getVarint(data, record.refs, endColumn) ||
+			decl.name >= record.nameCount ||
+			type > Decl::Argument)
+		{
+			return false;
+		}
+
+		line += begLine;
+		decl.type = (Decl::Type)type;
+		decl.range = Range(Pos((int32_t)line, (int32_t)begColumn), Pos((int32_t)(line + endLine), (int32_t)endColumn));
+	}
+
+	return data == record.refs;
+}
+
+bool SymbolIndex::ReadRefs(const FileRecord &record, vector<IndexRef> &refs)
+{
+	auto data = record.refs;
+	uint32_t line = 0;
+	refs.resize(record.refCount);
+
+	for (auto &ref : refs)
+	{
+		uint32_t delta, column, decl;
+
+		if (!getVarint(data, record.refsEnd, ref.name) ||
+			!getVarint(data, record.refsEnd, delta) ||
+			!getVarint(data, record.refsEnd, column) ||
+			!getVarint(data, record.refsEnd, decl) ||
+			ref.name >= record.nameCount ||
+			decl > record.declCount)
+		{
+			return false;
+		}
+
+		line += delta;
+		ref.pos = Pos((int32_t)line, (int32_t)column);
+		ref.decl = decl == 0 ? NoDecl : decl - 1;
+	}
+
+	return data == record.refsEnd;
+}
+
+auto SymbolIndex::FindName(const FileRecord &record, const string &name) -> const IndexName *
+{
+	return std::lower_bound(record.names, record.names + record.nameCount, name, [&](const IndexName &n, const string &s)
+	{
+		return s.compare(0, s.size(), record.pool + n.name, n.nameLength) > 0;
+	});
+}
+
+auto SymbolIndex::FindRef(const FileRecord &record, const vector<IndexRef> &refs, Pos pos) -> const IndexRef *
+{
+	// The last reference starting at or before pos, if pos is in its name.
+	auto ref = std::upper_bound(refs.begin(), refs.end(), pos, [](Pos p, const IndexRef &r)
+	{
+		return p < r.pos;
+	});
+
+	if (ref == refs.begin())
+	{
+		return NULL;
+	}
+
+	--ref;
+
+	if (ref->pos.line != pos.line || pos.column >= ref->pos.column + (SourceInt)record.names[ref->name].nameLength)
+	{
+		return NULL;
+	}
+
+	return &*ref;
+}
+
+auto SymbolIndex::FindFile(const string &path) const -> const IndexFile *
+{
+	auto end = m_files + m_fileCount;
+	auto file = std::lower_bound(m_files, end, path, [&](const IndexFile &f, const string &p)
+	{
+		return p.compare(0, p.size(), m_paths + f.path, f.pathLength) > 0;
+	});
+
+	if (file == end || path.compare(0, path.size(), m_paths + file->path, file->pathLength) != 0)
+	{
+		return NULL;
+	}
+
+	return file;
+}
+
+SymbolLocation SymbolIndex::MakeLocation(const IndexFile *file, Range range) const
+{
+	SymbolLocation location;
+	location.path.assign(m_paths + file->path, file->pathLength);
+	location.range = range;
+	return location;
+}
@@ -0,0 +1,113 @@
+#ifndef MOND_SYMBOL_INDEX_HPP
+#define MOND_SYMBOL_INDEX_HPP
+
+#include "WorkPool.hpp"
+#include "MappedFile.hpp"
+#include "BuiltinScope.hpp"
+
+namespace Mond
+{
+	struct SymbolLocation
+	{
+		string path;
+		Range range;
+	};
+
+	struct SymbolDecl
+	{
+		string name;
+		Decl::Type type;
+		SymbolLocation location;
+	};
+
+	// Every declaration and every resolved name in a set of files, kept in
+	// one file on disk that's mapped and queried in place. Files keep their
+	// records until their contents change, and one whose size and time are
+	// what they were isn't read at all, so updating after an edit only
+	// checks and writes the records of the files that were edited. Only one
+	// process should update an index at a time, any number can query it.
+	//
+	// Scripts don't see each other's declarations, a name bound in a file
+	// only has references in that file. Builtins and undeclared names are
+	// matched by name across every file.
+	class SymbolIndex
+	{
+	public:
+		struct UpdateStats
+		{
+			size_t reused;
+			size_t indexed;
+			size_t removed;
+			size_t failed;
+		};
+
+		// An index that's missing, corrupt, or was made against other
+		// builtins or by another version starts out empty.
+		SymbolIndex(const string &filename, BuiltinScopePtr builtinScope);
+		~SymbolIndex();
+
+		// Makes the index cover exactly these files, checking the new and
+		// changed ones on the pool, and writes it back. Files that can't be
+		// read are left out.
+		UpdateStats Update(const vector<string> &files, WorkPool &pool);
+
+		size_t FileCount() const;
+
+		// Where the name at pos is declared, false for builtins, undeclared
+		// names and anything that isn't a name.
+		bool FindDefinition(const string &path, Pos pos, SymbolLocation &location) const;
+
+		// The declaration of the name at pos, or of the declaration at pos,
+		// then all its uses in file order. Builtins and undeclared names only
+		// have uses.
+		vector<SymbolLocation> FindReferences(const string &path, Pos pos) const;
+
+		// Declarations whose name starts with prefix, in name order.
+		vector<SymbolDecl> FindDeclarations(const string &prefix, size_t limit) const;
+	private:
+		SymbolIndex(const SymbolIndex &);
+		SymbolIndex &operator=(const SymbolIndex &);
+
+		// The on-disk records, a file's record read out, and what checking a
+		// file gives.
+		struct IndexHeader;
+		struct IndexTable;
+		struct IndexFile;
+		struct IndexSymbols;
+		struct IndexName;
+		struct IndexDecl;
+		struct IndexRef;
+		struct FileRecord;
+		struct FileSymbols;
+
+		void Open();
+		void Write(vector<FileSymbols> &files);
+
+		static string EncodeRecord(const vector<string> &names, const vector<IndexDecl> &decls, const vector<IndexRef> &refs);
+
+		const IndexFile *FindFile(const string &path) const;
+		// A file's record is only read as far as a query needs, declarations
+		// and references are decoded a whole file at a time.
+		bool GetRecord(const IndexFile *file, FileRecord &record) const;
+		static bool ReadDecls(const FileRecord &record, vector<IndexDecl> &decls);
+		static bool ReadRefs(const FileRecord &record, vector<IndexRef> &refs);
+		// The first of the record's names that isn't before name.
+		static const IndexName *FindName(const FileRecord &record, const string &name);
+		// The reference in refs whose name holds pos.
+		static const IndexRef *FindRef(const FileRecord &record, const vector<IndexRef> &refs, Pos pos);
+		SymbolLocation MakeLocation(const IndexFile *file, Range range) const;
+
+		string m_filename;
+		BuiltinScopePtr m_builtinScope;
+		uint64_t m_configHash;
+		unique_ptr<MappedFile> m_file;
+
+		// The file table of the mapped file, empty when it isn't valid. The
+		// header isn't kept, an update rewrites it in place.
+		const IndexFile *m_files;
+		uint32_t m_fileCount;
+		const char *m_paths;
+	};
+}
+
+#endif
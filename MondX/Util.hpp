@@ -6,6 +6,7 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <limits>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
@@ -33,37 +34,50 @@ namespace Mond
 	// Utility structures
 	// -----------------------------------------------------------------------
 
+	// Byte offsets, lines and columns in a source. Every token and node
+	// carries several of them, so they stay 32 bits unless the library is
+	// built with MONDX_LARGE_SOURCES for sources of 2 GB and up.
+#ifdef MONDX_LARGE_SOURCES
+	typedef int64_t SourceInt;
+#else
+	typedef int32_t SourceInt;
+#endif
+
+	// Files of a SourceManager are numbered from one, zero is no file.
+	typedef uint32_t FileId;
+
 	struct Pos
 	{
 		Pos();
-		Pos(int line, int column);
+		Pos(SourceInt line, SourceInt column);
 
 		bool IsValid() const;
 
 		bool operator==(const Pos &other) const;
 		bool operator!=(const Pos &other) const;
+		bool operator<(const Pos &other) const;
 
-		int line;
-		int column;
+		SourceInt line;
+		SourceInt column;
 	};
 
 	struct Slice
 	{
 		Slice();
-		Slice(int pos);
-		Slice(int beg, int end);
+		Slice(SourceInt pos);
+		Slice(SourceInt beg, SourceInt end);
 
 		bool IsValid() const;
 
-		int beg;
-		int end;
+		SourceInt beg;
+		SourceInt end;
 	};
 
 	struct Range
 	{
 		Range();
 		Range(Pos beg, Pos end);
-		Range(Pos beg, int length);
+		Range(Pos beg, SourceInt length);
 
 		bool IsValid() const;
 
@@ -79,7 +93,7 @@ namespace Mond
 	{
 	}
 
-	inline Pos::Pos(int line, int column) : line(line), column(column)
+	inline Pos::Pos(SourceInt line, SourceInt column) : line(line), column(column)
 	{
 	}
 
@@ -98,6 +112,11 @@ namespace Mond
 		return line != other.line || column != other.column;
 	}
 
+	inline bool Pos::operator<(const Pos &other) const
+	{
+		return line < other.line || (line == other.line && column < other.column);
+	}
+
 	// -----------------------------------------------------------------------
 	// Slice implementation
 	// -----------------------------------------------------------------------
@@ -106,11 +125,11 @@ namespace Mond
 	{
 	}
 
-	inline Slice::Slice(int pos) : beg(pos), end(pos + 1)
+	inline Slice::Slice(SourceInt pos) : beg(pos), end(pos + 1)
 	{
 	}
 
-	inline Slice::Slice(int beg, int end) : beg(beg), end(end)
+	inline Slice::Slice(SourceInt beg, SourceInt end) : beg(beg), end(end)
 	{
 	}
 
@@ -131,7 +150,7 @@ namespace Mond
 	{
 	}
 
-	inline Range::Range(Pos beg, int length) : beg(beg), end(beg.line, beg.column + length)
+	inline Range::Range(Pos beg, SourceInt length) : beg(beg), end(beg.line, beg.column + length)
 	{
 	}
 
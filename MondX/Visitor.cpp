@@ -20,6 +20,26 @@ void Mond::AcceptChild(Visitor *v, AstNode *n)
 	}
 }
 
+class IdCollector : public Visitor
+{
+public:
+	using Visitor::Visit;
+
+	void Visit(ExprId *expr)
+	{
+		ids.push_back(expr);
+	}
+
+	vector<ExprId *> ids;
+};
+
+vector<ExprId *> Mond::CollectIds(AstNode *n)
+{
+	IdCollector collector;
+	AcceptChild(&collector, n);
+	return std::move(collector.ids);
+}
+
 // ---------------------------------------------------------------------------
 // AST Node
 // ---------------------------------------------------------------------------
@@ -1,6 +1,8 @@
 #ifndef MOND_VISITOR_HPP
 #define MOND_VISITOR_HPP
 
+#include "Util.hpp"
+
 namespace Mond
 {
 	class Visitor
@@ -43,6 +45,9 @@ namespace Mond
 	};
 
 	void AcceptChild(Visitor *v, struct AstNode *n);
+
+	// Every name used under n, in the order they're visited.
+	vector<struct ExprId *> CollectIds(struct AstNode *n);
 }
 
 #endif
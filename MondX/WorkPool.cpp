@@ -0,0 +1,168 @@
+#include "WorkPool.hpp"
+
+using namespace Mond;
+
+WorkPool::WorkPool(int threads) :
+	m_threads(threads < 1 ? 1 : threads),
+	m_shares(new Share[m_threads]),
+	m_batch(0),
+	m_busy(0),
+	m_quit(false),
+	m_job(NULL),
+	m_failed(false)
+{
+	for (int i = 1; i < m_threads; i++)
+	{
+		m_workers.emplace_back(&WorkPool::WorkerMain, this, i);
+	}
+}
+
+WorkPool::~WorkPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+
+	m_wake.notify_all();
+
+	for (auto &worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+int WorkPool::ThreadCount() const
+{
+	return m_threads;
+}
+
+void WorkPool::Run(size_t count, const Job &job)
+{
+	for (int i = 0; i < m_threads; i++)
+	{
+		m_shares[i].beg = count * i / m_threads;
+		m_shares[i].end = count * (i + 1) / m_threads;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_failed = false;
+		m_error = std::exception_ptr();
+		m_busy = m_threads;
+		m_batch++;
+	}
+
+	m_wake.notify_all();
+	Work(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this]() { return m_busy == 0; });
+	m_job = NULL;
+
+	if (m_error)
+	{
+		std::rethrow_exception(m_error);
+	}
+}
+
+void WorkPool::Work(int worker)
+{
+	size_t job;
+
+	while (Take(worker, job) || (Steal(worker) && Take(worker, job)))
+	{
+		try
+		{
+			(*m_job)(job, worker);
+		}
+		catch (...)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (!m_error)
+			{
+				m_error = std::current_exception();
+			}
+
+			m_failed = true;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (--m_busy == 0)
+	{
+		m_done.notify_all();
+	}
+}
+
+void WorkPool::WorkerMain(int worker)
+{
+	uint64_t seen = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_quit || m_batch != seen; });
+
+			if (m_quit)
+			{
+				return;
+			}
+
+			seen = m_batch;
+		}
+
+		Work(worker);
+	}
+}
+
+bool WorkPool::Take(int worker, size_t &job)
+{
+	auto &share = m_shares[worker];
+	std::lock_guard<std::mutex> lock(share.mutex);
+
+	if (share.beg == share.end || m_failed)
+	{
+		return false;
+	}
+
+	job = share.beg++;
+	return true;
+}
+
+bool WorkPool::Steal(int worker)
+{
+	// Nothing ever adds jobs, so once every share is seen empty the only
+	// ones left are already running or owned by the thieves that took them.
+	for (int i = 1; i < m_threads; i++)
+	{
+		auto &victim = m_shares[(worker + i) % m_threads];
+		size_t beg, end;
+
+		{
+			std::lock_guard<std::mutex> lock(victim.mutex);
+
+			if (victim.beg == victim.end)
+			{
+				continue;
+			}
+
+			auto half = (victim.end - victim.beg + 1) / 2;
+			beg = victim.end - half;
+			end = victim.end;
+			victim.end = beg;
+		}
+
+		auto &share = m_shares[worker];
+		std::lock_guard<std::mutex> lock(share.mutex);
+		share.beg = beg;
+		share.end = end;
+		return true;
+	}
+
+	return false;
+}
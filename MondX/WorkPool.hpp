@@ -0,0 +1,66 @@
+#ifndef MOND_WORK_POOL_HPP
+#define MOND_WORK_POOL_HPP
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <exception>
+#include <condition_variable>
+#include "Util.hpp"
+
+namespace Mond
+{
+	// Runs batches of numbered jobs on a fixed set of threads. Every worker
+	// starts a batch with an even share of the job numbers and takes them
+	// from the front; once its share is gone it steals the back half of
+	// another worker's, so a few slow jobs don't leave the rest idle.
+	class WorkPool
+	{
+	public:
+		typedef function<void (size_t job, int worker)> Job;
+
+		// The calling thread is worker zero, so a pool of one thread starts
+		// none of its own.
+		explicit WorkPool(int threads);
+		~WorkPool();
+
+		int ThreadCount() const;
+
+		// Calls job for every number below count and returns once all calls
+		// are done. The first exception a job throws is rethrown here, jobs
+		// that haven't started by then are skipped.
+		void Run(size_t count, const Job &job);
+	private:
+		WorkPool(const WorkPool &);
+		WorkPool &operator=(const WorkPool &);
+
+		struct Share
+		{
+			std::mutex mutex;
+			size_t beg;
+			size_t end;
+		};
+
+		void Work(int worker);
+		void WorkerMain(int worker);
+		bool Take(int worker, size_t &job);
+		bool Steal(int worker);
+
+		int m_threads;
+		vector<std::thread> m_workers;
+		unique_ptr<Share[]> m_shares;
+
+		std::mutex m_mutex;
+		std::condition_variable m_wake;
+		std::condition_variable m_done;
+		uint64_t m_batch;
+		int m_busy;
+		bool m_quit;
+
+		const Job *m_job;
+		std::atomic<bool> m_failed;
+		std::exception_ptr m_error;
+	};
+}
+
+#endif